@@ -26,8 +26,10 @@ typedef int agc_dp_t;
  */
 #ifdef _MSC_VER
 typedef __int64 agc_int64_t;
+typedef unsigned __int64 agc_uint64_t;
 #else
 typedef long long agc_int64_t;
+typedef unsigned long long agc_uint64_t;
 #endif
 
 /* ----------------------------------------------------------------
@@ -0,0 +1,151 @@
+/*
+ * agc_context.c -- Multiple AGC instances in one process.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#include "agc_context.h"
+#include "agc_cpu.h"
+#include "alarm.h"
+#include "dsky.h"
+#include "executive.h"
+#include "integration.h"
+#include "latlong.h"
+#include "monitor.h"
+#include "navigation.h"
+#include "pinball.h"
+#include "rte_search.h"
+#include "timer.h"
+#include "tpi_search.h"
+#include "waitlist.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AGC_CONTEXT_BLOCKS 64
+#define AGC_CONTEXT_IMAGE_BUF 16384
+
+typedef struct
+{
+  void* addr;
+  size_t size;
+  size_t offset; /* Position in a context image */
+} agc_context_block_t;
+
+static agc_context_block_t ctx_blocks[AGC_CONTEXT_BLOCKS];
+static int ctx_block_count = 0;
+static size_t ctx_image_size = 0;
+static int ctx_registered = 0;
+
+static unsigned char ctx_images[AGC_CONTEXT_MAX][AGC_CONTEXT_IMAGE_BUF];
+static int ctx_count = 1;
+static int ctx_current = 0;
+
+void
+agc_context_register(void* addr, size_t size)
+{
+  if (ctx_block_count >= AGC_CONTEXT_BLOCKS ||
+      ctx_image_size + size > AGC_CONTEXT_IMAGE_BUF) {
+    fprintf(stderr, "AGC context: state exceeds AGC_CONTEXT_IMAGE_BUF\n");
+    exit(1);
+  }
+  ctx_blocks[ctx_block_count].addr = addr;
+  ctx_blocks[ctx_block_count].size = size;
+  ctx_blocks[ctx_block_count].offset = ctx_image_size;
+  ctx_block_count++;
+  ctx_image_size += size;
+}
+
+static void
+ctx_register_all(void)
+{
+  if (ctx_registered) {
+    return;
+  }
+  agc_cpu_register_state();
+  timer_register_state();
+  exec_register_state();
+  waitlist_register_state();
+  alarm_register_state();
+  pinball_register_state();
+  monitor_register_state();
+  dsky_register_state();
+  nav_register_state();
+  integ_register_state();
+  tpi_register_state();
+  rte_register_state();
+  latlong_register_state();
+  ctx_registered = 1;
+}
+
+static void
+ctx_save(int id)
+{
+  int i;
+  for (i = 0; i < ctx_block_count; i++) {
+    memcpy(ctx_images[id] + ctx_blocks[i].offset,
+           ctx_blocks[i].addr,
+           ctx_blocks[i].size);
+  }
+}
+
+static void
+ctx_load(int id)
+{
+  int i;
+  for (i = 0; i < ctx_block_count; i++) {
+    memcpy(ctx_blocks[i].addr,
+           ctx_images[id] + ctx_blocks[i].offset,
+           ctx_blocks[i].size);
+  }
+}
+
+int
+agc_context_create(void)
+{
+  if (ctx_count >= AGC_CONTEXT_MAX) {
+    return -1;
+  }
+  ctx_register_all();
+  ctx_save(ctx_count);
+  return ctx_count++;
+}
+
+void
+agc_context_switch(int id)
+{
+  if (id == ctx_current || id < 0 || id >= ctx_count) {
+    return;
+  }
+  ctx_save(ctx_current);
+  ctx_load(id);
+  ctx_current = id;
+}
+
+int
+agc_context_count(void)
+{
+  return ctx_count;
+}
+
+int
+agc_context_current(void)
+{
+  return ctx_current;
+}
+
+const void*
+agc_context_block(int id, const void* live_addr)
+{
+  int i;
+  if (id == ctx_current || id < 0 || id >= ctx_count) {
+    return live_addr;
+  }
+  for (i = 0; i < ctx_block_count; i++) {
+    if (ctx_blocks[i].addr == live_addr) {
+      return ctx_images[id] + ctx_blocks[i].offset;
+    }
+  }
+  return live_addr;
+}
@@ -0,0 +1,39 @@
+/*
+ * agc_context.h -- Multiple AGC instances in one process.
+ *
+ * Simulator state lives in module globals.  Each module registers
+ * those blocks once; a context is a saved image of all of them.
+ * Switching contexts stores the live blocks into the outgoing image
+ * and loads the incoming one, so every module keeps working on its
+ * globals unchanged.  Context 0 is the state main() starts with.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifndef AGC_CONTEXT_H
+#define AGC_CONTEXT_H
+
+#include <stddef.h>
+
+#define AGC_CONTEXT_MAX 16
+
+/* Called by the module *_register_state() functions */
+void
+agc_context_register(void* addr, size_t size);
+
+/* Clones the live state into a new context; returns its id or -1 */
+int
+agc_context_create(void);
+void
+agc_context_switch(int id);
+int
+agc_context_count(void);
+int
+agc_context_current(void);
+
+/* Where context id keeps the block registered at live_addr: the live
+ * block for the current context, else its copy in the saved image. */
+const void*
+agc_context_block(int id, const void* live_addr);
+
+#endif /* AGC_CONTEXT_H */
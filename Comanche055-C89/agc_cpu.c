@@ -5,6 +5,7 @@
  */
 
 #include "agc.h"
+#include "agc_context.h"
 #include "agc_cpu.h"
 
 #include <string.h>
@@ -138,6 +139,23 @@ agc_init(void)
   agc_channels[CHAN_CHAN33] = 037777;
 }
 
+void
+agc_cpu_register_state(void)
+{
+  agc_context_register(agc_erasable, sizeof(agc_erasable));
+  agc_context_register(agc_channels, sizeof(agc_channels));
+  agc_context_register(&agc_ebank, sizeof(agc_ebank));
+  agc_context_register(&agc_time1, sizeof(agc_time1));
+  agc_context_register(&agc_time2, sizeof(agc_time2));
+  agc_context_register(&agc_time3, sizeof(agc_time3));
+  agc_context_register(&agc_time4, sizeof(agc_time4));
+  agc_context_register(&agc_time5, sizeof(agc_time5));
+  agc_context_register(&agc_time6, sizeof(agc_time6));
+  agc_context_register(&agc_inhint, sizeof(agc_inhint));
+  agc_context_register(agc_flagwords, sizeof(agc_flagwords));
+  agc_context_register(&agc_current_program, sizeof(agc_current_program));
+}
+
 /* ----------------------------------------------------------------
  * 1's complement arithmetic
  * ---------------------------------------------------------------- */
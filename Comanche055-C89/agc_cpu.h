@@ -119,11 +119,24 @@ agc_flag_test(int flagword, agc_word_t bitmask);
 #define FLGWRD8 8
 #define LMESSION BIT1
 
+/* ----------------------------------------------------------------
+ * Erasable assignments (from ERASABLE_ASSIGNMENTS.agc)
+ * Unswitched words live in E-bank 0.
+ * ---------------------------------------------------------------- */
+
+#define EBANK_UNSWITCHED 0
+#define CDUX 032    /* ICDU angles, 2^15 counts per revolution */
+#define CDUY 033
+#define CDUZ 034
+#define FAILREG 0375 /* First, second and latest alarm codes */
+
 /* ----------------------------------------------------------------
  * Initialization
  * ---------------------------------------------------------------- */
 
 void
 agc_init(void);
+void
+agc_cpu_register_state(void);
 
 #endif /* AGC_CPU_H */
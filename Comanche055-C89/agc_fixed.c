@@ -0,0 +1,254 @@
+/*
+ * agc_fixed.c -- 64-bit fixed point for the orbit routines.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#include "agc.h"
+#include "agc_fixed.h"
+
+#define FX_LOW32 ((agc_uint64_t)0xFFFFFFFFUL)
+#define FX_TOP_BIT ((agc_uint64_t)1 << 63)
+
+/* ----------------------------------------------------------------
+ * 128-bit helpers (unsigned, as hi:lo pairs)
+ * ---------------------------------------------------------------- */
+
+static void
+fx_umul128(agc_uint64_t a, agc_uint64_t b, agc_uint64_t* hi, agc_uint64_t* lo)
+{
+  agc_uint64_t a0, a1, b0, b1, p00, p01, p10, p11, mid;
+
+  a0 = a & FX_LOW32;
+  a1 = a >> 32;
+  b0 = b & FX_LOW32;
+  b1 = b >> 32;
+
+  p00 = a0 * b0;
+  p01 = a0 * b1;
+  p10 = a1 * b0;
+  p11 = a1 * b1;
+
+  mid = (p00 >> 32) + (p01 & FX_LOW32) + (p10 & FX_LOW32);
+  *lo = (mid << 32) | (p00 & FX_LOW32);
+  *hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+}
+
+/* hi:lo / d, truncated, with the remainder in *rem; requires hi < d.
+ * Restoring division, one quotient bit at a time. */
+static agc_uint64_t
+fx_udiv128(agc_uint64_t hi,
+           agc_uint64_t lo,
+           agc_uint64_t d,
+           agc_uint64_t* rem)
+{
+  agc_uint64_t q, r, carry;
+  int i;
+
+  q = 0;
+  r = hi;
+  for (i = 0; i < 64; i++) {
+    carry = r & FX_TOP_BIT;
+    r = (r << 1) | (lo >> 63);
+    lo <<= 1;
+    q <<= 1;
+    if (carry || r >= d) {
+      r -= d;
+      q |= 1;
+    }
+  }
+  *rem = r;
+  return q;
+}
+
+static agc_fx_t
+fx_apply_sign(agc_uint64_t mag, int negative)
+{
+  if (mag > (agc_uint64_t)AGC_FX_MAX) {
+    mag = (agc_uint64_t)AGC_FX_MAX;
+  }
+  return negative ? -(agc_fx_t)mag : (agc_fx_t)mag;
+}
+
+/* ----------------------------------------------------------------
+ * Scalar
+ * ---------------------------------------------------------------- */
+
+agc_fx_t
+agc_fx_abs(agc_fx_t a)
+{
+  return a < 0 ? -a : a;
+}
+
+agc_fx_t
+agc_fx_add(agc_fx_t a, agc_fx_t b)
+{
+  if (a > 0 && b > AGC_FX_MAX - a) {
+    return AGC_FX_MAX;
+  }
+  if (a < 0 && b < -AGC_FX_MAX - a) {
+    return -AGC_FX_MAX;
+  }
+  return a + b;
+}
+
+agc_fx_t
+agc_fx_mul(agc_fx_t a, agc_fx_t b)
+{
+  agc_uint64_t hi, lo, half;
+
+  fx_umul128(
+    (agc_uint64_t)agc_fx_abs(a), (agc_uint64_t)agc_fx_abs(b), &hi, &lo);
+
+  /* Round at bit 39, then take bits 40..103 */
+  half = (agc_uint64_t)1 << (AGC_FX_FRAC_BITS - 1);
+  lo += half;
+  if (lo < half) {
+    hi++;
+  }
+  if (hi >> (AGC_FX_FRAC_BITS - 1) != 0) {
+    return fx_apply_sign(~(agc_uint64_t)0, (a < 0) != (b < 0));
+  }
+  return fx_apply_sign(
+    (hi << (64 - AGC_FX_FRAC_BITS)) | (lo >> AGC_FX_FRAC_BITS),
+    (a < 0) != (b < 0));
+}
+
+agc_fx_t
+agc_fx_div(agc_fx_t a, agc_fx_t b)
+{
+  agc_uint64_t ua, ub, hi, lo, q, rem;
+  int negative;
+
+  negative = (a < 0) != (b < 0);
+  if (b == 0) {
+    return fx_apply_sign(~(agc_uint64_t)0, a < 0);
+  }
+  ua = (agc_uint64_t)agc_fx_abs(a);
+  ub = (agc_uint64_t)agc_fx_abs(b);
+
+  hi = ua >> (64 - AGC_FX_FRAC_BITS);
+  lo = ua << AGC_FX_FRAC_BITS;
+  if (hi >= ub) {
+    return fx_apply_sign(~(agc_uint64_t)0, negative);
+  }
+  q = fx_udiv128(hi, lo, ub, &rem);
+  if (rem >= ub - rem) {
+    q++;
+  }
+  return fx_apply_sign(q, negative);
+}
+
+agc_fx_t
+agc_fx_sqrt(agc_fx_t a)
+{
+  agc_uint64_t hi, lo, x, y, q, rem;
+  int bits;
+
+  if (a <= 0) {
+    return 0;
+  }
+
+  /* sqrt(a * 2^40) by Newton's method from a power of two above it */
+  hi = (agc_uint64_t)a >> (64 - AGC_FX_FRAC_BITS);
+  lo = (agc_uint64_t)a << AGC_FX_FRAC_BITS;
+  bits = 0;
+  for (y = hi; y != 0; y >>= 1) {
+    bits++;
+  }
+  if (hi == 0) {
+    for (y = lo; y != 0; y >>= 1) {
+      bits++;
+    }
+  } else {
+    bits += 64;
+  }
+  x = (agc_uint64_t)1 << ((bits + 1) / 2);
+
+  while (1) {
+    /* hi:lo / x fits in 64 bits because x >= sqrt(hi:lo) */
+    q = fx_udiv128(hi, lo, x, &rem);
+    y = (x >> 1) + (q >> 1) + (x & q & 1);
+    if (y >= x) {
+      break;
+    }
+    x = y;
+  }
+  return (agc_fx_t)x;
+}
+
+double
+agc_fx_to_double(agc_fx_t a)
+{
+  return (double)a / 1099511627776.0;
+}
+
+agc_fx_t
+agc_fx_from_double(double x)
+{
+  return (agc_fx_t)(x * 1099511627776.0 + (x < 0 ? -0.5 : 0.5));
+}
+
+/* ----------------------------------------------------------------
+ * Vector
+ * ---------------------------------------------------------------- */
+
+void
+agc_fx_vec_add(const agc_fx_t* a, const agc_fx_t* b, agc_fx_t* result)
+{
+  result[0] = a[0] + b[0];
+  result[1] = a[1] + b[1];
+  result[2] = a[2] + b[2];
+}
+
+void
+agc_fx_vec_sub(const agc_fx_t* a, const agc_fx_t* b, agc_fx_t* result)
+{
+  result[0] = a[0] - b[0];
+  result[1] = a[1] - b[1];
+  result[2] = a[2] - b[2];
+}
+
+void
+agc_fx_vec_scale(agc_fx_t s, const agc_fx_t* v, agc_fx_t* result)
+{
+  result[0] = agc_fx_mul(s, v[0]);
+  result[1] = agc_fx_mul(s, v[1]);
+  result[2] = agc_fx_mul(s, v[2]);
+}
+
+void
+agc_fx_vec_madd(const agc_fx_t* a,
+                agc_fx_t s,
+                const agc_fx_t* b,
+                agc_fx_t* result)
+{
+  result[0] = a[0] + agc_fx_mul(s, b[0]);
+  result[1] = a[1] + agc_fx_mul(s, b[1]);
+  result[2] = a[2] + agc_fx_mul(s, b[2]);
+}
+
+void
+agc_fx_vec_cross(const agc_fx_t* a, const agc_fx_t* b, agc_fx_t* result)
+{
+  agc_fx_t x, y, z;
+  x = agc_fx_mul(a[1], b[2]) - agc_fx_mul(a[2], b[1]);
+  y = agc_fx_mul(a[2], b[0]) - agc_fx_mul(a[0], b[2]);
+  z = agc_fx_mul(a[0], b[1]) - agc_fx_mul(a[1], b[0]);
+  result[0] = x;
+  result[1] = y;
+  result[2] = z;
+}
+
+agc_fx_t
+agc_fx_vec_dot(const agc_fx_t* a, const agc_fx_t* b)
+{
+  return agc_fx_mul(a[0], b[0]) + agc_fx_mul(a[1], b[1]) +
+         agc_fx_mul(a[2], b[2]);
+}
+
+agc_fx_t
+agc_fx_vec_mag(const agc_fx_t* a)
+{
+  return agc_fx_sqrt(agc_fx_vec_dot(a, a));
+}
@@ -0,0 +1,78 @@
+/*
+ * agc_fixed.h -- 64-bit fixed point for the orbit routines.
+ *
+ * Values are agc_int64_t scaled at 2^-40 (Q40): 23 integer bits and
+ * a resolution of about 1e-12.  Products, quotients and square roots
+ * go through 128-bit intermediates built from 32-bit halves, so the
+ * result is correctly rounded whenever it fits; results that do not
+ * fit saturate.  The orbit code works in Earth radii and canonical
+ * time units (see navigation.h), where everything stays in range.
+ *
+ * Vectors are three agc_fx_t, as the DP vectors in agc_math.h are
+ * six words.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifndef AGC_FIXED_H
+#define AGC_FIXED_H
+
+#include "agc.h"
+
+typedef agc_int64_t agc_fx_t;
+
+#define AGC_FX_FRAC_BITS 40
+#define AGC_FX_ONE ((agc_fx_t)1 << AGC_FX_FRAC_BITS)
+#define AGC_FX_MAX ((agc_fx_t)(~(agc_uint64_t)0 >> 1))
+
+/* Integer and floating constants; AGC_FX_CONST folds at compile time */
+#define AGC_FX_INT(n) ((agc_fx_t)(n) * AGC_FX_ONE)
+#define AGC_FX_CONST(x)                                                        \
+  ((agc_fx_t)((x) * 1099511627776.0 + ((x) < 0 ? -0.5 : 0.5)))
+
+/* ----------------------------------------------------------------
+ * Scalar
+ * ---------------------------------------------------------------- */
+
+/* a + b, saturating like the other operations */
+agc_fx_t
+agc_fx_add(agc_fx_t a, agc_fx_t b);
+agc_fx_t
+agc_fx_mul(agc_fx_t a, agc_fx_t b);
+agc_fx_t
+agc_fx_div(agc_fx_t a, agc_fx_t b);
+/* Square root; negative arguments give 0 */
+agc_fx_t
+agc_fx_sqrt(agc_fx_t a);
+agc_fx_t
+agc_fx_abs(agc_fx_t a);
+
+double
+agc_fx_to_double(agc_fx_t a);
+agc_fx_t
+agc_fx_from_double(double x);
+
+/* ----------------------------------------------------------------
+ * Vector (3 components)
+ * ---------------------------------------------------------------- */
+
+void
+agc_fx_vec_add(const agc_fx_t* a, const agc_fx_t* b, agc_fx_t* result);
+void
+agc_fx_vec_sub(const agc_fx_t* a, const agc_fx_t* b, agc_fx_t* result);
+void
+agc_fx_vec_scale(agc_fx_t s, const agc_fx_t* v, agc_fx_t* result);
+/* result = a + s * b */
+void
+agc_fx_vec_madd(const agc_fx_t* a,
+                agc_fx_t s,
+                const agc_fx_t* b,
+                agc_fx_t* result);
+void
+agc_fx_vec_cross(const agc_fx_t* a, const agc_fx_t* b, agc_fx_t* result);
+agc_fx_t
+agc_fx_vec_dot(const agc_fx_t* a, const agc_fx_t* b);
+agc_fx_t
+agc_fx_vec_mag(const agc_fx_t* a);
+
+#endif /* AGC_FIXED_H */
@@ -88,7 +88,8 @@ agc_dp_t
 agc_dp_pack(agc_word_t high, agc_word_t low)
 {
   agc_dp_t result = (agc_dp_t)high * 16384;
-  if (high >= 0) {
+  /* A zero high word takes its sign from the low word */
+  if (high > 0 || (high == 0 && low >= 0)) {
     result += (agc_dp_t)(low & 0x3FFF);
   } else {
     result -= (agc_dp_t)((-low) & 0x3FFF);
@@ -5,6 +5,7 @@
  */
 
 #include "agc.h"
+#include "agc_context.h"
 #include "agc_cpu.h"
 #include "alarm.h"
 #include "executive.h"
@@ -12,9 +13,48 @@
 int agc_alarm_code = 0;
 int agc_prog_alarm = 0;
 
+alarm_stat_t alarm_stats[ALARM_STATS_CODES];
+int alarm_stats_used = 0;
+unsigned long alarm_raised_total = 0;
+
+static void
+alarm_count(int code)
+{
+  int i;
+  alarm_raised_total++;
+  for (i = 0; i < alarm_stats_used; i++) {
+    if (alarm_stats[i].code == code) {
+      alarm_stats[i].count++;
+      return;
+    }
+  }
+  if (alarm_stats_used < ALARM_STATS_CODES) {
+    alarm_stats[alarm_stats_used].code = code;
+    alarm_stats[alarm_stats_used].count = 1;
+    alarm_stats_used++;
+  }
+}
+
+/* CHKFAIL: the first two alarms since RSET keep their registers, any
+ * later one replaces the third */
+static void
+alarm_store_failreg(int code)
+{
+  int i;
+  for (i = 0; i < 2; i++) {
+    if (agc_read_erasable(EBANK_UNSWITCHED, FAILREG + i) == 0) {
+      agc_write_erasable(EBANK_UNSWITCHED, FAILREG + i, (agc_word_t)code);
+      return;
+    }
+  }
+  agc_write_erasable(EBANK_UNSWITCHED, FAILREG + 2, (agc_word_t)code);
+}
+
 void
 alarm_set(int code)
 {
+  alarm_count(code);
+  alarm_store_failreg(code);
   agc_alarm_code = code;
   agc_prog_alarm = 1;
   agc_channels[CHAN_DSALMOUT] |= BIT11;
@@ -30,7 +70,18 @@ alarm_abort(int code)
 void
 alarm_reset(void)
 {
+  int i;
   agc_alarm_code = 0;
   agc_prog_alarm = 0;
+  for (i = 0; i < 3; i++) {
+    agc_write_erasable(EBANK_UNSWITCHED, FAILREG + i, 0);
+  }
   agc_channels[CHAN_DSALMOUT] &= ~BIT11;
 }
+
+void
+alarm_register_state(void)
+{
+  agc_context_register(&agc_alarm_code, sizeof(agc_alarm_code));
+  agc_context_register(&agc_prog_alarm, sizeof(agc_prog_alarm));
+}
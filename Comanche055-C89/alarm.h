@@ -3,7 +3,11 @@
  *
  * Provides alarm_set (PROGLARM), alarm_abort (POODOO), and
  * alarm_reset (RSET key handler).  Alarm codes are octal values
- * from the AGC documentation.
+ * from the AGC documentation; the first, second and latest since
+ * RSET are kept in FAILREG for noun 09.
+ *
+ * Every alarm raised is also counted per code for monitoring; the
+ * counts survive RSET and fresh start.
  *
  * Comanche055 (Apollo 11 CM) ANSI C89 port.
  */
@@ -22,11 +26,25 @@
 extern int agc_alarm_code;
 extern int agc_prog_alarm;
 
+#define ALARM_STATS_CODES 16
+
+typedef struct
+{
+  int code;
+  unsigned long count;
+} alarm_stat_t;
+
+extern alarm_stat_t alarm_stats[ALARM_STATS_CODES];
+extern int alarm_stats_used;
+extern unsigned long alarm_raised_total;
+
 void
 alarm_set(int code);
 void
 alarm_abort(int code);
 void
 alarm_reset(void);
+void
+alarm_register_state(void);
 
 #endif /* ALARM_H */
@@ -5,38 +5,202 @@
  */
 
 #include "args.h"
+#include "agc_context.h"
 #include "dsky.h"
 #include "dsky_backend.h"
+#include "dsky_dashboard.h"
+#include "dsky_fanout.h"
+#include "dsky_log.h"
+#include "macro.h"
 #include "dsky_web.h"
+#include "integration.h"
 
 #ifdef _WIN32
 #include "dsky_gui.h"
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-dsky_backend_t*
-args_parse_backend(int argc, char* argv[])
+static dsky_backend_t*
+args_backend_by_name(const char* name, size_t len)
 {
-  if (argc < 2) {
-    return NULL;
+  static const struct
+  {
+    const char* name;
+    dsky_backend_t* backend;
+  } names[] = { { "console", &dsky_console_backend },
+                { "dashboard", &dsky_dashboard_backend },
+                { "log", &dsky_log_backend },
+                { "web", &dsky_web_backend },
+#ifdef _WIN32
+                { "gui", &dsky_gui_backend },
+#endif
+  };
+  size_t i;
+
+  for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (strlen(names[i].name) == len &&
+        strncmp(names[i].name, name, len) == 0) {
+      return names[i].backend;
+    }
   }
+  return NULL;
+}
 
-  if (strcmp(argv[1], "console") == 0) {
-    return &dsky_console_backend;
+/* True if the selected backend is target or fans out to it */
+static int
+args_uses(const dsky_backend_t* backend, const dsky_backend_t* target)
+{
+  if (backend == &dsky_fanout_backend) {
+    return dsky_fanout_contains(target);
   }
+  return backend == target;
+}
+
+/* "console,web@10": sinks separated by commas, each with an optional
+ * update rate in Hz.  A single sink at full rate is used directly. */
+static dsky_backend_t*
+args_parse_sinks(const char* spec)
+{
+  dsky_backend_t* sinks[DSKY_FANOUT_MAX_SINKS];
+  int rates[DSKY_FANOUT_MAX_SINKS];
+  const char* p;
+  size_t len;
+  long rate;
+  char* end;
+  int count, i;
 
-  if (strcmp(argv[1], "web") == 0) {
-    return &dsky_web_backend;
+  count = 0;
+  p = spec;
+  while (1) {
+    len = strcspn(p, ",@");
+    if (count == DSKY_FANOUT_MAX_SINKS) {
+      printf("Too many backends: %s\n", spec);
+      return NULL;
+    }
+    sinks[count] = args_backend_by_name(p, len);
+    if (sinks[count] == NULL) {
+      printf("Unknown backend: %.*s\n", (int)len, p);
+      return NULL;
+    }
+    rates[count] = 0;
+    p += len;
+    if (*p == '@') {
+      rate = strtol(p + 1, &end, 10);
+      if (end == p + 1 || (*end != ',' && *end != '\0') || rate < 1 ||
+          rate > 1000) {
+        printf("Invalid update rate in: %s\n", spec);
+        return NULL;
+      }
+      rates[count] = (int)rate;
+      p = end;
+    }
+    count++;
+    if (*p != ',') {
+      break;
+    }
+    p++;
   }
 
-#ifdef _WIN32
-  if (strcmp(argv[1], "gui") == 0) {
-    return &dsky_gui_backend;
+  if (count == 1 && rates[0] == 0) {
+    return sinks[0];
   }
-#endif
+  for (i = 0; i < count; i++) {
+    if (dsky_fanout_add(sinks[i], rates[i]) != 0) {
+      printf("Backend listed twice: %s\n", spec);
+      return NULL;
+    }
+  }
+  if (dsky_fanout_contains(&dsky_console_backend) &&
+      dsky_fanout_contains(&dsky_dashboard_backend)) {
+    printf("console and dashboard cannot share the terminal\n");
+    return NULL;
+  }
+  return &dsky_fanout_backend;
+}
 
-  printf("Unknown backend: %s\n", argv[1]);
-  return NULL;
+/* Options after the backend name: --sse-max-fps N (web),
+ * --instances N (dashboard), --log-file PATH and --log-mmap (log);
+ * for any backend, --macro FILE, --macro-interval CS, --macro-exit
+ * and --nav-reference */
+static int
+args_parse_options(dsky_backend_t* backend, int argc, char* argv[])
+{
+  int i;
+  long value;
+  char* end;
+  char err[MACRO_MESSAGE_MAX];
+
+  for (i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--sse-max-fps") == 0 && i + 1 < argc &&
+        args_uses(backend, &dsky_web_backend)) {
+      value = strtol(argv[i + 1], &end, 10);
+      if (*end != '\0' || value < 0 || value > 1000) {
+        printf("Invalid --sse-max-fps value: %s\n", argv[i + 1]);
+        return -1;
+      }
+      dsky_web_set_max_fps((int)value);
+      i++;
+    } else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc &&
+               args_uses(backend, &dsky_dashboard_backend)) {
+      value = strtol(argv[i + 1], &end, 10);
+      if (*end != '\0' || value < 1 || value > AGC_CONTEXT_MAX) {
+        printf("Invalid --instances value: %s (1-%d)\n",
+               argv[i + 1],
+               AGC_CONTEXT_MAX);
+        return -1;
+      }
+      dsky_dashboard_set_instances((int)value);
+      i++;
+    } else if (strcmp(argv[i], "--log-file") == 0 && i + 1 < argc &&
+               args_uses(backend, &dsky_log_backend)) {
+      dsky_log_set_path(argv[++i]);
+    } else if (strcmp(argv[i], "--log-mmap") == 0 &&
+               args_uses(backend, &dsky_log_backend)) {
+      dsky_log_set_mmap(1);
+    } else if (strcmp(argv[i], "--macro") == 0 && i + 1 < argc) {
+      if (macro_load_file(argv[i + 1], err, sizeof(err)) != 0) {
+        printf("%s: %s\n", argv[i + 1], err);
+        return -1;
+      }
+      i++;
+    } else if (strcmp(argv[i], "--macro-interval") == 0 && i + 1 < argc) {
+      value = strtol(argv[i + 1], &end, 10);
+      if (*end != '\0' || value < 0 || value > 16383) {
+        printf("Invalid --macro-interval value: %s\n", argv[i + 1]);
+        return -1;
+      }
+      macro_interval_cs = (int)value;
+      i++;
+    } else if (strcmp(argv[i], "--macro-exit") == 0) {
+      macro_exit_when_done = 1;
+    } else if (strcmp(argv[i], "--nav-reference") == 0) {
+      integ_reference_enabled = 1;
+    } else {
+      printf("Unknown option: %s\n", argv[i]);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+dsky_backend_t*
+args_parse_backend(int argc, char* argv[])
+{
+  dsky_backend_t* backend;
+
+  if (argc < 2) {
+    return NULL;
+  }
+
+  backend = args_parse_sinks(argv[1]);
+  if (backend == NULL) {
+    return NULL;
+  }
+  if (args_parse_options(backend, argc, argv) != 0) {
+    return NULL;
+  }
+  return backend;
 }
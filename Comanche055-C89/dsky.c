@@ -5,6 +5,7 @@
  */
 
 #include "agc.h"
+#include "agc_context.h"
 #include "agc_cpu.h"
 #include "dsky.h"
 #include "dsky_backend.h"
@@ -54,6 +55,12 @@ dsky_init(void)
   dsky_needs_redraw = 1;
 }
 
+void
+dsky_register_state(void)
+{
+  agc_context_register(&dsky_display, sizeof(dsky_display));
+}
+
 /* ----------------------------------------------------------------
  * Render helpers
  * ---------------------------------------------------------------- */
@@ -102,125 +109,134 @@ light_str(char* buf, int on, const char* name)
 
 /* ----------------------------------------------------------------
  * Render DSKY to console
+ *
+ * Draws into the terminal's virtual screen; term_vs_flush() then
+ * sends only the cells that differ from the last frame, in one write.
  * ---------------------------------------------------------------- */
 
+static const char* const dsky_frame_lines[] = {
+  "+------------- DSKY -------------+",
+  "|                                |",
+  "|                                |",
+  "|                                |",
+  "|                                |",
+  "|                                |",
+  "|                                |",
+  "|                                |",
+  "|                                |",
+  "|                                |",
+  "|                                |",
+  "|                                |",
+  "|                                |",
+  "|                                |",
+  "| Keys: V=VERB N=NOUN E=ENTR     |",
+  "| 0-9=digits +=PLUS -=MINUS      |",
+  "| C=CLR  P=PRO  K=KREL  R=RSET   |",
+  "| Q=QUIT                         |",
+  "|                                |",
+  "+--------------------------------+"
+};
+
+#define DSKY_FRAME_LINES                                                      \
+  ((int)(sizeof(dsky_frame_lines) / sizeof(dsky_frame_lines[0])))
+
 static void
-dsky_render(void)
+render_lights(int line,
+              int on_a,
+              const char* name_a,
+              int on_b,
+              const char* name_b,
+              int on_c,
+              const char* name_c)
 {
-  static int first_render = 1;
-
-  if (first_render) {
-    term_clear_screen();
-
-    printf("+------------- DSKY -------------+\n");
-    printf("|                                |\n");
-    printf("|                                |\n");
-    printf("|                                |\n");
-    printf("|                                |\n");
-    printf("|                                |\n");
-    printf("|                                |\n");
-    printf("|                                |\n");
-    printf("|                                |\n");
-    printf("|                                |\n");
-    printf("|                                |\n");
-    printf("|                                |\n");
-    printf("|                                |\n");
-    printf("|                                |\n");
-    printf("| Keys: V=VERB N=NOUN E=ENTR     |\n");
-    printf("| 0-9=digits +=PLUS -=MINUS      |\n");
-    printf("| C=CLR  P=PRO  K=KREL  R=RSET   |\n");
-    printf("| Q=QUIT                         |\n");
-    printf("|                                |\n");
-    printf("+--------------------------------+\n");
-
-    first_render = 0;
-  }
+  char a[12], b[12], c[12];
+  char row[48];
+  light_str(a, on_a, name_a);
+  light_str(b, on_b, name_b);
+  light_str(c, on_c, name_c);
+  sprintf(row, " %s %s %s  ", a, b, c);
+  term_vs_put(line, 2, row);
+}
 
-  /* Status lights row 1 */
-  {
-    char a[12], b[12], c[12];
-    light_str(a, dsky_display.light_uplink_acty, "UPLINK");
-    light_str(b, dsky_display.light_temp, "TEMP");
-    light_str(c, dsky_display.light_prog_alarm, "PROG");
-    term_set_cursor(3, 2);
-    printf(" %s %s %s  ", a, b, c);
-  }
+static void
+render_register(int line, const char* name, int sign, const int* digits)
+{
+  char row[48];
+  sprintf(row,
+          "  %s   %s%c%c%c%c%c                   ",
+          name,
+          sign_str(sign),
+          digit_char(digits[0]),
+          digit_char(digits[1]),
+          digit_char(digits[2]),
+          digit_char(digits[3]),
+          digit_char(digits[4]));
+  term_vs_put(line, 2, row);
+}
 
-  /* Status lights row 2 */
-  {
-    char a[12], b[12], c[12];
-    light_str(a, dsky_display.light_gimbal_lock, "GIMBAL");
-    light_str(b, dsky_display.light_stby, "STBY");
-    light_str(c, dsky_display.light_restart, "RSTART");
-    term_set_cursor(4, 2);
-    printf(" %s %s %s  ", a, b, c);
-  }
+static void
+dsky_render(void)
+{
+  char row[48];
+  int i;
 
-  /* Status lights row 3 */
-  {
-    char a[12], b[12], c[12];
-    light_str(a, dsky_display.light_no_att, "NO ATT");
-    light_str(b, dsky_display.light_key_rel, "KEY RL");
-    light_str(c, dsky_display.light_tracker, "TRACKER");
-    term_set_cursor(5, 2);
-    printf(" %s %s %s  ", a, b, c);
+  for (i = 0; i < DSKY_FRAME_LINES; i++) {
+    term_vs_put(i + 1, 1, dsky_frame_lines[i]);
   }
 
-  /* Status lights row 4 */
-  {
-    char a[12], b[12], c[12];
-    light_str(a, dsky_display.light_opr_err, "OPR ER");
-    light_str(b, dsky_display.light_vel, "VEL");
-    light_str(c, dsky_display.light_alt, "ALT");
-    term_set_cursor(6, 2);
-    printf(" %s %s %s  ", a, b, c);
-  }
+  render_lights(3,
+                dsky_display.light_uplink_acty,
+                "UPLINK",
+                dsky_display.light_temp,
+                "TEMP",
+                dsky_display.light_prog_alarm,
+                "PROG");
+  render_lights(4,
+                dsky_display.light_gimbal_lock,
+                "GIMBAL",
+                dsky_display.light_stby,
+                "STBY",
+                dsky_display.light_restart,
+                "RSTART");
+  render_lights(5,
+                dsky_display.light_no_att,
+                "NO ATT",
+                dsky_display.light_key_rel,
+                "KEY RL",
+                dsky_display.light_tracker,
+                "TRACKER");
+  render_lights(6,
+                dsky_display.light_opr_err,
+                "OPR ER",
+                dsky_display.light_vel,
+                "VEL",
+                dsky_display.light_alt,
+                "ALT");
 
   /* COMP ACTY and PROG */
-  term_set_cursor(8, 2);
-  printf("  %s   PROG  %c%c          ",
-         dsky_display.light_comp_acty ? "COMP ACTY" : "         ",
-         digit_char(dsky_display.prog[0]),
-         digit_char(dsky_display.prog[1]));
+  sprintf(row,
+          "  %s   PROG  %c%c          ",
+          dsky_display.light_comp_acty ? "COMP ACTY" : "         ",
+          digit_char(dsky_display.prog[0]),
+          digit_char(dsky_display.prog[1]));
+  term_vs_put(8, 2, row);
 
   /* VERB and NOUN */
-  term_set_cursor(9, 2);
-  printf("  VERB  %c%c    NOUN  %c%c          ",
-         digit_char(dsky_display.verb[0]),
-         digit_char(dsky_display.verb[1]),
-         digit_char(dsky_display.noun[0]),
-         digit_char(dsky_display.noun[1]));
+  sprintf(row,
+          "  VERB  %c%c    NOUN  %c%c          ",
+          digit_char(dsky_display.verb[0]),
+          digit_char(dsky_display.verb[1]),
+          digit_char(dsky_display.noun[0]),
+          digit_char(dsky_display.noun[1]));
+  term_vs_put(9, 2, row);
 
   /* R1, R2, R3 */
-  term_set_cursor(11, 2);
-  printf("  R1   %s%c%c%c%c%c                   ",
-         sign_str(dsky_display.r1_sign),
-         digit_char(dsky_display.r1[0]),
-         digit_char(dsky_display.r1[1]),
-         digit_char(dsky_display.r1[2]),
-         digit_char(dsky_display.r1[3]),
-         digit_char(dsky_display.r1[4]));
-
-  term_set_cursor(12, 2);
-  printf("  R2   %s%c%c%c%c%c                   ",
-         sign_str(dsky_display.r2_sign),
-         digit_char(dsky_display.r2[0]),
-         digit_char(dsky_display.r2[1]),
-         digit_char(dsky_display.r2[2]),
-         digit_char(dsky_display.r2[3]),
-         digit_char(dsky_display.r2[4]));
-
-  term_set_cursor(13, 2);
-  printf("  R3   %s%c%c%c%c%c                   ",
-         sign_str(dsky_display.r3_sign),
-         digit_char(dsky_display.r3[0]),
-         digit_char(dsky_display.r3[1]),
-         digit_char(dsky_display.r3[2]),
-         digit_char(dsky_display.r3[3]),
-         digit_char(dsky_display.r3[4]));
-
-  term_set_cursor(21, 0);
-  fflush(stdout);
+  render_register(11, "R1", dsky_display.r1_sign, dsky_display.r1);
+  render_register(12, "R2", dsky_display.r2_sign, dsky_display.r2);
+  render_register(13, "R3", dsky_display.r3_sign, dsky_display.r3);
+
+  /* Park the cursor below the panel, as the full redraw did */
+  term_vs_flush(21, 0);
 }
 
 /* ----------------------------------------------------------------
@@ -232,6 +248,9 @@ dsky_update(void)
 {
   if (dsky_needs_redraw ||
       memcmp(&dsky_display, &dsky_prev, sizeof(dsky_display)) != 0) {
+    if (dsky_needs_redraw) {
+      term_vs_invalidate();
+    }
     dsky_render();
     dsky_prev = dsky_display;
     dsky_needs_redraw = 0;
@@ -285,99 +304,84 @@ dsky_submit_key(int keycode)
  * Poll keyboard input
  * ---------------------------------------------------------------- */
 
-void
-dsky_poll_input(void)
+/* Keyboard character to DSKY keycode, or DSKY_KEY_NONE */
+int
+dsky_keycode_for_char(int ch)
 {
-  int ch, keycode;
-  if (!hal_kbhit()) {
-    return;
-  }
-
-  ch = hal_getch();
-  keycode = -2;
-
   switch (ch) {
     case '0':
-      keycode = DSKY_KEY_0;
-      break;
+      return DSKY_KEY_0;
     case '1':
-      keycode = DSKY_KEY_1;
-      break;
+      return DSKY_KEY_1;
     case '2':
-      keycode = DSKY_KEY_2;
-      break;
+      return DSKY_KEY_2;
     case '3':
-      keycode = DSKY_KEY_3;
-      break;
+      return DSKY_KEY_3;
     case '4':
-      keycode = DSKY_KEY_4;
-      break;
+      return DSKY_KEY_4;
     case '5':
-      keycode = DSKY_KEY_5;
-      break;
+      return DSKY_KEY_5;
     case '6':
-      keycode = DSKY_KEY_6;
-      break;
+      return DSKY_KEY_6;
     case '7':
-      keycode = DSKY_KEY_7;
-      break;
+      return DSKY_KEY_7;
     case '8':
-      keycode = DSKY_KEY_8;
-      break;
+      return DSKY_KEY_8;
     case '9':
-      keycode = DSKY_KEY_9;
-      break;
+      return DSKY_KEY_9;
     case 'v':
     case 'V':
-      keycode = DSKY_KEY_VERB;
-      break;
+      return DSKY_KEY_VERB;
     case 'n':
     case 'N':
-      keycode = DSKY_KEY_NOUN;
-      break;
+      return DSKY_KEY_NOUN;
     case '+':
     case '=':
-      keycode = DSKY_KEY_PLUS;
-      break;
+      return DSKY_KEY_PLUS;
     case '-':
     case '_':
-      keycode = DSKY_KEY_MINUS;
-      break;
+      return DSKY_KEY_MINUS;
     case 'e':
     case 'E':
     case '\r':
     case '\n':
-      keycode = DSKY_KEY_ENTR;
-      break;
+      return DSKY_KEY_ENTR;
     case 'c':
     case 'C':
-      keycode = DSKY_KEY_CLR;
-      break;
+      return DSKY_KEY_CLR;
     case 'p':
     case 'P':
-      keycode = DSKY_KEY_PRO;
-      break;
+      return DSKY_KEY_PRO;
     case 'k':
     case 'K':
-      keycode = DSKY_KEY_KREL;
-      break;
+      return DSKY_KEY_KREL;
     case 'r':
     case 'R':
-      keycode = DSKY_KEY_RSET;
-      break;
-    case 'q':
-    case 'Q':
-      term_cleanup();
-      term_clear_screen();
-      hal_term_cleanup();
-      printf("Comanche055 terminated.\n");
-      exit(0);
-      break;
+      return DSKY_KEY_RSET;
     default:
-      break;
+      return DSKY_KEY_NONE;
+  }
+}
+
+void
+dsky_poll_input(void)
+{
+  int ch, keycode;
+  if (!hal_kbhit()) {
+    return;
+  }
+
+  ch = hal_getch();
+  if (ch == 'q' || ch == 'Q') {
+    term_cleanup();
+    term_clear_screen();
+    hal_term_cleanup();
+    printf("Comanche055 terminated.\n");
+    exit(0);
   }
 
-  if (keycode != -2) {
+  keycode = dsky_keycode_for_char(ch);
+  if (keycode != DSKY_KEY_NONE) {
     dsky_submit_key(keycode);
   }
 }
@@ -74,6 +74,7 @@ extern dsky_display_t dsky_display;
 #define DSKY_KEY_PRO -1
 #define DSKY_KEY_KREL 031
 #define DSKY_KEY_RSET 022
+#define DSKY_KEY_NONE -2
 
 /* ----------------------------------------------------------------
  * DSKY API
@@ -82,11 +83,15 @@ extern dsky_display_t dsky_display;
 void
 dsky_init(void);
 void
+dsky_register_state(void);
+void
 dsky_update(void);
 void
 dsky_poll_input(void);
 void
 dsky_submit_key(int keycode);
+int
+dsky_keycode_for_char(int ch);
 void
 dsky_t4rupt(void);
 void
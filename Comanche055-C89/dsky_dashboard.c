@@ -0,0 +1,259 @@
+/*
+ * dsky_dashboard.c -- Console grid of DSKYs, one per AGC instance.
+ *
+ * Runs several independent AGC contexts (agc_context.h) and draws a
+ * compact DSKY pane for each into the terminal's virtual screen.  A
+ * pane is redrawn only when its context's display changed, and the
+ * frame goes out as one diffed write.  Keys go to the focused pane;
+ * Tab moves the focus.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "agc_context.h"
+#include "dsky.h"
+#include "dsky_backend.h"
+#include "dsky_dashboard.h"
+#include "hal.h"
+#include "terminal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DASH_DEFAULT_INSTANCES 4
+#define DASH_GRID_COLUMNS 4
+#define DASH_PANE_WIDTH 32
+#define DASH_PANE_HEIGHT 9
+#define DASH_PANE_STEP_X (DASH_PANE_WIDTH + 1)
+#define DASH_PANE_STEP_Y (DASH_PANE_HEIGHT + 1)
+#define DASH_TOP_LINE 3
+
+typedef struct
+{
+  dsky_display_t shown;
+  int shown_valid;
+  int shown_focus;
+} dash_pane_t;
+
+static int dash_instances = DASH_DEFAULT_INSTANCES;
+static int dash_focus = 0;
+static dash_pane_t dash_panes[AGC_CONTEXT_MAX];
+
+/* ----------------------------------------------------------------
+ * Pane rendering
+ * ---------------------------------------------------------------- */
+
+static char
+dash_digit(int d)
+{
+  if (d < 0 || d > 9) {
+    return ' ';
+  }
+  return (char)('0' + d);
+}
+
+static char
+dash_sign(int s)
+{
+  if (s > 0) {
+    return '+';
+  }
+  if (s < 0) {
+    return '-';
+  }
+  return ' ';
+}
+
+static const char*
+dash_light(int on, const char* name)
+{
+  return on ? name : "    ";
+}
+
+static void
+dash_register(int line, int column, const char* name, int sign, const int* r)
+{
+  char row[DASH_PANE_WIDTH + 1];
+  sprintf(row,
+          "| %s  %c%c%c%c%c%c                   |",
+          name,
+          dash_sign(sign),
+          dash_digit(r[0]),
+          dash_digit(r[1]),
+          dash_digit(r[2]),
+          dash_digit(r[3]),
+          dash_digit(r[4]));
+  term_vs_put(line, column, row);
+}
+
+static void
+dash_render_pane(int id, const dsky_display_t* d, int focused)
+{
+  char row[DASH_PANE_WIDTH + 1];
+  char edge;
+  int line, column, i;
+
+  line = DASH_TOP_LINE + (id / DASH_GRID_COLUMNS) * DASH_PANE_STEP_Y;
+  column = 1 + (id % DASH_GRID_COLUMNS) * DASH_PANE_STEP_X;
+  edge = focused ? '=' : '-';
+
+  /* Title and bottom borders; '=' marks the pane receiving keys */
+  row[0] = '+';
+  for (i = 1; i < DASH_PANE_WIDTH - 1; i++) {
+    row[i] = edge;
+  }
+  row[DASH_PANE_WIDTH - 1] = '+';
+  row[DASH_PANE_WIDTH] = '\0';
+  term_vs_put(line + DASH_PANE_HEIGHT - 1, column, row);
+  i = sprintf(row + 1, "%c[%d]", edge, id + 1);
+  row[1 + i] = edge;
+  term_vs_put(line, column, row);
+
+  sprintf(row,
+          "|%s %s %s %s %s %s |",
+          dash_light(d->light_uplink_acty, "UPLK"),
+          dash_light(d->light_temp, "TEMP"),
+          dash_light(d->light_prog_alarm, "PROG"),
+          dash_light(d->light_gimbal_lock, "GMBL"),
+          dash_light(d->light_stby, "STBY"),
+          dash_light(d->light_restart, "RSTR"));
+  term_vs_put(line + 1, column, row);
+  sprintf(row,
+          "|%s %s %s %s %s %s |",
+          dash_light(d->light_no_att, "NATT"),
+          dash_light(d->light_key_rel, "KREL"),
+          dash_light(d->light_tracker, "TRAK"),
+          dash_light(d->light_opr_err, "OPER"),
+          dash_light(d->light_vel, "VEL "),
+          dash_light(d->light_alt, "ALT "));
+  term_vs_put(line + 2, column, row);
+
+  sprintf(row,
+          "| %s       PROG  %c%c          |",
+          d->light_comp_acty ? "COMP" : "    ",
+          dash_digit(d->prog[0]),
+          dash_digit(d->prog[1]));
+  term_vs_put(line + 3, column, row);
+  sprintf(row,
+          "| VERB  %c%c   NOUN  %c%c          |",
+          dash_digit(d->verb[0]),
+          dash_digit(d->verb[1]),
+          dash_digit(d->noun[0]),
+          dash_digit(d->noun[1]));
+  term_vs_put(line + 4, column, row);
+
+  dash_register(line + 5, column, "R1", d->r1_sign, d->r1);
+  dash_register(line + 6, column, "R2", d->r2_sign, d->r2);
+  dash_register(line + 7, column, "R3", d->r3_sign, d->r3);
+}
+
+/* ----------------------------------------------------------------
+ * Backend
+ * ---------------------------------------------------------------- */
+
+void
+dsky_dashboard_set_instances(int count)
+{
+  if (count < 1) {
+    count = 1;
+  }
+  if (count > AGC_CONTEXT_MAX) {
+    count = AGC_CONTEXT_MAX;
+  }
+  dash_instances = count;
+}
+
+static void
+dash_init(void)
+{
+  char title[96];
+  int i;
+
+  /* Instance 0 is the state main() already started; clone the rest */
+  for (i = agc_context_count(); i < dash_instances; i++) {
+    if (agc_context_create() < 0) {
+      fprintf(stderr, "Dashboard init failed: no AGC context left\n");
+      exit(1);
+    }
+  }
+
+  hal_term_init();
+  term_init();
+  term_vs_invalidate();
+  memset(dash_panes, 0, sizeof(dash_panes));
+  dash_focus = 0;
+
+  sprintf(title,
+          "COMANCHE 055 DASHBOARD -- %d AGC instances   Tab=next pane  "
+          "Q=quit",
+          dash_instances);
+  term_vs_put(1, 1, title);
+}
+
+static void
+dash_update(void)
+{
+  const dsky_display_t* d;
+  dash_pane_t* pane;
+  int id, focused;
+
+  for (id = 0; id < agc_context_count(); id++) {
+    d = (const dsky_display_t*)agc_context_block(id, &dsky_display);
+    pane = &dash_panes[id];
+    focused = (id == dash_focus);
+    if (pane->shown_valid && pane->shown_focus == focused &&
+        memcmp(&pane->shown, d, sizeof(*d)) == 0) {
+      continue;
+    }
+    dash_render_pane(id, d, focused);
+    pane->shown = *d;
+    pane->shown_valid = 1;
+    pane->shown_focus = focused;
+  }
+  term_vs_flush(0, 0);
+}
+
+static void
+dash_poll_input(void)
+{
+  int ch, keycode;
+
+  while (hal_kbhit()) {
+    ch = hal_getch();
+    if (ch == 'q' || ch == 'Q') {
+      term_cleanup();
+      term_clear_screen();
+      hal_term_cleanup();
+      printf("Comanche055 terminated.\n");
+      exit(0);
+    }
+    if (ch == '\t') {
+      dash_focus = (dash_focus + 1) % agc_context_count();
+      continue;
+    }
+    keycode = dsky_keycode_for_char(ch);
+    if (keycode != DSKY_KEY_NONE) {
+      agc_context_switch(dash_focus);
+      dsky_submit_key(keycode);
+      agc_context_switch(0);
+    }
+  }
+}
+
+static void
+dash_cleanup(void)
+{
+  term_cleanup();
+  hal_term_cleanup();
+}
+
+dsky_backend_t dsky_dashboard_backend = { dash_init,
+                                          dash_update,
+                                          dash_poll_input,
+                                          dash_cleanup,
+                                          hal_sleep_ms };
@@ -0,0 +1,18 @@
+/*
+ * dsky_dashboard.h -- Console grid of DSKYs, one per AGC instance.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifndef DSKY_DASHBOARD_H
+#define DSKY_DASHBOARD_H
+
+#include "dsky_backend.h"
+
+extern dsky_backend_t dsky_dashboard_backend;
+
+/* Number of AGC instances to run and show (1..AGC_CONTEXT_MAX) */
+void
+dsky_dashboard_set_instances(int count);
+
+#endif /* DSKY_DASHBOARD_H */
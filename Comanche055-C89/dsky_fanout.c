@@ -0,0 +1,118 @@
+/*
+ * dsky_fanout.c -- Composite backend driving several sinks at once.
+ *
+ * One simulation, many displays: the console for the operator, the
+ * web server for observers, and so on.  Every sink is polled for
+ * input on each loop pass, but its update() only runs once its own
+ * interval has elapsed, so an expensive sink at a low rate does not
+ * slow down the others.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#include "dsky_fanout.h"
+#include "hal.h"
+
+typedef struct
+{
+  dsky_backend_t* backend;
+  int interval_ms; /* 0 = update on every loop pass */
+  long last_update_ms;
+} fanout_sink_t;
+
+static fanout_sink_t fanout_sinks[DSKY_FANOUT_MAX_SINKS];
+static int fanout_count = 0;
+
+int
+dsky_fanout_add(dsky_backend_t* backend, int rate_hz)
+{
+  fanout_sink_t* sink;
+
+  if (fanout_count >= DSKY_FANOUT_MAX_SINKS ||
+      dsky_fanout_contains(backend)) {
+    return -1;
+  }
+  sink = &fanout_sinks[fanout_count++];
+  sink->backend = backend;
+  sink->interval_ms = rate_hz > 0 ? 1000 / rate_hz : 0;
+  sink->last_update_ms = 0;
+  return 0;
+}
+
+int
+dsky_fanout_contains(const dsky_backend_t* backend)
+{
+  int i;
+  for (i = 0; i < fanout_count; i++) {
+    if (fanout_sinks[i].backend == backend) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* ----------------------------------------------------------------
+ * Backend
+ * ---------------------------------------------------------------- */
+
+static void
+fanout_init(void)
+{
+  int i;
+  for (i = 0; i < fanout_count; i++) {
+    fanout_sinks[i].backend->init();
+  }
+}
+
+static void
+fanout_update(void)
+{
+  fanout_sink_t* sink;
+  long now;
+  int i;
+
+  now = hal_time_ms();
+  for (i = 0; i < fanout_count; i++) {
+    sink = &fanout_sinks[i];
+    if (sink->interval_ms > 0 &&
+        now - sink->last_update_ms < sink->interval_ms) {
+      continue;
+    }
+    sink->last_update_ms = now;
+    sink->backend->update();
+  }
+}
+
+static void
+fanout_poll_input(void)
+{
+  int i;
+  for (i = 0; i < fanout_count; i++) {
+    fanout_sinks[i].backend->poll_input();
+  }
+}
+
+static void
+fanout_cleanup(void)
+{
+  int i;
+  for (i = fanout_count - 1; i >= 0; i--) {
+    fanout_sinks[i].backend->cleanup();
+  }
+}
+
+static void
+fanout_sleep(int ms)
+{
+  if (fanout_count > 0) {
+    fanout_sinks[0].backend->sleep_ms(ms);
+  } else {
+    hal_sleep_ms(ms);
+  }
+}
+
+dsky_backend_t dsky_fanout_backend = { fanout_init,
+                                       fanout_update,
+                                       fanout_poll_input,
+                                       fanout_cleanup,
+                                       fanout_sleep };
@@ -0,0 +1,24 @@
+/*
+ * dsky_fanout.h -- Composite backend driving several sinks at once.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifndef DSKY_FANOUT_H
+#define DSKY_FANOUT_H
+
+#include "dsky_backend.h"
+
+#define DSKY_FANOUT_MAX_SINKS 4
+
+extern dsky_backend_t dsky_fanout_backend;
+
+/* Adds a sink updated at most rate_hz times a second (0 = every
+ * loop pass).  Returns -1 if the sink is already present or the
+ * table is full. */
+int
+dsky_fanout_add(dsky_backend_t* backend, int rate_hz);
+int
+dsky_fanout_contains(const dsky_backend_t* backend);
+
+#endif /* DSKY_FANOUT_H */
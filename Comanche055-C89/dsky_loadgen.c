@@ -0,0 +1,1003 @@
+/*
+ * dsky_loadgen.c -- Load generator for the web DSKY backend.
+ *
+ * Opens many SSE subscribers against a running "comanche055 web"
+ * on 127.0.0.1, types V16E N36E over POST /key at a fixed rate
+ * (the V16 monitor keeps the display changing between keystrokes),
+ * and reports:
+ *
+ *   - key-to-SSE latency percentiles over every subscriber
+ *   - ENTR-to-register-update latency of the N36 monitor
+ *   - subscribers streaming, rejected (503) and dropped mid-stream
+ *   - server CPU from /proc/<pid>/stat when --pid is given
+ *   - server-side drop counters and running monitors from GET
+ *     /metrics (before/after)
+ *
+ * Latency probes: every key except the second verb digit and the
+ * first ENTR leaves a distinct VERB/NOUN digit pattern on the
+ * display.  The ENTR that ends N36 is a monitor probe: it is met by
+ * the first V16 N36 frame whose registers changed, i.e. a refresh of
+ * the monitor it started.  A frame is credited to the newest probe of
+ * the current key cycle it meets; older probes the subscriber never
+ * saw (coalesced away by the server's frame-rate cap) count as
+ * missed.  Keep the key rate below the SSE frame rate for meaningful
+ * percentiles.
+ *
+ * POSIX only (poll, non-blocking sockets, /proc).
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LG_DEFAULT_PORT 8080
+#define LG_DEFAULT_SUBSCRIBERS 1000
+#define LG_DEFAULT_DURATION 10
+#define LG_DEFAULT_KEY_RATE 10
+#define LG_DEFAULT_RAMP 200
+#define LG_LINE_BUF 1024
+#define LG_RX_CHUNK 4096
+#define LG_PROBES_PER_CYCLE 6
+#define LG_MAX_SAMPLES 2000000
+#define LG_BLANK (-1)
+#define LG_ANY (-2)
+
+#define LG_PROBE_NONE 0
+#define LG_PROBE_KEY 1     /* Met by the VERB/NOUN pattern */
+#define LG_PROBE_MONITOR 2 /* Also needs a register refresh */
+
+#define LG_SUB_IDLE 0
+#define LG_SUB_CONNECTING 1
+#define LG_SUB_WAITING 2 /* Request sent, no status line yet */
+#define LG_SUB_STREAMING 3
+#define LG_SUB_REJECTED 4
+#define LG_SUB_DROPPED 5
+#define LG_SUB_FAILED 6
+
+/* DSKY keycodes (AGC channel 15), as accepted by POST /key */
+#define LG_KEY_VERB 17
+#define LG_KEY_NOUN 31
+#define LG_KEY_ENTR 28
+
+typedef struct
+{
+  int port;
+  int subscribers;
+  int duration;
+  int key_rate;
+  int ramp;
+  long pid;
+} lg_options_t;
+
+typedef struct
+{
+  int fd;
+  int state;
+  int in_headers;
+  int next_probe;
+  unsigned long regs_hash; /* R1-R3 of the latest frame */
+  int line_len;
+  char line[LG_LINE_BUF];
+} lg_sub_t;
+
+typedef struct
+{
+  int keycode;
+  int verb[2]; /* Display after the key; LG_ANY = not checked */
+  int noun[2];
+  int probe; /* LG_PROBE_* */
+} lg_step_t;
+
+typedef struct
+{
+  double sent;
+  const lg_step_t* step;
+} lg_probe_t;
+
+typedef struct
+{
+  int fd;
+  double retry_at;
+  int line_len;
+  char line[LG_LINE_BUF];
+} lg_keyer_t;
+
+typedef struct
+{
+  int valid;
+  double stalled;
+  double overflow;
+  double rejected;
+  double monitors;
+} lg_server_stats_t;
+
+/* V16E N36E: pinball latches the verb on its own ENTR */
+static const lg_step_t lg_sequence[] = {
+  { LG_KEY_VERB, { LG_BLANK, LG_BLANK }, { LG_ANY, LG_ANY }, LG_PROBE_KEY },
+  { 1, { 1, LG_BLANK }, { LG_ANY, LG_ANY }, LG_PROBE_KEY },
+  { 6, { 1, 6 }, { LG_ANY, LG_ANY }, LG_PROBE_NONE },
+  { LG_KEY_ENTR, { 1, 6 }, { LG_ANY, LG_ANY }, LG_PROBE_NONE },
+  { LG_KEY_NOUN, { 1, 6 }, { LG_BLANK, LG_BLANK }, LG_PROBE_KEY },
+  { 3, { 1, 6 }, { 3, LG_BLANK }, LG_PROBE_KEY },
+  { 6, { 1, 6 }, { 3, 6 }, LG_PROBE_KEY },
+  { LG_KEY_ENTR, { 1, 6 }, { 3, 6 }, LG_PROBE_MONITOR }
+};
+
+#define LG_SEQUENCE_LEN ((int)(sizeof(lg_sequence) / sizeof(lg_sequence[0])))
+
+static lg_options_t lg_opts;
+static lg_sub_t* lg_subs;
+static lg_probe_t* lg_probes;
+static int lg_probe_count = 0;
+static int lg_probe_cap = 0;
+static double* lg_samples;
+static long lg_sample_count = 0;
+static double* lg_monitor_samples;
+static long lg_monitor_sample_count = 0;
+static long lg_samples_dropped = 0;
+static long lg_probes_missed = 0;
+static long lg_frames = 0;
+static double lg_bytes = 0.0;
+static long lg_keys_sent = 0;
+static long lg_keys_ok = 0;
+static long lg_keys_failed = 0;
+static int lg_connect_errors = 0;
+
+/* ----------------------------------------------------------------
+ * Helpers
+ * ---------------------------------------------------------------- */
+
+static double
+lg_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+lg_usage(const char* argv0)
+{
+  printf("Usage: %s [options]\n"
+         "  --port N         server port on 127.0.0.1 (default %d)\n"
+         "  --subscribers N  SSE connections to open (default %d)\n"
+         "  --duration S     seconds of load after ramp-up (default %d)\n"
+         "  --key-rate N     keys per second to POST /key (default %d)\n"
+         "  --ramp N         new connections per second (default %d)\n"
+         "  --pid P          server pid, for CPU usage from /proc\n",
+         argv0,
+         LG_DEFAULT_PORT,
+         LG_DEFAULT_SUBSCRIBERS,
+         LG_DEFAULT_DURATION,
+         LG_DEFAULT_KEY_RATE,
+         LG_DEFAULT_RAMP);
+}
+
+static int
+lg_parse_options(int argc, char* argv[])
+{
+  int i;
+  long value;
+  char* end;
+
+  lg_opts.port = LG_DEFAULT_PORT;
+  lg_opts.subscribers = LG_DEFAULT_SUBSCRIBERS;
+  lg_opts.duration = LG_DEFAULT_DURATION;
+  lg_opts.key_rate = LG_DEFAULT_KEY_RATE;
+  lg_opts.ramp = LG_DEFAULT_RAMP;
+  lg_opts.pid = 0;
+
+  for (i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      return -1;
+    }
+    value = strtol(argv[i + 1], &end, 10);
+    if (*end != '\0' || value < 0) {
+      return -1;
+    }
+    if (strcmp(argv[i], "--port") == 0 && value > 0 && value < 65536) {
+      lg_opts.port = (int)value;
+    } else if (strcmp(argv[i], "--subscribers") == 0 && value <= 100000) {
+      lg_opts.subscribers = (int)value;
+    } else if (strcmp(argv[i], "--duration") == 0 && value > 0) {
+      lg_opts.duration = (int)value;
+    } else if (strcmp(argv[i], "--key-rate") == 0 && value <= 1000) {
+      lg_opts.key_rate = (int)value;
+    } else if (strcmp(argv[i], "--ramp") == 0 && value > 0) {
+      lg_opts.ramp = (int)value;
+    } else if (strcmp(argv[i], "--pid") == 0 && value > 0) {
+      lg_opts.pid = value;
+    } else {
+      return -1;
+    }
+    i++;
+  }
+  return 0;
+}
+
+static void
+lg_raise_fd_limit(int needed)
+{
+  struct rlimit rl;
+  if (getrlimit(RLIMIT_NOFILE, &rl) != 0) {
+    return;
+  }
+  if (rl.rlim_cur >= (rlim_t)needed) {
+    return;
+  }
+  rl.rlim_cur = (rlim_t)needed;
+  if (rl.rlim_max != RLIM_INFINITY && rl.rlim_cur > rl.rlim_max) {
+    rl.rlim_cur = rl.rlim_max;
+  }
+  if (setrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur < (rlim_t)needed) {
+    fprintf(stderr,
+            "warning: open file limit %lu is below %d; some subscribers "
+            "will fail to connect\n",
+            (unsigned long)rl.rlim_cur,
+            needed);
+  }
+}
+
+static void
+lg_set_addr(struct sockaddr_in* addr)
+{
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons((unsigned short)lg_opts.port);
+  addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+}
+
+static int
+lg_set_nonblocking(int fd)
+{
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0) {
+    return -1;
+  }
+  return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static int
+lg_send_all(int fd, const char* buf, int len)
+{
+  int off;
+  int n;
+
+  off = 0;
+  while (off < len) {
+    n = (int)send(fd, buf + off, (size_t)(len - off), 0);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    off += n;
+  }
+  return 0;
+}
+
+static int
+lg_connect_blocking(void)
+{
+  struct sockaddr_in addr;
+  struct timeval tv;
+  int fd;
+
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  tv.tv_sec = 2;
+  tv.tv_usec = 0;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+  lg_set_addr(&addr);
+  if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* ----------------------------------------------------------------
+ * Server-side statistics (GET /metrics, /proc/<pid>/stat)
+ * ---------------------------------------------------------------- */
+
+/* Sample lines only: "# HELP name ..." must not match a bare name */
+static double
+lg_metric_value(const char* text, const char* sample)
+{
+  const char* p;
+  size_t len;
+
+  len = strlen(sample);
+  for (p = strstr(text, sample); p != NULL; p = strstr(p + 1, sample)) {
+    if (p == text || p[-1] == '\n') {
+      return strtod(p + len, NULL);
+    }
+  }
+  return 0.0;
+}
+
+static lg_server_stats_t
+lg_fetch_server_stats(void)
+{
+  static const char request[] = "GET /metrics HTTP/1.1\r\n"
+                                "Host: 127.0.0.1\r\n"
+                                "Connection: close\r\n"
+                                "\r\n";
+  static char text[16384];
+  lg_server_stats_t st;
+  int fd;
+  int len;
+  int n;
+
+  memset(&st, 0, sizeof(st));
+  fd = lg_connect_blocking();
+  if (fd < 0) {
+    return st;
+  }
+  len = 0;
+  if (lg_send_all(fd, request, (int)strlen(request)) == 0) {
+    while (len < (int)sizeof(text) - 1) {
+      n = (int)recv(fd, text + len, sizeof(text) - 1 - (size_t)len, 0);
+      if (n <= 0) {
+        break;
+      }
+      len += n;
+    }
+  }
+  close(fd);
+  text[len] = '\0';
+
+  if (strncmp(text, "HTTP/1.1 200", 12) != 0) {
+    return st;
+  }
+  st.valid = 1;
+  st.stalled = lg_metric_value(
+    text, "dsky_web_clients_dropped_total{reason=\"stalled\"} ");
+  st.overflow = lg_metric_value(
+    text, "dsky_web_clients_dropped_total{reason=\"overflow\"} ");
+  st.rejected = lg_metric_value(text, "dsky_web_clients_rejected_total ");
+  st.monitors = lg_metric_value(text, "agc_monitors_active ");
+  return st;
+}
+
+/* utime + stime in clock ticks, or -1 */
+static double
+lg_read_cpu_ticks(long pid)
+{
+  char path[64];
+  char buf[1024];
+  FILE* f;
+  char* p;
+  size_t n;
+  int field;
+  double utime;
+
+  sprintf(path, "/proc/%ld/stat", pid);
+  f = fopen(path, "r");
+  if (f == NULL) {
+    return -1.0;
+  }
+  n = fread(buf, 1, sizeof(buf) - 1, f);
+  fclose(f);
+  buf[n] = '\0';
+
+  /* comm may contain spaces; fields resume after the last ')' */
+  p = strrchr(buf, ')');
+  if (p == NULL) {
+    return -1.0;
+  }
+  p++;
+  utime = 0.0;
+  for (field = 3; field <= 15; field++) {
+    while (*p == ' ') {
+      p++;
+    }
+    if (*p == '\0') {
+      return -1.0;
+    }
+    if (field == 14) {
+      utime = strtod(p, NULL);
+    } else if (field == 15) {
+      return utime + strtod(p, NULL);
+    }
+    while (*p != ' ' && *p != '\0') {
+      p++;
+    }
+  }
+  return -1.0;
+}
+
+/* ----------------------------------------------------------------
+ * Probes and frame matching
+ * ---------------------------------------------------------------- */
+
+static int
+lg_digits_match(const int* expect, const int* got)
+{
+  return (expect[0] == LG_ANY || expect[0] == got[0]) &&
+         (expect[1] == LG_ANY || expect[1] == got[1]);
+}
+
+static int
+lg_parse_pair(const char* frame, const char* key, int* out)
+{
+  const char* p;
+  char* end;
+
+  p = strstr(frame, key);
+  if (p == NULL) {
+    return -1;
+  }
+  p += strlen(key);
+  out[0] = (int)strtol(p, &end, 10);
+  if (*end != ',') {
+    return -1;
+  }
+  out[1] = (int)strtol(end + 1, &end, 10);
+  return *end == ']' ? 0 : -1;
+}
+
+static void
+lg_record_sample(int probe, double latency)
+{
+  if (probe == LG_PROBE_MONITOR &&
+      lg_monitor_sample_count < LG_MAX_SAMPLES) {
+    lg_monitor_samples[lg_monitor_sample_count++] = latency;
+  } else if (probe == LG_PROBE_KEY && lg_sample_count < LG_MAX_SAMPLES) {
+    lg_samples[lg_sample_count++] = latency;
+  } else {
+    lg_samples_dropped++;
+  }
+}
+
+/* Hash of the register part of a frame, from "r1" to the end */
+static unsigned long
+lg_regs_hash(const char* frame)
+{
+  const char* p;
+  unsigned long h;
+
+  p = strstr(frame, "\"r1\":");
+  h = 5381ul;
+  if (p != NULL) {
+    for (; *p != '\0'; p++) {
+      h = (h * 33ul) ^ (unsigned long)(unsigned char)*p;
+    }
+  }
+  return h;
+}
+
+static void
+lg_match_frame(lg_sub_t* s, const char* frame, double now)
+{
+  int verb[2];
+  int noun[2];
+  int j;
+  int first;
+  int refreshed;
+  unsigned long regs;
+  const lg_step_t* step;
+
+  if (lg_parse_pair(frame, "\"verb\":[", verb) != 0 ||
+      lg_parse_pair(frame, "\"noun\":[", noun) != 0) {
+    return;
+  }
+  regs = lg_regs_hash(frame);
+  refreshed = regs != s->regs_hash;
+  s->regs_hash = regs;
+
+  /* Patterns repeat every cycle, so only the latest cycle is eligible */
+  first = lg_probe_count - LG_PROBES_PER_CYCLE;
+  if (first < s->next_probe) {
+    first = s->next_probe;
+  }
+  for (j = lg_probe_count - 1; j >= first; j--) {
+    step = lg_probes[j].step;
+    if (lg_digits_match(step->verb, verb) &&
+        lg_digits_match(step->noun, noun) &&
+        (step->probe != LG_PROBE_MONITOR || refreshed)) {
+      lg_probes_missed += j - s->next_probe;
+      lg_record_sample(step->probe, now - lg_probes[j].sent);
+      s->next_probe = j + 1;
+      return;
+    }
+  }
+}
+
+/* ----------------------------------------------------------------
+ * Subscribers
+ * ---------------------------------------------------------------- */
+
+static void
+lg_sub_close(lg_sub_t* s, int state)
+{
+  if (s->fd >= 0) {
+    close(s->fd);
+  }
+  s->fd = -1;
+  s->state = state;
+}
+
+static void
+lg_sub_open(lg_sub_t* s)
+{
+  struct sockaddr_in addr;
+
+  s->fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (s->fd < 0) {
+    lg_connect_errors++;
+    s->state = LG_SUB_FAILED;
+    return;
+  }
+  if (lg_set_nonblocking(s->fd) != 0) {
+    lg_sub_close(s, LG_SUB_FAILED);
+    return;
+  }
+  lg_set_addr(&addr);
+  if (connect(s->fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 &&
+      errno != EINPROGRESS) {
+    lg_connect_errors++;
+    lg_sub_close(s, LG_SUB_FAILED);
+    return;
+  }
+  s->state = LG_SUB_CONNECTING;
+  s->in_headers = 1;
+  s->line_len = 0;
+  s->next_probe = lg_probe_count;
+  s->regs_hash = 0ul;
+}
+
+static void
+lg_sub_connected(lg_sub_t* s)
+{
+  static const char request[] = "GET /events HTTP/1.1\r\n"
+                                "Host: 127.0.0.1\r\n"
+                                "Accept: text/event-stream\r\n"
+                                "\r\n";
+  int err;
+  socklen_t len;
+
+  err = 0;
+  len = (socklen_t)sizeof(err);
+  getsockopt(s->fd, SOL_SOCKET, SO_ERROR, (char*)&err, &len);
+  if (err != 0 || lg_send_all(s->fd, request, (int)strlen(request)) != 0) {
+    lg_connect_errors++;
+    lg_sub_close(s, LG_SUB_FAILED);
+    return;
+  }
+  s->state = LG_SUB_WAITING;
+}
+
+static void
+lg_sub_line(lg_sub_t* s, double now)
+{
+  char* line = s->line;
+
+  if (s->line_len > 0 && line[s->line_len - 1] == '\r') {
+    s->line_len--;
+  }
+  line[s->line_len] = '\0';
+
+  if (s->in_headers) {
+    if (strncmp(line, "HTTP/", 5) == 0) {
+      if (strstr(line, " 200") == NULL) {
+        lg_sub_close(s, LG_SUB_REJECTED);
+      } else {
+        s->state = LG_SUB_STREAMING;
+      }
+    } else if (s->line_len == 0) {
+      s->in_headers = 0;
+    }
+    return;
+  }
+  if (strncmp(line, "data: ", 6) == 0) {
+    lg_frames++;
+    lg_match_frame(s, line + 6, now);
+  }
+}
+
+static void
+lg_sub_read(lg_sub_t* s, double now)
+{
+  char buf[LG_RX_CHUNK];
+  int n;
+  int i;
+
+  n = (int)recv(s->fd, buf, sizeof(buf), 0);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+                 errno != EINTR)) {
+    lg_sub_close(s, LG_SUB_DROPPED);
+    return;
+  }
+  if (n < 0) {
+    return;
+  }
+  lg_bytes += (double)n;
+  for (i = 0; i < n && s->fd >= 0; i++) {
+    if (buf[i] == '\n') {
+      lg_sub_line(s, now);
+      s->line_len = 0;
+    } else if (s->line_len < LG_LINE_BUF - 1) {
+      s->line[s->line_len++] = buf[i];
+    }
+  }
+}
+
+/* ----------------------------------------------------------------
+ * Keyer (one keep-alive connection to POST /key)
+ * ---------------------------------------------------------------- */
+
+/* Reconnects at most once a second so a full server cannot stall the
+ * poll loop in connect() */
+static int
+lg_keyer_connect(lg_keyer_t* k, double now)
+{
+  if (k->fd >= 0) {
+    return 0;
+  }
+  if (now < k->retry_at) {
+    return -1;
+  }
+  k->retry_at = now + 1.0;
+  k->line_len = 0;
+  k->fd = lg_connect_blocking();
+  if (k->fd >= 0 && lg_set_nonblocking(k->fd) != 0) {
+    close(k->fd);
+    k->fd = -1;
+  }
+  return k->fd >= 0 ? 0 : -1;
+}
+
+static void
+lg_keyer_send(lg_keyer_t* k, const lg_step_t* step, double now)
+{
+  char body[32];
+  char request[160];
+  int body_len;
+  int len;
+
+  if (lg_keyer_connect(k, now) != 0) {
+    lg_keys_failed++;
+    return;
+  }
+
+  body_len = sprintf(body, "{\"keycode\":%d}", step->keycode);
+  len = sprintf(request,
+                "POST /key HTTP/1.1\r\n"
+                "Host: 127.0.0.1\r\n"
+                "Content-Type: application/json\r\n"
+                "Content-Length: %d\r\n"
+                "\r\n"
+                "%s",
+                body_len,
+                body);
+  if (lg_send_all(k->fd, request, len) != 0) {
+    close(k->fd);
+    k->fd = -1;
+    lg_keys_failed++;
+    return;
+  }
+  lg_keys_sent++;
+
+  if (step->probe != LG_PROBE_NONE && lg_probe_count < lg_probe_cap) {
+    lg_probes[lg_probe_count].sent = now;
+    lg_probes[lg_probe_count].step = step;
+    lg_probe_count++;
+  }
+}
+
+static void
+lg_keyer_read(lg_keyer_t* k)
+{
+  char buf[LG_RX_CHUNK];
+  char* p;
+  int n;
+  int i;
+
+  n = (int)recv(k->fd, buf, sizeof(buf), 0);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+                 errno != EINTR)) {
+    close(k->fd);
+    k->fd = -1;
+    return;
+  }
+  for (i = 0; i < n; i++) {
+    if (buf[i] != '\n') {
+      if (k->line_len < LG_LINE_BUF - 1) {
+        k->line[k->line_len++] = buf[i];
+      }
+      continue;
+    }
+    k->line[k->line_len] = '\0';
+    /* The JSON body has no newline, so a status line may trail it */
+    p = strstr(k->line, "HTTP/1.1 ");
+    if (p != NULL) {
+      if (strncmp(p + 9, "200", 3) == 0) {
+        lg_keys_ok++;
+      } else {
+        lg_keys_failed++;
+      }
+    }
+    k->line_len = 0;
+  }
+}
+
+/* ----------------------------------------------------------------
+ * Report
+ * ---------------------------------------------------------------- */
+
+static int
+lg_compare_double(const void* a, const void* b)
+{
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+static double
+lg_percentile(const double* samples, long count, double p)
+{
+  long idx;
+  idx = (long)(p * (double)(count - 1) + 0.5);
+  return samples[idx] * 1000.0;
+}
+
+/* Sorts the samples and prints their percentiles on one line */
+static void
+lg_report_latency(const char* label, double* samples, long count)
+{
+  if (count == 0) {
+    printf("%-13s no samples\n", label);
+    return;
+  }
+  qsort(samples, (size_t)count, sizeof(double), lg_compare_double);
+  printf("%-13s p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f"
+         "  (%ld samples)\n",
+         label,
+         lg_percentile(samples, count, 0.50),
+         lg_percentile(samples, count, 0.90),
+         lg_percentile(samples, count, 0.99),
+         lg_percentile(samples, count, 0.999),
+         samples[count - 1] * 1000.0,
+         count);
+}
+
+static void
+lg_report(double elapsed,
+          double cpu_ticks,
+          const lg_server_stats_t* before,
+          const lg_server_stats_t* after)
+{
+  int counts[LG_SUB_FAILED + 1];
+  int i;
+
+  memset(counts, 0, sizeof(counts));
+  for (i = 0; i < lg_opts.subscribers; i++) {
+    counts[lg_subs[i].state]++;
+  }
+
+  printf("\n--- dsky_loadgen: %.1f s against 127.0.0.1:%d ---\n",
+         elapsed,
+         lg_opts.port);
+  printf("subscribers   requested %d, streaming %d, unanswered %d, "
+         "rejected %d, dropped %d, failed %d, never opened %d\n",
+         lg_opts.subscribers,
+         counts[LG_SUB_STREAMING],
+         counts[LG_SUB_WAITING],
+         counts[LG_SUB_REJECTED],
+         counts[LG_SUB_DROPPED],
+         counts[LG_SUB_FAILED],
+         counts[LG_SUB_IDLE] + counts[LG_SUB_CONNECTING]);
+  printf("sse           %ld frames, %.0f bytes (%.1f KiB/s)\n",
+         lg_frames,
+         lg_bytes,
+         lg_bytes / 1024.0 / elapsed);
+  printf("keys          sent %ld, ok %ld, failed %ld\n",
+         lg_keys_sent,
+         lg_keys_ok,
+         lg_keys_failed);
+
+  lg_report_latency("latency ms", lg_samples, lg_sample_count);
+  lg_report_latency("monitor ms", lg_monitor_samples, lg_monitor_sample_count);
+  printf("probes        %d sent, %ld missed by subscribers",
+         lg_probe_count,
+         lg_probes_missed);
+  if (lg_samples_dropped > 0) {
+    printf(", %ld samples over cap", lg_samples_dropped);
+  }
+  printf("\n");
+
+  if (cpu_ticks >= 0.0) {
+    printf("server cpu    %.1f%% of one core (pid %ld)\n",
+           100.0 * cpu_ticks / (double)sysconf(_SC_CLK_TCK) / elapsed,
+           lg_opts.pid);
+  }
+  if (before->valid && after->valid) {
+    printf("server drops  stalled +%.0f, overflow +%.0f, rejected +%.0f\n",
+           after->stalled - before->stalled,
+           after->overflow - before->overflow,
+           after->rejected - before->rejected);
+    printf("server        %.0f monitors active\n", after->monitors);
+  } else {
+    printf("server drops  unavailable (GET /metrics failed)\n");
+  }
+}
+
+/* ----------------------------------------------------------------
+ * Main loop
+ * ---------------------------------------------------------------- */
+
+int
+main(int argc, char* argv[])
+{
+  struct pollfd* fds;
+  int* fd_owner;
+  lg_keyer_t keyer;
+  lg_server_stats_t before, after;
+  double start, now, next_key, ramp_start, load_end, cpu_start, cpu_end;
+  struct timespec retry_delay;
+  int opened, target, nfds, i, seq, attempt;
+
+  if (lg_parse_options(argc, argv) != 0) {
+    lg_usage(argv[0]);
+    return 2;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  lg_raise_fd_limit(lg_opts.subscribers + 64);
+
+  lg_subs =
+    (lg_sub_t*)calloc((size_t)lg_opts.subscribers + 1, sizeof(lg_sub_t));
+  fds = (struct pollfd*)calloc((size_t)lg_opts.subscribers + 2,
+                               sizeof(struct pollfd));
+  fd_owner = (int*)calloc((size_t)lg_opts.subscribers + 2, sizeof(int));
+  lg_probe_cap = lg_opts.key_rate *
+                   (lg_opts.duration + lg_opts.subscribers / lg_opts.ramp + 2) +
+                 16;
+  lg_probes = (lg_probe_t*)calloc((size_t)lg_probe_cap, sizeof(lg_probe_t));
+  lg_samples = (double*)malloc(LG_MAX_SAMPLES * sizeof(double));
+  lg_monitor_samples = (double*)malloc(LG_MAX_SAMPLES * sizeof(double));
+  if (lg_subs == NULL || fds == NULL || fd_owner == NULL ||
+      lg_probes == NULL || lg_samples == NULL || lg_monitor_samples == NULL) {
+    fprintf(stderr, "dsky_loadgen: out of memory\n");
+    return 1;
+  }
+  for (i = 0; i < lg_opts.subscribers; i++) {
+    lg_subs[i].fd = -1;
+    lg_subs[i].state = LG_SUB_IDLE;
+  }
+
+  before = lg_fetch_server_stats();
+  if (!before.valid) {
+    fprintf(stderr,
+            "dsky_loadgen: no web DSKY answering GET /metrics on "
+            "127.0.0.1:%d\n",
+            lg_opts.port);
+    return 1;
+  }
+
+  /* The keyer takes its server slot before the subscribers crowd in */
+  keyer.fd = -1;
+  keyer.retry_at = 0.0;
+  lg_keyer_connect(&keyer, lg_now());
+  cpu_start = lg_opts.pid > 0 ? lg_read_cpu_ticks(lg_opts.pid) : -1.0;
+
+  start = lg_now();
+  ramp_start = start;
+  next_key = start;
+  load_end = start + (double)lg_opts.subscribers / (double)lg_opts.ramp +
+             (double)lg_opts.duration;
+  opened = 0;
+  seq = 0;
+
+  printf("dsky_loadgen: %d subscribers at %d/s, %d keys/s, %d s\n",
+         lg_opts.subscribers,
+         lg_opts.ramp,
+         lg_opts.key_rate,
+         lg_opts.duration);
+
+  for (now = start; now < load_end; now = lg_now()) {
+    /* Ramp up subscribers */
+    target = (int)((now - ramp_start) * (double)lg_opts.ramp) + 1;
+    if (target > lg_opts.subscribers) {
+      target = lg_opts.subscribers;
+    }
+    while (opened < target) {
+      lg_sub_open(&lg_subs[opened]);
+      opened++;
+    }
+
+    /* Type V16E N36E, one key per interval */
+    if (lg_opts.key_rate > 0 && now >= next_key) {
+      lg_keyer_send(&keyer, &lg_sequence[seq], now);
+      seq = (seq + 1) % LG_SEQUENCE_LEN;
+      next_key += 1.0 / (double)lg_opts.key_rate;
+      if (next_key < now) {
+        next_key = now;
+      }
+    }
+
+    nfds = 0;
+    if (keyer.fd >= 0) {
+      fds[nfds].fd = keyer.fd;
+      fds[nfds].events = POLLIN;
+      fd_owner[nfds] = -1;
+      nfds++;
+    }
+    for (i = 0; i < opened; i++) {
+      if (lg_subs[i].state == LG_SUB_CONNECTING) {
+        fds[nfds].events = POLLOUT;
+      } else if (lg_subs[i].state == LG_SUB_WAITING ||
+                 lg_subs[i].state == LG_SUB_STREAMING) {
+        fds[nfds].events = POLLIN;
+      } else {
+        continue;
+      }
+      fds[nfds].fd = lg_subs[i].fd;
+      fd_owner[nfds] = i;
+      nfds++;
+    }
+
+    if (poll(fds, (nfds_t)nfds, 5) <= 0) {
+      continue;
+    }
+    now = lg_now();
+    for (i = 0; i < nfds; i++) {
+      if (fds[i].revents == 0) {
+        continue;
+      }
+      if (fd_owner[i] < 0) {
+        lg_keyer_read(&keyer);
+      } else if (lg_subs[fd_owner[i]].state == LG_SUB_CONNECTING) {
+        lg_sub_connected(&lg_subs[fd_owner[i]]);
+      } else {
+        lg_sub_read(&lg_subs[fd_owner[i]], now);
+      }
+    }
+  }
+
+  now = lg_now();
+  cpu_end = lg_opts.pid > 0 ? lg_read_cpu_ticks(lg_opts.pid) : -1.0;
+
+  for (i = 0; i < lg_opts.subscribers; i++) {
+    if (lg_subs[i].fd >= 0) {
+      close(lg_subs[i].fd);
+    }
+  }
+  if (keyer.fd >= 0) {
+    close(keyer.fd);
+  }
+
+  /* Closed SSE slots are reclaimed on the server's next failed write */
+  retry_delay.tv_sec = 0;
+  retry_delay.tv_nsec = 100000000L;
+  after = lg_fetch_server_stats();
+  for (attempt = 0; !after.valid && attempt < 30; attempt++) {
+    nanosleep(&retry_delay, NULL);
+    after = lg_fetch_server_stats();
+  }
+
+  lg_report(now - start,
+            (cpu_start >= 0.0 && cpu_end >= 0.0) ? cpu_end - cpu_start : -1.0,
+            &before,
+            &after);
+  return 0;
+}
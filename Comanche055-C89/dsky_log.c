@@ -0,0 +1,412 @@
+/*
+ * dsky_log.c -- Binary DSKY display log backend.
+ *
+ * Records go to a 64 KiB buffer flushed when full and at least once
+ * a second, or, with --log-mmap, straight into a shared mapping of
+ * the file grown a megabyte at a time and trimmed on close.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#else
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "dsky.h"
+#include "dsky_backend.h"
+#include "dsky_log.h"
+#include "hal.h"
+#include "timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define DLOG_BUF_SIZE 65536
+#define DLOG_FLUSH_MS 1000
+#define DLOG_MAP_CHUNK (1024L * 1024L)
+
+#define DLOG_FIELD(name, member) { name, offsetof(dsky_display_t, member) }
+#define DLOG_DIGIT(name, member, i)                                            \
+  { name, offsetof(dsky_display_t, member) + (i) * sizeof(int) }
+
+const dsky_log_field_t dsky_log_fields[DSKY_LOG_FIELD_COUNT] = {
+  DLOG_FIELD("uplink_acty", light_uplink_acty),
+  DLOG_FIELD("temp", light_temp),
+  DLOG_FIELD("key_rel", light_key_rel),
+  DLOG_FIELD("vel", light_vel),
+  DLOG_FIELD("no_att", light_no_att),
+  DLOG_FIELD("alt", light_alt),
+  DLOG_FIELD("gimbal_lock", light_gimbal_lock),
+  DLOG_FIELD("tracker", light_tracker),
+  DLOG_FIELD("prog_alarm", light_prog_alarm),
+  DLOG_FIELD("stby", light_stby),
+  DLOG_FIELD("restart", light_restart),
+  DLOG_FIELD("opr_err", light_opr_err),
+  DLOG_FIELD("comp_acty", light_comp_acty),
+  DLOG_DIGIT("prog0", prog, 0),
+  DLOG_DIGIT("prog1", prog, 1),
+  DLOG_DIGIT("verb0", verb, 0),
+  DLOG_DIGIT("verb1", verb, 1),
+  DLOG_DIGIT("noun0", noun, 0),
+  DLOG_DIGIT("noun1", noun, 1),
+  DLOG_FIELD("r1_sign", r1_sign),
+  DLOG_DIGIT("r1_0", r1, 0),
+  DLOG_DIGIT("r1_1", r1, 1),
+  DLOG_DIGIT("r1_2", r1, 2),
+  DLOG_DIGIT("r1_3", r1, 3),
+  DLOG_DIGIT("r1_4", r1, 4),
+  DLOG_FIELD("r2_sign", r2_sign),
+  DLOG_DIGIT("r2_0", r2, 0),
+  DLOG_DIGIT("r2_1", r2, 1),
+  DLOG_DIGIT("r2_2", r2, 2),
+  DLOG_DIGIT("r2_3", r2, 3),
+  DLOG_DIGIT("r2_4", r2, 4),
+  DLOG_FIELD("r3_sign", r3_sign),
+  DLOG_DIGIT("r3_0", r3, 0),
+  DLOG_DIGIT("r3_1", r3, 1),
+  DLOG_DIGIT("r3_2", r3, 2),
+  DLOG_DIGIT("r3_3", r3, 3),
+  DLOG_DIGIT("r3_4", r3, 4),
+};
+
+static const unsigned char dlog_magic[4] = { 'C', 'D', 'L', 'G' };
+
+#define DLOG_VALUE(d, i)                                                       \
+  (*(const int*)((const char*)(d) + dsky_log_fields[i].offset))
+
+/* ----------------------------------------------------------------
+ * Record codec
+ * ---------------------------------------------------------------- */
+
+static int
+dlog_encode(unsigned char* out,
+            const dsky_display_t* prev,
+            const dsky_display_t* cur,
+            unsigned long tick_delta)
+{
+  unsigned char* bitmap;
+  int len, i, value;
+
+  len = 0;
+  do {
+    out[len] = (unsigned char)(tick_delta & 0x7F);
+    tick_delta >>= 7;
+    if (tick_delta != 0) {
+      out[len] |= 0x80;
+    }
+    len++;
+  } while (tick_delta != 0);
+
+  bitmap = out + len;
+  memset(bitmap, 0, DSKY_LOG_BITMAP_BYTES);
+  len += DSKY_LOG_BITMAP_BYTES;
+
+  for (i = 0; i < DSKY_LOG_FIELD_COUNT; i++) {
+    value = DLOG_VALUE(cur, i);
+    if (prev != NULL && DLOG_VALUE(prev, i) == value) {
+      continue;
+    }
+    bitmap[i / 8] |= (unsigned char)(1 << (i % 8));
+    out[len++] = (unsigned char)(value & 0xFF);
+  }
+  return len;
+}
+
+int
+dsky_log_check_header(const unsigned char* data, long len)
+{
+  if (len < DSKY_LOG_HEADER_SIZE || memcmp(data, dlog_magic, 4) != 0 ||
+      data[4] != DSKY_LOG_VERSION || data[5] != DSKY_LOG_FIELD_COUNT) {
+    return -1;
+  }
+  return 0;
+}
+
+int
+dsky_log_decode(const unsigned char* data,
+                long len,
+                dsky_display_t* display,
+                unsigned long* tick_delta,
+                unsigned char* changed)
+{
+  const unsigned char* bitmap;
+  unsigned long delta;
+  long pos;
+  int shift, i, any, value;
+
+  delta = 0;
+  shift = 0;
+  pos = 0;
+  do {
+    if (pos >= len || shift > 28) {
+      return pos == 0 ? 0 : -1;
+    }
+    delta |= (unsigned long)(data[pos] & 0x7F) << shift;
+    shift += 7;
+  } while (data[pos++] & 0x80);
+
+  if (pos + DSKY_LOG_BITMAP_BYTES > len) {
+    return -1;
+  }
+  bitmap = data + pos;
+  pos += DSKY_LOG_BITMAP_BYTES;
+
+  any = 0;
+  for (i = 0; i < DSKY_LOG_BITMAP_BYTES; i++) {
+    any |= bitmap[i];
+  }
+  if (!any) {
+    return 0;
+  }
+
+  for (i = 0; i < DSKY_LOG_FIELD_COUNT; i++) {
+    if (!(bitmap[i / 8] & (1 << (i % 8)))) {
+      continue;
+    }
+    if (pos >= len) {
+      return -1;
+    }
+    value = data[pos] >= 0x80 ? data[pos] - 0x100 : data[pos];
+    pos++;
+    *(int*)((char*)display + dsky_log_fields[i].offset) = value;
+  }
+
+  if (tick_delta != NULL) {
+    *tick_delta = delta;
+  }
+  if (changed != NULL) {
+    memcpy(changed, bitmap, DSKY_LOG_BITMAP_BYTES);
+  }
+  return (int)pos;
+}
+
+/* ----------------------------------------------------------------
+ * Output: stdio buffer or shared mapping
+ * ---------------------------------------------------------------- */
+
+static const char* dlog_path = DSKY_LOG_DEFAULT_PATH;
+static int dlog_use_mmap = 0;
+static int dlog_open = 0;
+
+static FILE* dlog_file = NULL;
+static unsigned char dlog_buf[DLOG_BUF_SIZE];
+static int dlog_buf_len = 0;
+static long dlog_last_flush_ms = 0;
+
+#ifndef _WIN32
+static int dlog_fd = -1;
+static unsigned char* dlog_map = NULL;
+static long dlog_map_size = 0;
+static long dlog_map_len = 0;
+#endif
+
+static dsky_display_t dlog_prev;
+static int dlog_prev_valid = 0;
+static unsigned long dlog_last_tick = 0;
+
+static int
+dlog_mapped(void)
+{
+#ifdef _WIN32
+  return 0;
+#else
+  return dlog_fd >= 0;
+#endif
+}
+
+static void
+dlog_fail(const char* what)
+{
+  fprintf(stderr, "Display log %s failed: %s\n", what, dlog_path);
+  exit(1);
+}
+
+static void
+dlog_flush(void)
+{
+  if (dlog_file == NULL) {
+    return;
+  }
+  if (dlog_buf_len > 0 &&
+      fwrite(dlog_buf, 1, (size_t)dlog_buf_len, dlog_file) !=
+        (size_t)dlog_buf_len) {
+    dlog_fail("write");
+  }
+  dlog_buf_len = 0;
+  fflush(dlog_file);
+}
+
+#ifndef _WIN32
+static void
+dlog_map_grow(long need)
+{
+  long size;
+
+  size = dlog_map_size;
+  while (size < need) {
+    size += DLOG_MAP_CHUNK;
+  }
+  if (dlog_map != NULL) {
+    munmap(dlog_map, (size_t)dlog_map_size);
+    dlog_map = NULL;
+  }
+  if (ftruncate(dlog_fd, (off_t)size) != 0) {
+    dlog_fail("resize");
+  }
+  dlog_map = (unsigned char*)mmap(
+    NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, dlog_fd, 0);
+  if (dlog_map == (unsigned char*)MAP_FAILED) {
+    dlog_map = NULL;
+    dlog_fail("mmap");
+  }
+  dlog_map_size = size;
+}
+#endif
+
+static void
+dlog_emit(const unsigned char* data, int len)
+{
+#ifndef _WIN32
+  if (dlog_mapped()) {
+    if (dlog_map_len + len > dlog_map_size) {
+      dlog_map_grow(dlog_map_len + len);
+    }
+    memcpy(dlog_map + dlog_map_len, data, (size_t)len);
+    dlog_map_len += len;
+    return;
+  }
+#endif
+  if (dlog_buf_len + len > DLOG_BUF_SIZE) {
+    dlog_flush();
+  }
+  memcpy(dlog_buf + dlog_buf_len, data, (size_t)len);
+  dlog_buf_len += len;
+}
+
+static void
+dlog_close(void)
+{
+  if (!dlog_open) {
+    return;
+  }
+  dlog_open = 0;
+#ifndef _WIN32
+  if (dlog_mapped()) {
+    if (dlog_map != NULL) {
+      munmap(dlog_map, (size_t)dlog_map_size);
+      dlog_map = NULL;
+    }
+    if (ftruncate(dlog_fd, (off_t)dlog_map_len) != 0) {
+      fprintf(stderr, "Display log trim failed: %s\n", dlog_path);
+    }
+    close(dlog_fd);
+    dlog_fd = -1;
+    return;
+  }
+#endif
+  dlog_flush();
+  fclose(dlog_file);
+  dlog_file = NULL;
+}
+
+/* ----------------------------------------------------------------
+ * Backend
+ * ---------------------------------------------------------------- */
+
+void
+dsky_log_set_path(const char* path)
+{
+  dlog_path = path;
+}
+
+void
+dsky_log_set_mmap(int enable)
+{
+  dlog_use_mmap = enable;
+}
+
+static void
+dlog_init(void)
+{
+  unsigned char header[DSKY_LOG_HEADER_SIZE];
+
+  memcpy(header, dlog_magic, 4);
+  header[4] = DSKY_LOG_VERSION;
+  header[5] = DSKY_LOG_FIELD_COUNT;
+  header[6] = 10;
+  header[7] = 0;
+
+  if (dlog_use_mmap) {
+#ifdef _WIN32
+    fprintf(stderr, "--log-mmap is POSIX only; using buffered writes\n");
+#else
+    dlog_fd = open(dlog_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (dlog_fd < 0) {
+      dlog_fail("open");
+    }
+#endif
+  }
+  if (!dlog_mapped()) {
+    dlog_file = fopen(dlog_path, "wb");
+    if (dlog_file == NULL) {
+      dlog_fail("open");
+    }
+  }
+
+  /* Console 'q' and the like leave through exit(); still close */
+  dlog_open = 1;
+  atexit(dlog_close);
+
+  dlog_emit(header, DSKY_LOG_HEADER_SIZE);
+  dlog_prev_valid = 0;
+  dlog_last_tick = timer_tick_count;
+  dlog_last_flush_ms = hal_time_ms();
+}
+
+static void
+dlog_update(void)
+{
+  unsigned char record[DSKY_LOG_RECORD_MAX];
+  long now;
+
+  if (!dlog_open) {
+    return;
+  }
+  if (!dlog_prev_valid ||
+      memcmp(&dsky_display, &dlog_prev, sizeof(dsky_display)) != 0) {
+    dlog_emit(record,
+              dlog_encode(record,
+                          dlog_prev_valid ? &dlog_prev : NULL,
+                          &dsky_display,
+                          timer_tick_count - dlog_last_tick));
+    dlog_prev = dsky_display;
+    dlog_prev_valid = 1;
+    dlog_last_tick = timer_tick_count;
+  }
+
+  now = hal_time_ms();
+  if (dlog_file != NULL && now - dlog_last_flush_ms >= DLOG_FLUSH_MS) {
+    dlog_flush();
+    dlog_last_flush_ms = now;
+  }
+}
+
+static void
+dlog_poll_input(void)
+{
+}
+
+dsky_backend_t dsky_log_backend = { dlog_init,
+                                    dlog_update,
+                                    dlog_poll_input,
+                                    dlog_close,
+                                    hal_sleep_ms };
@@ -0,0 +1,66 @@
+/*
+ * dsky_log.h -- Binary DSKY display log backend.
+ *
+ * Records every change of dsky_display as a compact record, for
+ * post-run review with the dsky_replay tool.  File layout:
+ *
+ *   header   "CDLG", version, field count, tick length (ms), 0
+ *   record   tick delta   unsigned LEB128 varint, 10ms ticks since
+ *                         the previous record
+ *            bitmap       DSKY_LOG_BITMAP_BYTES, bit i set when
+ *                         field i (dsky_log_fields[]) changed
+ *            values       one signed byte per changed field, in
+ *                         field order
+ *
+ * The first record carries every field.  A record with an empty
+ * bitmap ends the log (a memory-mapped log is zero padded).
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifndef DSKY_LOG_H
+#define DSKY_LOG_H
+
+#include "dsky.h"
+#include "dsky_backend.h"
+
+#include <stddef.h>
+
+#define DSKY_LOG_DEFAULT_PATH "comanche055.dlog"
+#define DSKY_LOG_VERSION 1
+#define DSKY_LOG_HEADER_SIZE 8
+#define DSKY_LOG_FIELD_COUNT 37
+#define DSKY_LOG_BITMAP_BYTES ((DSKY_LOG_FIELD_COUNT + 7) / 8)
+#define DSKY_LOG_RECORD_MAX (5 + DSKY_LOG_BITMAP_BYTES + DSKY_LOG_FIELD_COUNT)
+
+typedef struct
+{
+  const char* name;
+  size_t offset; /* Of an int inside dsky_display_t */
+} dsky_log_field_t;
+
+extern const dsky_log_field_t dsky_log_fields[DSKY_LOG_FIELD_COUNT];
+
+extern dsky_backend_t dsky_log_backend;
+
+void
+dsky_log_set_path(const char* path);
+/* Write through a growing shared mapping instead of stdio (POSIX) */
+void
+dsky_log_set_mmap(int enable);
+
+/* Returns 0 if data starts with a header this version can read */
+int
+dsky_log_check_header(const unsigned char* data, long len);
+
+/* Applies the record at data to *display.  Returns the bytes used,
+ * 0 at the end of the log, or -1 for a truncated record.  changed
+ * (optional) receives the record's field bitmap. */
+int
+dsky_log_decode(const unsigned char* data,
+                long len,
+                dsky_display_t* display,
+                unsigned long* tick_delta,
+                unsigned char* changed);
+
+#endif /* DSKY_LOG_H */
@@ -0,0 +1,222 @@
+/*
+ * dsky_replay.c -- Play back a binary DSKY display log.
+ *
+ * Feeds the records of a log written by the "log" backend (see
+ * dsky_log.h) into the console or web renderer at any speed, or
+ * dumps them as text for searching.
+ *
+ *   dsky_replay FILE [--to console|web] [--speed X] [--dump]
+ *
+ * --speed scales the recorded timing (2 = twice as fast); 0 shows
+ * one record per frame.  On the console, Space pauses and Q quits.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "dsky.h"
+#include "dsky_backend.h"
+#include "dsky_log.h"
+#include "dsky_web.h"
+#include "hal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLAY_TICK_MS 10
+
+static unsigned char*
+replay_load(const char* path, long* len)
+{
+  FILE* f;
+  unsigned char* data;
+  long size;
+
+  f = fopen(path, "rb");
+  if (f == NULL) {
+    return NULL;
+  }
+  if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 ||
+      fseek(f, 0, SEEK_SET) != 0) {
+    fclose(f);
+    return NULL;
+  }
+  data = (unsigned char*)malloc(size > 0 ? (size_t)size : 1);
+  if (data == NULL || fread(data, 1, (size_t)size, f) != (size_t)size) {
+    free(data);
+    fclose(f);
+    return NULL;
+  }
+  fclose(f);
+  *len = size;
+  return data;
+}
+
+/* One line per record: tick, then name=value for each changed field */
+static int
+replay_dump(const unsigned char* data, long len)
+{
+  unsigned char changed[DSKY_LOG_BITMAP_BYTES];
+  dsky_display_t display;
+  unsigned long delta, tick;
+  long pos;
+  int n, i;
+
+  memset(&display, 0, sizeof(display));
+  tick = 0;
+  pos = DSKY_LOG_HEADER_SIZE;
+  while ((n = dsky_log_decode(
+            data + pos, len - pos, &display, &delta, changed)) > 0) {
+    pos += n;
+    tick += delta;
+    printf("%lu.%02lu", tick / 100, tick % 100);
+    for (i = 0; i < DSKY_LOG_FIELD_COUNT; i++) {
+      if (changed[i / 8] & (1 << (i % 8))) {
+        printf(" %s=%d",
+               dsky_log_fields[i].name,
+               *(int*)((char*)&display + dsky_log_fields[i].offset));
+      }
+    }
+    printf("\n");
+  }
+  if (n < 0) {
+    fprintf(stderr, "Truncated record at offset %ld\n", pos);
+    return 1;
+  }
+  return 0;
+}
+
+static void
+replay_usage(void)
+{
+  printf("usage: dsky_replay FILE [--to console|web] [--speed X] [--dump]\n");
+}
+
+int
+main(int argc, char* argv[])
+{
+  dsky_backend_t* backend;
+  unsigned char* data;
+  unsigned long delta, due_tick;
+  double speed, play_ms;
+  long len, pos, now, last;
+  dsky_display_t next;
+  int dump, paused, done, have_next, n, i, ch;
+  char* end;
+
+  backend = &dsky_console_backend;
+  speed = 1.0;
+  dump = 0;
+  if (argc < 2) {
+    replay_usage();
+    return 2;
+  }
+  for (i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+      i++;
+      if (strcmp(argv[i], "console") == 0) {
+        backend = &dsky_console_backend;
+      } else if (strcmp(argv[i], "web") == 0) {
+        backend = &dsky_web_backend;
+      } else {
+        replay_usage();
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+      speed = strtod(argv[++i], &end);
+      if (*end != '\0' || speed < 0.0) {
+        printf("Invalid --speed value: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--dump") == 0) {
+      dump = 1;
+    } else {
+      replay_usage();
+      return 2;
+    }
+  }
+
+  data = replay_load(argv[1], &len);
+  if (data == NULL) {
+    fprintf(stderr, "Cannot read %s\n", argv[1]);
+    return 1;
+  }
+  if (dsky_log_check_header(data, len) != 0) {
+    fprintf(stderr, "%s is not a version %d display log\n",
+            argv[1],
+            DSKY_LOG_VERSION);
+    free(data);
+    return 1;
+  }
+  if (dump) {
+    n = replay_dump(data, len);
+    free(data);
+    return n;
+  }
+
+  memset(&dsky_display, 0, sizeof(dsky_display));
+  backend->init();
+  if (backend == &dsky_web_backend) {
+    fprintf(stderr, "Replaying %s; Ctrl-C to stop\n", argv[1]);
+  }
+
+  /* Records are applied once the scaled play clock reaches them */
+  pos = DSKY_LOG_HEADER_SIZE;
+  due_tick = 0;
+  play_ms = 0.0;
+  paused = 0;
+  done = 0;
+  have_next = 0;
+  last = hal_time_ms();
+  while (1) {
+    now = hal_time_ms();
+    if (!paused) {
+      play_ms += (double)(now - last) * speed;
+    }
+    last = now;
+
+    while (!done && !paused) {
+      if (!have_next) {
+        next = dsky_display;
+        n = dsky_log_decode(data + pos, len - pos, &next, &delta, NULL);
+        if (n <= 0) {
+          done = 1;
+          break;
+        }
+        pos += n;
+        due_tick += delta;
+        have_next = 1;
+      }
+      if (speed > 0.0 && (double)due_tick * REPLAY_TICK_MS > play_ms) {
+        break;
+      }
+      dsky_display = next;
+      have_next = 0;
+      if (speed <= 0.0) {
+        break;
+      }
+    }
+
+    backend->update();
+
+    if (backend == &dsky_console_backend) {
+      while (hal_kbhit()) {
+        ch = hal_getch();
+        if (ch == 'q' || ch == 'Q') {
+          backend->cleanup();
+          free(data);
+          return 0;
+        }
+        if (ch == ' ') {
+          paused = !paused;
+        }
+      }
+    }
+
+    backend->sleep_ms(REPLAY_TICK_MS);
+  }
+}
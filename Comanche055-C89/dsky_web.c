@@ -2,7 +2,24 @@
  * dsky_web.c -- Minimal HTTP/SSE web backend for DSKY.
  *
  * Serves a single-page app with live DSKY state via Server-Sent
- * Events and accepts key input via POST /key.
+ * Events and accepts key input via POST /key (one keycode) or
+ * POST /keys (a batch).  HTTP/1.1 connections are persistent and
+ * pipelined requests are answered in order.  The page itself is
+ * assembled and gzip-compressed once at startup, revalidated by
+ * strong ETag, and sent straight from that cache.
+ *
+ * Transmit is a per-client chain of segments flushed with one gather
+ * write.  Segments point at the client's header scratch, at static
+ * data, or at refcounted frames shared by every SSE subscriber, so
+ * bodies and broadcast frames are never copied per client.
+ *
+ * Display changes are broadcast at most web_sse_max_fps times a second:
+ * a change inside the window is held and the latest state goes out
+ * when it closes.  A subscriber may ask for a lower rate with
+ * /events?fps=N; its newer frames replace the one it is waiting on.
+ *
+ * GET /metrics exports scheduler, alarm and web counters in the
+ * Prometheus text exposition format for the monitoring scraper.
  *
  * Comanche055 (Apollo 11 CM) ANSI C89 port.
  */
@@ -11,10 +28,21 @@
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+#include "agc.h"
+#include "alarm.h"
 #include "dsky.h"
 #include "dsky_backend.h"
 #include "dsky_web.h"
+#include "ephemeris.h"
+#include "executive.h"
+#include "gzip.h"
 #include "hal.h"
+#include "integration.h"
+#include "macro.h"
+#include "monitor.h"
+#include "navigation.h"
+#include "timer.h"
+#include "waitlist.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,6 +61,7 @@
 #include <signal.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #endif
 
@@ -41,14 +70,28 @@
 #define WEB_RX_BUF 2048
 #define WEB_TX_BUF 8192
 #define WEB_SSE_FRAME_BUF 1024
-#define WEB_MAX_BODY 128
+#define WEB_INDEX_BUF 8192
+#define WEB_ETAG_BUF 32
+#define WEB_METRICS_BUF 6144
+#define WEB_METRICS_LINE_MAX 192
+#define WEB_TX_SEGS 8
+#define WEB_FRAME_POOL (2 * WEB_MAX_CLIENTS + 1)
+#define WEB_MAX_BODY 512
 #define WEB_REQ_LINE_BUF 256
 #define WEB_PATH_BUF 128
 #define WEB_HEADER_LINE_BUF 256
 #define WEB_MAX_ACCEPTS_PER_TICK 4
 #define WEB_STALL_TICKS_LIMIT 100
+#define WEB_IDLE_TICKS_LIMIT 500 /* 5s at 100Hz */
+#define WEB_MONITOR_IDLE_MS 10000
+#define WEB_MAX_PIPELINE_PER_TICK 16
+#define WEB_REPLY_HEADER_MAX 256
+#define WEB_REPLY_SEGS 3 /* Most segments one reply queues (SSE start) */
+#define WEB_MACRO_BODY_BUF (160 + 6 * MACRO_MESSAGE_MAX) /* Longest POST */
 #define WEB_HEARTBEAT_TICKS 1000 /* 10s at 100Hz */
 #define WEB_KEY_QUEUE_CAP 64
+#define WEB_DEFAULT_SSE_MAX_FPS 25
+#define WEB_SSE_FPS_LIMIT 100 /* One frame per 10ms tick */
 
 #define WEB_METHOD_OTHER 0
 #define WEB_METHOD_GET 1
@@ -64,45 +107,100 @@ typedef int web_socket_t;
 typedef socklen_t web_socklen_t;
 #endif
 
+/* Broadcast frame shared by reference between SSE clients */
+typedef struct
+{
+  int refs;
+  int len;
+  char data[WEB_SSE_FRAME_BUF];
+} web_frame_t;
+
+typedef struct
+{
+  const char* base;
+  int len;
+  web_frame_t* frame; /* Reference held while queued, or NULL */
+} web_tx_seg_t;
+
 typedef struct
 {
   web_socket_t sock;
   int active;
   int is_sse;
+  int keep_alive;
   int close_after_tx;
   int stalled_ticks;
+  int idle_ticks;
 
   char rx_buf[WEB_RX_BUF];
   int rx_len;
 
+  /* Scratch for generated headers and small bodies; append-only
+   * until the chain drains, so queued segments stay valid. */
   char tx_buf[WEB_TX_BUF];
   int tx_len;
-  int tx_off;
 
-  char sse_next_buf[WEB_SSE_FRAME_BUF];
-  int sse_next_len;
+  web_tx_seg_t tx_segs[WEB_TX_SEGS];
+  int tx_seg_head;
+  int tx_seg_count;
+  int tx_seg_off; /* Bytes of the head segment already sent */
+  int tx_pending;
+
+  web_frame_t* sse_next; /* Latest frame waiting behind the chain */
+  int sse_interval_ms;   /* Negotiated minimum spacing of frames */
+  long sse_last_ms;      /* When the last frame was queued */
 } web_client_t;
 
 typedef struct
 {
   int method;
   char path[WEB_PATH_BUF];
+  char query[WEB_PATH_BUF]; /* After '?', or empty */
+  int keep_alive;
+  int accept_gzip;
+  char if_none_match[WEB_HEADER_LINE_BUF];
   int content_length;
   char body[WEB_MAX_BODY + 1];
 } web_request_t;
 
+typedef struct
+{
+  const char* base;
+  int len;
+} web_iov_t;
+
 static web_socket_t web_listen_sock = WEB_INVALID_SOCKET;
 static web_client_t web_clients[WEB_MAX_CLIENTS];
 static int web_running = 0;
 static dsky_display_t web_prev_display;
 static int web_prev_display_valid = 0;
+static int web_sse_max_fps = WEB_DEFAULT_SSE_MAX_FPS;
+static int web_broadcast_pending = 0;
+static long web_last_broadcast_ms = 0;
 static int web_heartbeat_counter = 0;
+static web_frame_t web_frames[WEB_FRAME_POOL];
 
 static int web_key_queue[WEB_KEY_QUEUE_CAP];
 static int web_key_head = 0;
 static int web_key_tail = 0;
 static int web_key_count = 0;
 
+/* Lifetime counters for /metrics */
+static unsigned long web_stat_bytes_sent = 0;
+static unsigned long web_stat_dropped_stalled = 0;
+static unsigned long web_stat_dropped_overflow = 0;
+static unsigned long web_stat_rejected_full = 0;
+static unsigned long web_stat_keys_busy = 0;
+static unsigned long web_stat_keys_invalid = 0;
+
+/* GET / cache, filled once by web_build_index_cache() */
+static char web_index_body[WEB_INDEX_BUF];
+static int web_index_len = 0;
+static char web_index_gz[WEB_INDEX_BUF];
+static int web_index_gz_len = -1;
+static char web_index_etag[WEB_ETAG_BUF];
+static char web_index_gz_etag[WEB_ETAG_BUF];
+
 static const char* web_index_html[] = {
   "<!doctype html>\n",
   "<html lang='en'>\n",
@@ -312,6 +410,8 @@ web_status_text(int status)
   switch (status) {
     case 200:
       return "OK";
+    case 304:
+      return "Not Modified";
     case 400:
       return "Bad Request";
     case 404:
@@ -320,6 +420,10 @@ web_status_text(int status)
       return "Method Not Allowed";
     case 413:
       return "Payload Too Large";
+    case 414:
+      return "URI Too Long";
+    case 500:
+      return "Internal Server Error";
     case 503:
       return "Service Unavailable";
     default:
@@ -437,6 +541,40 @@ web_find_free_client_slot(void)
   return -1;
 }
 
+static web_frame_t*
+web_frame_alloc(void)
+{
+  int i;
+  for (i = 0; i < WEB_FRAME_POOL; i++) {
+    if (web_frames[i].refs == 0) {
+      web_frames[i].refs = 1;
+      web_frames[i].len = 0;
+      return &web_frames[i];
+    }
+  }
+  return NULL;
+}
+
+static void
+web_frame_release(web_frame_t* f)
+{
+  if (f != NULL && f->refs > 0) {
+    f->refs--;
+  }
+}
+
+static void
+web_release_tx(web_client_t* c)
+{
+  int i;
+  for (i = 0; i < c->tx_seg_count; i++) {
+    web_frame_release(c->tx_segs[(c->tx_seg_head + i) % WEB_TX_SEGS].frame);
+  }
+  web_frame_release(c->sse_next);
+  c->tx_seg_count = 0;
+  c->sse_next = NULL;
+}
+
 static void
 web_drop_client(int idx)
 {
@@ -446,6 +584,7 @@ web_drop_client(int idx)
   if (web_clients[idx].active) {
     web_close_socket(web_clients[idx].sock);
   }
+  web_release_tx(&web_clients[idx]);
   web_reset_client(&web_clients[idx]);
 }
 
@@ -584,6 +723,128 @@ web_parse_keycode_json(const char* body, int body_len, int* keycode)
   return 0;
 }
 
+/* Parses the array of integers under "key" in a NUL-terminated JSON
+ * object, e.g. {"key":[1,-2,3]}; returns the count or -1. */
+static int
+web_parse_json_longs(const char* json, const char* key, long* vals, int max)
+{
+  char quoted[32];
+  const char* p;
+  char* end;
+  int count;
+
+  if (strlen(key) + 3 > sizeof(quoted)) {
+    return -1;
+  }
+  sprintf(quoted, "\"%s\"", key);
+  p = strstr(json, quoted);
+  if (p == NULL) {
+    return -1;
+  }
+  p = strchr(p, ':');
+  if (p == NULL) {
+    return -1;
+  }
+  p++;
+  while (web_is_space(*p)) {
+    p++;
+  }
+  if (*p != '[') {
+    return -1;
+  }
+  p++;
+
+  count = 0;
+  while (1) {
+    while (web_is_space(*p)) {
+      p++;
+    }
+    if (*p == ']') {
+      break;
+    }
+    if (count >= max) {
+      return -1;
+    }
+    vals[count] = strtol(p, &end, 10);
+    if (p == end) {
+      return -1;
+    }
+    count++;
+    p = end;
+    while (web_is_space(*p)) {
+      p++;
+    }
+    if (*p == ',') {
+      p++;
+    } else if (*p != ']') {
+      return -1;
+    }
+  }
+  return count;
+}
+
+/* Parses {"keycodes":[k0,k1,...]}; returns the count or -1. */
+static int
+web_parse_keycodes_json(const char* body,
+                        int body_len,
+                        int* keycodes,
+                        int max_keys)
+{
+  char tmp[WEB_MAX_BODY + 1];
+  long vals[WEB_KEY_QUEUE_CAP];
+  int count;
+  int i;
+
+  if (body_len < 0 || body_len > WEB_MAX_BODY ||
+      max_keys > WEB_KEY_QUEUE_CAP) {
+    return -1;
+  }
+  memcpy(tmp, body, (size_t)body_len);
+  tmp[body_len] = '\0';
+
+  count = web_parse_json_longs(tmp, "keycodes", vals, max_keys);
+  for (i = 0; i < count; i++) {
+    if (vals[i] < -32768L || vals[i] > 32767L) {
+      return -1;
+    }
+    keycodes[i] = (int)vals[i];
+  }
+  return count;
+}
+
+/* Finds name=value in a query string.  Returns 1 and sets *out when
+ * present, 0 when absent, -1 when the value is not a number. */
+static int
+web_query_int(const char* query, const char* name, int* out)
+{
+  const char* p;
+  const char* end;
+  char digits[16];
+  size_t name_len;
+  size_t len;
+
+  name_len = strlen(name);
+  p = query;
+  while (*p != '\0') {
+    end = strchr(p, '&');
+    if (end == NULL) {
+      end = p + strlen(p);
+    }
+    if (strncmp(p, name, name_len) == 0 && p[name_len] == '=') {
+      p += name_len + 1;
+      len = (size_t)(end - p);
+      if (len == 0 || len >= sizeof(digits)) {
+        return -1;
+      }
+      memcpy(digits, p, len);
+      digits[len] = '\0';
+      return web_parse_nonneg_int(digits, out) == 0 ? 1 : -1;
+    }
+    p = *end == '&' ? end + 1 : end;
+  }
+  return 0;
+}
+
 static int
 web_find_header_end(const char* buf, int len)
 {
@@ -610,57 +871,109 @@ web_find_crlf(const char* buf, int start, int len)
 }
 
 static int
-web_queue_bytes(web_client_t* c, const char* data, int len)
+web_queue_seg(web_client_t* c, const char* base, int len, web_frame_t* frame)
 {
-  int pending;
+  web_tx_seg_t* seg;
 
   if (len <= 0) {
     return 0;
   }
-
-  if (c->tx_len == c->tx_off) {
-    c->tx_len = 0;
-    c->tx_off = 0;
+  if (c->tx_seg_count >= WEB_TX_SEGS) {
+    return -1;
   }
+  seg = &c->tx_segs[(c->tx_seg_head + c->tx_seg_count) % WEB_TX_SEGS];
+  seg->base = base;
+  seg->len = len;
+  seg->frame = frame;
+  if (frame != NULL) {
+    frame->refs++;
+  }
+  c->tx_seg_count++;
+  c->tx_pending += len;
+  return 0;
+}
+
+/* Static or otherwise long-lived data: referenced, not copied */
+static int
+web_queue_static(web_client_t* c, const char* data, int len)
+{
+  return web_queue_seg(c, data, len, NULL);
+}
+
+static int
+web_client_pending_bytes(const web_client_t* c)
+{
+  return c->tx_pending + (c->sse_next != NULL ? c->sse_next->len : 0);
+}
 
-  pending = c->tx_len - c->tx_off;
-  if (c->tx_off > 0 && pending + len > WEB_TX_BUF) {
-    memmove(c->tx_buf, c->tx_buf + c->tx_off, (size_t)pending);
-    c->tx_len = pending;
-    c->tx_off = 0;
+/* Scratch for a reply of up to cap bytes, with segments to queue it,
+ * or NULL while it does not fit behind the replies already queued */
+static char*
+web_scratch_reserve(web_client_t* c, int cap)
+{
+  if (c->tx_len + cap > WEB_TX_BUF ||
+      c->tx_seg_count + WEB_REPLY_SEGS > WEB_TX_SEGS) {
+    return NULL;
   }
+  return c->tx_buf + c->tx_len;
+}
 
-  if (c->tx_len + len > WEB_TX_BUF) {
+/* A handler's result when web_scratch_reserve() fails: 1 defers the
+ * request until the queued replies drain and it is parsed again; -1
+ * drops the client when even an empty buffer cannot hold the reply */
+static int
+web_scratch_short(const web_client_t* c)
+{
+  return web_client_pending_bytes(c) > 0 ? 1 : -1;
+}
+
+/* Queues len bytes already written at web_scratch_reserve() */
+static int
+web_scratch_commit(web_client_t* c, int len)
+{
+  if (web_queue_seg(c, c->tx_buf + c->tx_len, len, NULL) != 0) {
     return -1;
   }
-  memcpy(c->tx_buf + c->tx_len, data, (size_t)len);
   c->tx_len += len;
   return 0;
 }
 
+/* Spacing for a subscriber asking for fps frames/s (0 = server cap) */
 static int
-web_client_pending_bytes(const web_client_t* c)
+web_sse_interval_ms(int fps)
 {
-  return (c->tx_len - c->tx_off) + c->sse_next_len;
+  if (web_sse_max_fps > 0 && (fps <= 0 || fps > web_sse_max_fps)) {
+    fps = web_sse_max_fps;
+  }
+  if (fps <= 0 || fps >= WEB_SSE_FPS_LIMIT) {
+    return 0;
+  }
+  return 1000 / fps;
 }
 
 static int
 web_promote_next_sse_frame(web_client_t* c)
 {
-  if (c->sse_next_len <= 0) {
+  web_frame_t* f;
+  long now;
+
+  if (c->sse_next == NULL || c->tx_seg_count > 0) {
     return 0;
   }
-  if (c->sse_next_len > WEB_TX_BUF) {
-    return -1;
+  if (c->sse_interval_ms > 0) {
+    now = hal_time_ms();
+    if (now - c->sse_last_ms < c->sse_interval_ms) {
+      return 0;
+    }
+    c->sse_last_ms = now;
   }
-  if (c->tx_len != c->tx_off) {
-    return 0;
+  f = c->sse_next;
+  c->sse_next = NULL;
+  if (web_queue_seg(c, f->data, f->len, f) != 0) {
+    web_frame_release(f);
+    return -1;
   }
-
-  memcpy(c->tx_buf, c->sse_next_buf, (size_t)c->sse_next_len);
-  c->tx_len = c->sse_next_len;
-  c->tx_off = 0;
-  c->sse_next_len = 0;
+  web_frame_release(f);
   return 0;
 }
 
@@ -670,86 +983,189 @@ web_queue_response(web_client_t* c,
                    const char* content_type,
                    const char* body)
 {
-  char header[256];
+  char* out;
   int body_len, header_len;
 
   body_len = (int)strlen(body);
-  header_len = sprintf(header,
+  out = web_scratch_reserve(c, WEB_REPLY_HEADER_MAX + body_len);
+  if (out == NULL) {
+    return web_scratch_short(c);
+  }
+  header_len = sprintf(out,
                        "HTTP/1.1 %d %s\r\n"
                        "Content-Type: %s\r\n"
                        "Content-Length: %d\r\n"
-                       "Connection: close\r\n"
+                       "Connection: %s\r\n"
                        "Cache-Control: no-cache\r\n"
                        "\r\n",
                        status,
                        web_status_text(status),
                        content_type,
-                       body_len);
-  if (header_len < 0 || header_len >= (int)sizeof(header)) {
+                       body_len,
+                       c->keep_alive ? "keep-alive" : "close");
+  if (header_len < 0 || header_len >= WEB_REPLY_HEADER_MAX) {
     return -1;
   }
-  if (web_queue_bytes(c, header, header_len) != 0) {
+  memcpy(out + header_len, body, (size_t)body_len);
+  if (web_scratch_commit(c, header_len + body_len) != 0) {
     return -1;
   }
-  if (web_queue_bytes(c, body, body_len) != 0) {
-    return -1;
-  }
-  c->close_after_tx = 1;
+  c->close_after_tx = !c->keep_alive;
   return 0;
 }
 
 static int
-web_text_lines_len(const char* const* lines)
+web_build_index_cache(void)
 {
-  int total;
   int i;
+  int line_len;
+  unsigned long crc;
+
+  web_index_len = 0;
+  for (i = 0; web_index_html[i] != NULL; i++) {
+    line_len = (int)strlen(web_index_html[i]);
+    if (web_index_len + line_len > WEB_INDEX_BUF) {
+      return -1;
+    }
+    memcpy(web_index_body + web_index_len, web_index_html[i], (size_t)line_len);
+    web_index_len += line_len;
+  }
+
+  crc = gzip_crc32((const unsigned char*)web_index_body, web_index_len);
+  sprintf(web_index_etag, "\"dsky-%08lx\"", crc);
+  sprintf(web_index_gz_etag, "\"dsky-%08lx-gz\"", crc);
 
-  total = 0;
-  for (i = 0; lines[i] != NULL; i++) {
-    total += (int)strlen(lines[i]);
+  web_index_gz_len = gzip_compress((const unsigned char*)web_index_body,
+                                   web_index_len,
+                                   (unsigned char*)web_index_gz,
+                                   WEB_INDEX_BUF);
+  if (web_index_gz_len >= web_index_len) {
+    web_index_gz_len = -1;
   }
-  return total;
+  return 0;
 }
 
+/* If-None-Match: "*" or a comma list of (possibly weak) entity tags */
 static int
-web_queue_response_lines(web_client_t* c,
-                         int status,
-                         const char* content_type,
-                         const char* const* lines)
+web_etag_matches(const char* list, const char* etag)
 {
-  char header[256];
-  int body_len;
+  const char* p;
+  int etag_len;
+
+  etag_len = (int)strlen(etag);
+  p = list;
+  while (*p != '\0') {
+    while (web_is_space(*p) || *p == ',') {
+      p++;
+    }
+    if (*p == '*') {
+      return 1;
+    }
+    if (p[0] == 'W' && p[1] == '/') {
+      p += 2;
+    }
+    if (strncmp(p, etag, (size_t)etag_len) == 0 &&
+        (p[etag_len] == '\0' || p[etag_len] == ',' ||
+         web_is_space(p[etag_len]))) {
+      return 1;
+    }
+    while (*p != '\0' && *p != ',') {
+      p++;
+    }
+  }
+  return 0;
+}
+
+/* Accept-Encoding: true if "gzip" is listed without q=0 */
+static int
+web_accepts_gzip(const char* value)
+{
+  const char* p;
+  const char* q;
+
+  p = value;
+  while (*p != '\0') {
+    while (web_is_space(*p) || *p == ',') {
+      p++;
+    }
+    if (web_starts_with_ci(p, "gzip") &&
+        (p[4] == '\0' || p[4] == ',' || p[4] == ';' || web_is_space(p[4]))) {
+      q = p + 4;
+      while (*q != '\0' && *q != ',') {
+        if ((*q == 'q' || *q == 'Q') && q[1] == '=') {
+          q += 2;
+          while (*q == '0' || *q == '.') {
+            q++;
+          }
+          return web_is_digit(*q);
+        }
+        q++;
+      }
+      return 1;
+    }
+    while (*p != '\0' && *p != ',') {
+      p++;
+    }
+  }
+  return 0;
+}
+
+static int
+web_queue_index(web_client_t* c, const web_request_t* req)
+{
+  char* header;
   int header_len;
-  int i;
-  int line_len;
+  int use_gzip;
+  const char* etag;
+
+  use_gzip = req->accept_gzip && web_index_gz_len > 0;
+  etag = use_gzip ? web_index_gz_etag : web_index_etag;
+  header = web_scratch_reserve(c, 384);
+  if (header == NULL) {
+    return web_scratch_short(c);
+  }
+
+  if (req->if_none_match[0] != '\0' &&
+      web_etag_matches(req->if_none_match, etag)) {
+    header_len = sprintf(header,
+                         "HTTP/1.1 304 Not Modified\r\n"
+                         "ETag: %s\r\n"
+                         "Vary: Accept-Encoding\r\n"
+                         "Cache-Control: no-cache\r\n"
+                         "Connection: %s\r\n"
+                         "\r\n",
+                         etag,
+                         c->keep_alive ? "keep-alive" : "close");
+    if (web_scratch_commit(c, header_len) != 0) {
+      return -1;
+    }
+    c->close_after_tx = !c->keep_alive;
+    return 0;
+  }
 
-  body_len = web_text_lines_len(lines);
   header_len = sprintf(header,
-                       "HTTP/1.1 %d %s\r\n"
-                       "Content-Type: %s\r\n"
+                       "HTTP/1.1 200 OK\r\n"
+                       "Content-Type: text/html; charset=utf-8\r\n"
                        "Content-Length: %d\r\n"
-                       "Connection: close\r\n"
+                       "%s"
+                       "ETag: %s\r\n"
+                       "Vary: Accept-Encoding\r\n"
                        "Cache-Control: no-cache\r\n"
+                       "Connection: %s\r\n"
                        "\r\n",
-                       status,
-                       web_status_text(status),
-                       content_type,
-                       body_len);
-  if (header_len < 0 || header_len >= (int)sizeof(header)) {
+                       use_gzip ? web_index_gz_len : web_index_len,
+                       use_gzip ? "Content-Encoding: gzip\r\n" : "",
+                       etag,
+                       c->keep_alive ? "keep-alive" : "close");
+  if (web_scratch_commit(c, header_len) != 0) {
     return -1;
   }
-  if (web_queue_bytes(c, header, header_len) != 0) {
+  if (web_queue_static(c,
+                       use_gzip ? web_index_gz : web_index_body,
+                       use_gzip ? web_index_gz_len : web_index_len) != 0) {
     return -1;
   }
-
-  for (i = 0; lines[i] != NULL; i++) {
-    line_len = (int)strlen(lines[i]);
-    if (web_queue_bytes(c, lines[i], line_len) != 0) {
-      return -1;
-    }
-  }
-
-  c->close_after_tx = 1;
+  c->close_after_tx = !c->keep_alive;
   return 0;
 }
 
@@ -767,138 +1183,521 @@ web_queue_json_error(web_client_t* c, int status, const char* code)
   return web_queue_response(c, status, "application/json", body);
 }
 
+/* ----------------------------------------------------------------
+ * Metrics (Prometheus text exposition format 0.0.4)
+ * ---------------------------------------------------------------- */
+
 static int
-web_build_state_json(char* out, int cap)
+web_metrics_head(char* out,
+                 int pos,
+                 const char* name,
+                 const char* type,
+                 const char* help)
 {
-  char tmp[768];
-  int n;
-  n = sprintf(tmp,
-              "{\"lights\":{\"uplink_acty\":%d,\"temp\":%d,\"key_rel\":%d,"
-              "\"vel\":%d,\"no_att\":%d,\"alt\":%d,\"gimbal_lock\":%d,"
-              "\"tracker\":%d,\"prog_alarm\":%d,\"stby\":%d,\"restart\":%d,"
-              "\"opr_err\":%d,\"comp_acty\":%d},"
-              "\"prog\":[%d,%d],\"verb\":[%d,%d],\"noun\":[%d,%d],"
-              "\"r1\":{\"sign\":%d,\"digits\":[%d,%d,%d,%d,%d]},"
-              "\"r2\":{\"sign\":%d,\"digits\":[%d,%d,%d,%d,%d]},"
-              "\"r3\":{\"sign\":%d,\"digits\":[%d,%d,%d,%d,%d]}}",
-              dsky_display.light_uplink_acty,
-              dsky_display.light_temp,
-              dsky_display.light_key_rel,
-              dsky_display.light_vel,
-              dsky_display.light_no_att,
-              dsky_display.light_alt,
-              dsky_display.light_gimbal_lock,
-              dsky_display.light_tracker,
-              dsky_display.light_prog_alarm,
-              dsky_display.light_stby,
-              dsky_display.light_restart,
-              dsky_display.light_opr_err,
-              dsky_display.light_comp_acty,
-              dsky_display.prog[0],
-              dsky_display.prog[1],
-              dsky_display.verb[0],
-              dsky_display.verb[1],
-              dsky_display.noun[0],
-              dsky_display.noun[1],
-              dsky_display.r1_sign,
-              dsky_display.r1[0],
-              dsky_display.r1[1],
-              dsky_display.r1[2],
-              dsky_display.r1[3],
-              dsky_display.r1[4],
-              dsky_display.r2_sign,
-              dsky_display.r2[0],
-              dsky_display.r2[1],
-              dsky_display.r2[2],
-              dsky_display.r2[3],
-              dsky_display.r2[4],
-              dsky_display.r3_sign,
-              dsky_display.r3[0],
-              dsky_display.r3[1],
-              dsky_display.r3[2],
-              dsky_display.r3[3],
-              dsky_display.r3[4]);
-  if (n < 0 || n >= (int)sizeof(tmp) || n >= cap) {
+  return pos + sprintf(out + pos,
+                       "# HELP %s %s\n# TYPE %s %s\n",
+                       name,
+                       help,
+                       name,
+                       type);
+}
+
+/* Every sample line is far shorter than WEB_METRICS_LINE_MAX, so one
+ * check per line keeps the sprintf calls inside the buffer. */
+static int
+web_build_metrics(char* out, int cap)
+{
+  int pos;
+  int i;
+  int sse_clients;
+  int clients;
+  unsigned long cumulative;
+
+  pos = 0;
+  if (cap < 4 * WEB_METRICS_LINE_MAX) {
+    return -1;
+  }
+
+  pos = web_metrics_head(
+    out, pos, "agc_ticks_total", "counter", "10 ms timer ticks executed.");
+  pos += sprintf(out + pos, "agc_ticks_total %lu\n", timer_tick_count);
+  pos = web_metrics_head(out,
+                         pos,
+                         "agc_ticks_skipped_total",
+                         "counter",
+                         "Ticks dropped while the main loop ran behind.");
+  pos +=
+    sprintf(out + pos, "agc_ticks_skipped_total %lu\n", timer_ticks_skipped);
+
+  pos = web_metrics_head(out,
+                         pos,
+                         "agc_tick_lateness_ms",
+                         "histogram",
+                         "Delay between a tick falling due and running.");
+  cumulative = 0;
+  for (i = 0; i < TIMER_LATENESS_BUCKETS; i++) {
+    cumulative += timer_lateness_hist[i];
+    if (cap - pos <= WEB_METRICS_LINE_MAX) {
+      return -1;
+    }
+    pos += sprintf(out + pos,
+                   "agc_tick_lateness_ms_bucket{le=\"%d\"} %lu\n",
+                   timer_lateness_bounds[i],
+                   cumulative);
+  }
+  cumulative += timer_lateness_hist[TIMER_LATENESS_BUCKETS];
+  if (cap - pos <= 3 * WEB_METRICS_LINE_MAX) {
+    return -1;
+  }
+  pos += sprintf(
+    out + pos, "agc_tick_lateness_ms_bucket{le=\"+Inf\"} %lu\n", cumulative);
+  pos +=
+    sprintf(out + pos, "agc_tick_lateness_ms_sum %lu\n", timer_lateness_sum_ms);
+  pos += sprintf(out + pos, "agc_tick_lateness_ms_count %lu\n", cumulative);
+
+  pos = web_metrics_head(out,
+                         pos,
+                         "agc_exec_jobs_dispatched_total",
+                         "counter",
+                         "Executive job dispatches per core set.");
+  for (i = 0; i < NUM_CORE_SETS; i++) {
+    if (cap - pos <= WEB_METRICS_LINE_MAX) {
+      return -1;
+    }
+    pos += sprintf(out + pos,
+                   "agc_exec_jobs_dispatched_total{coreset=\"%d\"} %lu\n",
+                   i,
+                   exec_dispatch_count[i]);
+  }
+
+  if (cap - pos <= 4 * WEB_METRICS_LINE_MAX) {
+    return -1;
+  }
+  pos = web_metrics_head(
+    out, pos, "agc_waitlist_tasks", "gauge", "Waitlist slots in use.");
+  pos += sprintf(out + pos, "agc_waitlist_tasks %d\n", waitlist_occupancy());
+  pos = web_metrics_head(
+    out, pos, "agc_waitlist_slots", "gauge", "Waitlist slot capacity.");
+  pos += sprintf(out + pos, "agc_waitlist_slots %d\n", NUM_WAITLIST_TASKS);
+
+  if (cap - pos <= 4 * WEB_METRICS_LINE_MAX) {
+    return -1;
+  }
+  pos = web_metrics_head(
+    out, pos, "agc_monitors_active", "gauge", "Running noun monitors.");
+  pos += sprintf(out + pos, "agc_monitors_active %d\n", monitor_active_count());
+  pos = web_metrics_head(out,
+                         pos,
+                         "agc_monitor_refreshes_total",
+                         "counter",
+                         "Noun monitor refreshes delivered.");
+  pos += sprintf(
+    out + pos, "agc_monitor_refreshes_total %lu\n", monitor_refresh_count);
+
+  if (cap - pos <= 10 * WEB_METRICS_LINE_MAX) {
+    return -1;
+  }
+  pos = web_metrics_head(out,
+                         pos,
+                         "agc_nav_integration_steps_total",
+                         "counter",
+                         "Encke steps taken for the CSM and LEM.");
+  pos += sprintf(
+    out + pos, "agc_nav_integration_steps_total %lu\n", integ_step_count);
+  pos = web_metrics_head(out,
+                         pos,
+                         "agc_nav_rectifications_total",
+                         "counter",
+                         "Conic rectifications.");
+  pos += sprintf(
+    out + pos, "agc_nav_rectifications_total %lu\n", integ_rectify_count);
+  pos = web_metrics_head(out,
+                         pos,
+                         "agc_nav_ephemeris_lookups_total",
+                         "counter",
+                         "Lunar and solar ephemeris queries.");
+  pos += sprintf(
+    out + pos, "agc_nav_ephemeris_lookups_total %lu\n", ephem_lookup_count);
+  pos = web_metrics_head(out,
+                         pos,
+                         "agc_nav_ephemeris_fits_total",
+                         "counter",
+                         "Ephemeris segments fitted on a cache miss.");
+  pos +=
+    sprintf(out + pos, "agc_nav_ephemeris_fits_total %lu\n", ephem_fit_count);
+  if (integ_reference_enabled) {
+    pos = web_metrics_head(
+      out,
+      pos,
+      "agc_nav_reference_error_meters",
+      "gauge",
+      "Largest position difference from the double precision reference.");
+    pos += sprintf(out + pos,
+                   "agc_nav_reference_error_meters %.3f\n",
+                   integ_reference_error_m);
+  }
+
+  if (cap - pos <= 4 * WEB_METRICS_LINE_MAX) {
+    return -1;
+  }
+  pos = web_metrics_head(out,
+                         pos,
+                         "agc_alarm_code",
+                         "gauge",
+                         "Current alarm code as octal digits, 0 if none.");
+  pos +=
+    sprintf(out + pos, "agc_alarm_code %o\n", (unsigned int)agc_alarm_code);
+  pos = web_metrics_head(out,
+                         pos,
+                         "agc_alarms_raised_total",
+                         "counter",
+                         "Program alarms raised, by octal alarm code.");
+  for (i = 0; i < alarm_stats_used; i++) {
+    if (cap - pos <= WEB_METRICS_LINE_MAX) {
+      return -1;
+    }
+    pos += sprintf(out + pos,
+                   "agc_alarms_raised_total{code=\"%05o\"} %lu\n",
+                   (unsigned int)alarm_stats[i].code,
+                   alarm_stats[i].count);
+  }
+
+  sse_clients = 0;
+  clients = 0;
+  for (i = 0; i < WEB_MAX_CLIENTS; i++) {
+    if (web_clients[i].active) {
+      clients++;
+      if (web_clients[i].is_sse) {
+        sse_clients++;
+      }
+    }
+  }
+
+  if (cap - pos <= 16 * WEB_METRICS_LINE_MAX) {
     return -1;
   }
-  memcpy(out, tmp, (size_t)n + 1);
-  return n;
+  pos = web_metrics_head(
+    out, pos, "dsky_web_clients", "gauge", "Open HTTP connections.");
+  pos += sprintf(out + pos, "dsky_web_clients %d\n", clients);
+  pos = web_metrics_head(
+    out, pos, "dsky_web_sse_clients", "gauge", "Connected SSE subscribers.");
+  pos += sprintf(out + pos, "dsky_web_sse_clients %d\n", sse_clients);
+  pos = web_metrics_head(out,
+                         pos,
+                         "dsky_web_bytes_sent_total",
+                         "counter",
+                         "Bytes written to clients.");
+  pos +=
+    sprintf(out + pos, "dsky_web_bytes_sent_total %lu\n", web_stat_bytes_sent);
+  pos = web_metrics_head(out,
+                         pos,
+                         "dsky_web_clients_dropped_total",
+                         "counter",
+                         "Clients dropped with output still pending.");
+  pos += sprintf(out + pos,
+                 "dsky_web_clients_dropped_total{reason=\"stalled\"} %lu\n",
+                 web_stat_dropped_stalled);
+  pos += sprintf(out + pos,
+                 "dsky_web_clients_dropped_total{reason=\"overflow\"} %lu\n",
+                 web_stat_dropped_overflow);
+  pos = web_metrics_head(out,
+                         pos,
+                         "dsky_web_clients_rejected_total",
+                         "counter",
+                         "Connections refused because every slot was busy.");
+  pos += sprintf(
+    out + pos, "dsky_web_clients_rejected_total %lu\n", web_stat_rejected_full);
+  pos = web_metrics_head(out,
+                         pos,
+                         "dsky_web_key_queue_depth",
+                         "gauge",
+                         "Keycodes waiting for the next poll.");
+  pos += sprintf(out + pos, "dsky_web_key_queue_depth %d\n", web_key_count);
+  pos = web_metrics_head(
+    out, pos, "dsky_web_key_queue_capacity", "gauge", "Key queue capacity.");
+  pos +=
+    sprintf(out + pos, "dsky_web_key_queue_capacity %d\n", WEB_KEY_QUEUE_CAP);
+  pos = web_metrics_head(out,
+                         pos,
+                         "dsky_web_key_rejections_total",
+                         "counter",
+                         "Key requests refused, by reason.");
+  pos += sprintf(out + pos,
+                 "dsky_web_key_rejections_total{reason=\"busy\"} %lu\n",
+                 web_stat_keys_busy);
+  pos += sprintf(out + pos,
+                 "dsky_web_key_rejections_total{reason=\"invalid\"} %lu\n",
+                 web_stat_keys_invalid);
+  return pos;
 }
 
+/* Body is rendered first, behind room for the header, and both go out
+ * as two segments of the scratch.  Returns 1 to defer the request
+ * while earlier pipelined responses still occupy the scratch. */
 static int
-web_build_sse_snapshot_frame(char* out, int cap)
+web_queue_metrics(web_client_t* c)
 {
-  char json[768];
-  int json_len;
-  int total_len;
-  json_len = web_build_state_json(json, sizeof(json));
-  if (json_len < 0) {
+  char* out;
+  char* body;
+  int body_len, header_len;
+
+  out = web_scratch_reserve(c, WEB_REPLY_HEADER_MAX + WEB_METRICS_BUF);
+  if (out == NULL) {
+    return web_scratch_short(c);
+  }
+  body = out + WEB_REPLY_HEADER_MAX;
+  body_len = web_build_metrics(body, WEB_METRICS_BUF);
+  if (body_len < 0) {
+    return web_queue_json_error(c, 500, "metrics_overflow");
+  }
+  header_len = sprintf(out,
+                       "HTTP/1.1 200 OK\r\n"
+                       "Content-Type: text/plain; version=0.0.4\r\n"
+                       "Content-Length: %d\r\n"
+                       "Connection: %s\r\n"
+                       "Cache-Control: no-cache\r\n"
+                       "\r\n",
+                       body_len,
+                       c->keep_alive ? "keep-alive" : "close");
+  if (web_queue_seg(c, out, header_len, NULL) != 0 ||
+      web_queue_seg(c, body, body_len, NULL) != 0) {
     return -1;
   }
-  total_len = 6 + json_len + 2;
-  if (total_len >= cap) {
+  c->tx_len += WEB_REPLY_HEADER_MAX + body_len;
+  c->close_after_tx = !c->keep_alive;
+  return 0;
+}
+
+/* ----------------------------------------------------------------
+ * State JSON encoder
+ *
+ * The snapshot is a fixed template: literal text followed by one
+ * integer, 37 times.  Walking a table and converting each integer
+ * by hand writes straight into the frame without a sprintf parse
+ * of the format string or an intermediate copy.
+ * ---------------------------------------------------------------- */
+
+typedef struct
+{
+  const char* text;
+  int text_len;
+  const int* value;
+} web_json_field_t;
+
+#define WEB_JSON_FIELD(text, value) { text, (int)sizeof(text) - 1, &value }
+#define WEB_JSON_INT_MAX 11 /* "-2147483648" */
+
+static const web_json_field_t web_state_fields[] = {
+  WEB_JSON_FIELD("{\"lights\":{\"uplink_acty\":",
+                 dsky_display.light_uplink_acty),
+  WEB_JSON_FIELD(",\"temp\":", dsky_display.light_temp),
+  WEB_JSON_FIELD(",\"key_rel\":", dsky_display.light_key_rel),
+  WEB_JSON_FIELD(",\"vel\":", dsky_display.light_vel),
+  WEB_JSON_FIELD(",\"no_att\":", dsky_display.light_no_att),
+  WEB_JSON_FIELD(",\"alt\":", dsky_display.light_alt),
+  WEB_JSON_FIELD(",\"gimbal_lock\":", dsky_display.light_gimbal_lock),
+  WEB_JSON_FIELD(",\"tracker\":", dsky_display.light_tracker),
+  WEB_JSON_FIELD(",\"prog_alarm\":", dsky_display.light_prog_alarm),
+  WEB_JSON_FIELD(",\"stby\":", dsky_display.light_stby),
+  WEB_JSON_FIELD(",\"restart\":", dsky_display.light_restart),
+  WEB_JSON_FIELD(",\"opr_err\":", dsky_display.light_opr_err),
+  WEB_JSON_FIELD(",\"comp_acty\":", dsky_display.light_comp_acty),
+  WEB_JSON_FIELD("},\"prog\":[", dsky_display.prog[0]),
+  WEB_JSON_FIELD(",", dsky_display.prog[1]),
+  WEB_JSON_FIELD("],\"verb\":[", dsky_display.verb[0]),
+  WEB_JSON_FIELD(",", dsky_display.verb[1]),
+  WEB_JSON_FIELD("],\"noun\":[", dsky_display.noun[0]),
+  WEB_JSON_FIELD(",", dsky_display.noun[1]),
+  WEB_JSON_FIELD("],\"r1\":{\"sign\":", dsky_display.r1_sign),
+  WEB_JSON_FIELD(",\"digits\":[", dsky_display.r1[0]),
+  WEB_JSON_FIELD(",", dsky_display.r1[1]),
+  WEB_JSON_FIELD(",", dsky_display.r1[2]),
+  WEB_JSON_FIELD(",", dsky_display.r1[3]),
+  WEB_JSON_FIELD(",", dsky_display.r1[4]),
+  WEB_JSON_FIELD("]},\"r2\":{\"sign\":", dsky_display.r2_sign),
+  WEB_JSON_FIELD(",\"digits\":[", dsky_display.r2[0]),
+  WEB_JSON_FIELD(",", dsky_display.r2[1]),
+  WEB_JSON_FIELD(",", dsky_display.r2[2]),
+  WEB_JSON_FIELD(",", dsky_display.r2[3]),
+  WEB_JSON_FIELD(",", dsky_display.r2[4]),
+  WEB_JSON_FIELD("]},\"r3\":{\"sign\":", dsky_display.r3_sign),
+  WEB_JSON_FIELD(",\"digits\":[", dsky_display.r3[0]),
+  WEB_JSON_FIELD(",", dsky_display.r3[1]),
+  WEB_JSON_FIELD(",", dsky_display.r3[2]),
+  WEB_JSON_FIELD(",", dsky_display.r3[3]),
+  WEB_JSON_FIELD(",", dsky_display.r3[4]),
+};
+
+#define WEB_STATE_FIELDS                                                      \
+  ((int)(sizeof(web_state_fields) / sizeof(web_state_fields[0])))
+
+static char*
+web_put_int(char* p, int v)
+{
+  char digits[WEB_JSON_INT_MAX];
+  unsigned int u;
+  int n;
+
+  /* Display cells hold -1..9, so almost every value takes this path */
+  if (v >= 0 && v <= 9) {
+    *p++ = (char)('0' + v);
+    return p;
+  }
+  if (v < 0) {
+    *p++ = '-';
+    u = 0u - (unsigned int)v;
+  } else {
+    u = (unsigned int)v;
+  }
+  n = 0;
+  do {
+    digits[n++] = (char)('0' + (int)(u % 10u));
+    u /= 10u;
+  } while (u != 0u);
+  while (n > 0) {
+    *p++ = digits[--n];
+  }
+  return p;
+}
+
+/* Writes s as a quoted JSON string; needs up to 6 bytes per character
+ * plus 3 */
+static char*
+web_put_json_string(char* p, const char* s)
+{
+  static const char hex[] = "0123456789abcdef";
+  unsigned char ch;
+
+  *p++ = '"';
+  for (; *s != '\0'; s++) {
+    ch = (unsigned char)*s;
+    if (ch == '"' || ch == '\\') {
+      *p++ = '\\';
+      *p++ = (char)ch;
+    } else if (ch < 0x20) {
+      memcpy(p, "\\u00", 4);
+      p[4] = hex[ch >> 4];
+      p[5] = hex[ch & 0x0f];
+      p += 6;
+    } else {
+      *p++ = (char)ch;
+    }
+  }
+  *p++ = '"';
+  *p = '\0';
+  return p;
+}
+
+/* Returns the length written (no terminator), or -1 if cap is short */
+static int
+web_build_state_json(char* out, int cap)
+{
+  const web_json_field_t* f;
+  char* p;
+  char* end;
+  int i;
+
+  p = out;
+  end = out + cap;
+  for (i = 0; i < WEB_STATE_FIELDS; i++) {
+    f = &web_state_fields[i];
+    if (end - p < f->text_len + WEB_JSON_INT_MAX + 3) {
+      return -1;
+    }
+    memcpy(p, f->text, (size_t)f->text_len);
+    p += f->text_len;
+    p = web_put_int(p, *f->value);
+  }
+  *p++ = ']';
+  *p++ = '}';
+  *p++ = '}';
+  return (int)(p - out);
+}
+
+int
+dsky_web_encode_state(char* out, int cap)
+{
+  int json_len;
+
+  if (cap < 6 + 2) {
     return -1;
   }
   memcpy(out, "data: ", 6);
-  memcpy(out + 6, json, (size_t)json_len);
+  json_len = web_build_state_json(out + 6, cap - 6 - 2);
+  if (json_len < 0) {
+    return -1;
+  }
   out[6 + json_len] = '\n';
   out[6 + json_len + 1] = '\n';
-  out[6 + json_len + 2] = '\0';
-  return total_len;
+  return 6 + json_len + 2;
 }
 
-static int
-web_queue_sse_frame(web_client_t* c, const char* frame, int frame_len)
+static web_frame_t*
+web_build_sse_snapshot_frame(void)
 {
-  int pending;
+  web_frame_t* f;
 
-  if (!c->is_sse) {
-    return 0;
+  f = web_frame_alloc();
+  if (f == NULL) {
+    return NULL;
   }
-  if (frame_len <= 0 || frame_len > WEB_SSE_FRAME_BUF) {
-    return -1;
+  f->len = dsky_web_encode_state(f->data, WEB_SSE_FRAME_BUF);
+  if (f->len < 0) {
+    web_frame_release(f);
+    return NULL;
   }
+  return f;
+}
 
-  pending = c->tx_len - c->tx_off;
-  if (pending == 0) {
-    if (web_queue_bytes(c, frame, frame_len) != 0) {
-      return -1;
-    }
-  } else {
-    memcpy(c->sse_next_buf, frame, (size_t)frame_len);
-    c->sse_next_len = frame_len;
+/* Every frame waits in sse_next, so a newer one replaces it until the
+ * chain drains and the subscriber's rate window opens. */
+static int
+web_queue_sse_frame(web_client_t* c, web_frame_t* f)
+{
+  if (!c->is_sse) {
+    return 0;
   }
-  return 0;
+  web_frame_release(c->sse_next);
+  f->refs++;
+  c->sse_next = f;
+  return web_promote_next_sse_frame(c);
 }
 
 static int
-web_try_parse_request(web_client_t* c, web_request_t* req)
+web_try_parse_request(const char* buf,
+                      int len,
+                      web_request_t* req,
+                      int* consumed)
 {
   int header_end, line_end, pos, next_line, line_len;
   int content_length;
   int total_len;
+  int fields;
   char line[WEB_HEADER_LINE_BUF];
   char method[8];
-  char path[WEB_PATH_BUF];
+  char target[WEB_REQ_LINE_BUF];
   char version[16];
+  const char* value;
+  size_t target_len, path_len, query_len;
 
-  header_end = web_find_header_end(c->rx_buf, c->rx_len);
+  header_end = web_find_header_end(buf, len);
   if (header_end < 0) {
-    if (c->rx_len >= WEB_RX_BUF) {
+    if (len >= WEB_RX_BUF) {
       return 413;
     }
     return 0;
   }
 
-  line_end = web_find_crlf(c->rx_buf, 0, header_end);
+  line_end = web_find_crlf(buf, 0, header_end);
   if (line_end <= 0 || line_end >= WEB_REQ_LINE_BUF) {
     return 400;
   }
 
-  memcpy(line, c->rx_buf, (size_t)line_end);
+  memcpy(line, buf, (size_t)line_end);
   line[line_end] = '\0';
 
-  if (sscanf(line, "%7s %127s %15s", method, path, version) < 2) {
+  fields = sscanf(line, "%7s %255s %15s", method, target, version);
+  if (fields < 2) {
     return 400;
   }
 
@@ -908,13 +1707,36 @@ web_try_parse_request(web_client_t* c, web_request_t* req)
   } else if (strcmp(method, "POST") == 0) {
     req->method = WEB_METHOD_POST;
   }
-  strncpy(req->path, path, WEB_PATH_BUF - 1);
-  req->path[WEB_PATH_BUF - 1] = '\0';
+
+  /* Split the target at '?' and refuse either half that would not fit */
+  target_len = strlen(target);
+  value = strchr(target, '?');
+  if (value != NULL) {
+    path_len = (size_t)(value - target);
+    query_len = target_len - path_len - 1;
+  } else {
+    path_len = target_len;
+    query_len = 0;
+  }
+  if (path_len >= WEB_PATH_BUF || query_len >= WEB_PATH_BUF) {
+    return 414;
+  }
+  memcpy(req->path, target, path_len);
+  req->path[path_len] = '\0';
+  if (value != NULL) {
+    memcpy(req->query, value + 1, query_len);
+  }
+  req->query[query_len] = '\0';
+
+  /* HTTP/1.1 defaults to persistent connections, HTTP/1.0 does not */
+  req->keep_alive = (fields == 3 && strcmp(version, "HTTP/1.1") == 0);
+  req->accept_gzip = 0;
+  req->if_none_match[0] = '\0';
 
   content_length = 0;
   pos = line_end + 2;
   while (pos < header_end - 2) {
-    next_line = web_find_crlf(c->rx_buf, pos, header_end);
+    next_line = web_find_crlf(buf, pos, header_end);
     if (next_line < 0) {
       return 400;
     }
@@ -926,13 +1748,31 @@ web_try_parse_request(web_client_t* c, web_request_t* req)
       return 413;
     }
 
-    memcpy(line, c->rx_buf + pos, (size_t)line_len);
+    memcpy(line, buf + pos, (size_t)line_len);
     line[line_len] = '\0';
 
     if (web_starts_with_ci(line, "Content-Length:")) {
       if (web_parse_nonneg_int(line + 15, &content_length) != 0) {
         return 400;
       }
+    } else if (web_starts_with_ci(line, "Connection:")) {
+      value = line + 11;
+      while (web_is_space(*value)) {
+        value++;
+      }
+      if (web_starts_with_ci(value, "close")) {
+        req->keep_alive = 0;
+      } else if (web_starts_with_ci(value, "keep-alive")) {
+        req->keep_alive = 1;
+      }
+    } else if (web_starts_with_ci(line, "Accept-Encoding:")) {
+      req->accept_gzip = web_accepts_gzip(line + 16);
+    } else if (web_starts_with_ci(line, "If-None-Match:")) {
+      value = line + 14;
+      while (web_is_space(*value)) {
+        value++;
+      }
+      strcpy(req->if_none_match, value);
     }
 
     pos = next_line + 2;
@@ -945,24 +1785,213 @@ web_try_parse_request(web_client_t* c, web_request_t* req)
   if (total_len > WEB_RX_BUF) {
     return 413;
   }
-  if (c->rx_len < total_len) {
+  if (len < total_len) {
     return 0;
   }
 
   req->content_length = content_length;
   if (content_length > 0) {
-    memcpy(req->body, c->rx_buf + header_end, (size_t)content_length);
+    memcpy(req->body, buf + header_end, (size_t)content_length);
   }
   req->body[content_length] = '\0';
+  *consumed = total_len;
   return 1;
 }
 
+/* ----------------------------------------------------------------
+ * Noun monitors for web observers
+ * ---------------------------------------------------------------- */
+
+/* Observers of a noun share one monitor, read from its cached values
+ * so polling costs no fetches; it lapses once nobody has read it for
+ * WEB_MONITOR_IDLE_MS. */
+static long web_monitor_read_ms[MONITOR_MAX];
+
+static void
+web_monitor_sink(int slot,
+                 const noun_table_entry_t* entry,
+                 const int values[NOUN_MAX_COMPONENTS])
+{
+  (void)entry;
+  (void)values;
+  if (hal_time_ms() - web_monitor_read_ms[slot] > WEB_MONITOR_IDLE_MS) {
+    monitor_stop(slot);
+  }
+}
+
+static int
+web_queue_monitor(web_client_t* c, const web_request_t* req)
+{
+  const int* v;
+  char body[96];
+  int noun;
+  int slot;
+
+  if (req->method != WEB_METHOD_GET) {
+    return web_queue_json_error(c, 405, "method_not_allowed");
+  }
+  if (web_query_int(req->query, "noun", &noun) <= 0) {
+    return web_queue_json_error(c, 400, "invalid_noun");
+  }
+  slot = monitor_find(noun, web_monitor_sink);
+  if (slot < 0) {
+    if (noun_lookup(noun) == NULL) {
+      return web_queue_json_error(c, 404, "unknown_noun");
+    }
+    slot = monitor_start(noun, ONE_SEC, web_monitor_sink);
+    if (slot < 0) {
+      return web_queue_json_error(c, 503, "busy");
+    }
+  }
+  web_monitor_read_ms[slot] = hal_time_ms();
+
+  v = monitor_table[slot].values;
+  sprintf(
+    body, "{\"noun\":%d,\"values\":[%d,%d,%d]}", noun, v[0], v[1], v[2]);
+  return web_queue_response(c, 200, "application/json", body);
+}
+
+/* ----------------------------------------------------------------
+ * Orbit report
+ * ---------------------------------------------------------------- */
+
+/* GET: recomputes and lists the orbit of every state vector.  POST
+ * {"r":[x,y,z],"v":[x,y,z]} (km, m/s) adds a user state vector, or
+ * to /orbits/csm or /orbits/lem replaces that vehicle's; POST
+ * /orbits/clear drops the user vectors. */
+static int
+web_queue_orbits(web_client_t* c, const web_request_t* req)
+{
+  char body[64 + NAV_ORBIT_SLOTS * 128];
+  char name[16];
+  const nav_orbit_t* o;
+  long r[3], v[3];
+  int count, pos, slot, i;
+
+  if (strcmp(req->path, "/orbits/clear") == 0) {
+    if (req->method != WEB_METHOD_POST) {
+      return web_queue_json_error(c, 405, "method_not_allowed");
+    }
+    nav_clear_user_states();
+    return web_queue_response(c, 200, "application/json", "{\"ok\":true}");
+  }
+  if (strcmp(req->path, "/orbits") != 0 && req->method != WEB_METHOD_POST) {
+    return web_queue_json_error(c, 405, "method_not_allowed");
+  }
+
+  if (req->method == WEB_METHOD_POST) {
+    if (web_parse_json_longs(req->body, "r", r, 3) != 3 ||
+        web_parse_json_longs(req->body, "v", v, 3) != 3) {
+      return web_queue_json_error(c, 400, "invalid_payload");
+    }
+    if (strcmp(req->path, "/orbits") != 0) {
+      slot = strcmp(req->path, "/orbits/csm") == 0 ? NAV_SLOT_CSM
+                                                   : NAV_SLOT_LEM;
+      if (nav_load_vehicle_state(slot, r, v) < 0) {
+        return web_queue_json_error(c, 400, "out_of_range");
+      }
+      sprintf(body, "{\"ok\":true,\"slot\":%d}", slot);
+      return web_queue_response(c, 200, "application/json", body);
+    }
+    if (nav_user_state_count >= NAV_USER_STATES) {
+      return web_queue_json_error(c, 503, "full");
+    }
+    slot = nav_load_user_state(r, v);
+    if (slot < 0) {
+      return web_queue_json_error(c, 400, "out_of_range");
+    }
+    sprintf(body, "{\"ok\":true,\"slot\":%d}", slot);
+    return web_queue_response(c, 200, "application/json", body);
+  }
+  if (req->method != WEB_METHOD_GET) {
+    return web_queue_json_error(c, 405, "method_not_allowed");
+  }
+
+  count = nav_orbit_report_update();
+  pos = sprintf(body, "{\"orbits\":[");
+  for (i = 0; i < count; i++) {
+    o = &nav_orbit_report.orbit[i];
+    if (i < NAV_SLOT_USER) {
+      strcpy(name, i == NAV_SLOT_CSM ? "csm" : "lem");
+    } else {
+      sprintf(name, "user%d", i - NAV_SLOT_USER + 1);
+    }
+    pos += sprintf(body + pos,
+                   "%s{\"slot\":%d,\"name\":\"%s\",\"apogee_km\":%ld,"
+                   "\"perigee_km\":%ld,\"period_s\":%ld,\"open\":%s}",
+                   i > 0 ? "," : "",
+                   i,
+                   name,
+                   o->open ? 99999L : o->apogee_km,
+                   o->perigee_km,
+                   o->period_sec,
+                   o->open ? "true" : "false");
+  }
+  sprintf(body + pos, "]}");
+  return web_queue_response(c, 200, "application/json", body);
+}
+
+/* ----------------------------------------------------------------
+ * Keystroke macros
+ * ---------------------------------------------------------------- */
+
+/* POST: body is a script (see macro.h), played at once; ?interval=CS
+ * sets the key spacing.  GET: progress of the current script. */
+static int
+web_queue_macro(web_client_t* c, const web_request_t* req)
+{
+  char body[WEB_MACRO_BODY_BUF];
+  char err[MACRO_MESSAGE_MAX];
+  char* p;
+  int interval;
+  int rc;
+
+  if (req->method == WEB_METHOD_POST) {
+    rc = web_query_int(req->query, "interval", &interval);
+    if (rc < 0 || (rc > 0 && interval > 16383)) {
+      return web_queue_json_error(c, 400, "invalid_interval");
+    }
+    if (macro_load(req->body, err, sizeof(err)) != 0) {
+      /* The message may quote script text */
+      p = body + sprintf(body, "{\"error\":\"invalid_script\",\"detail\":");
+      p = web_put_json_string(p, err);
+      strcpy(p, "}");
+      return web_queue_response(c, 400, "application/json", body);
+    }
+    if (rc > 0) {
+      macro_interval_cs = interval;
+    }
+    macro_play();
+    sprintf(body, "{\"ok\":true,\"steps\":%d}", macro_status.steps);
+    return web_queue_response(c, 200, "application/json", body);
+  }
+  if (req->method != WEB_METHOD_GET) {
+    return web_queue_json_error(c, 405, "method_not_allowed");
+  }
+  p = body + sprintf(body,
+                     "{\"running\":%s,\"step\":%d,\"steps\":%d,"
+                     "\"passed\":%d,\"failed\":%d,\"failure\":",
+                     macro_status.running ? "true" : "false",
+                     macro_status.step,
+                     macro_status.steps,
+                     macro_status.checks_passed,
+                     macro_status.checks_failed);
+  p = web_put_json_string(p, macro_status.failure);
+  strcpy(p, "}");
+  return web_queue_response(c, 200, "application/json", body);
+}
+
 static int
 web_handle_request(web_client_t* c, const web_request_t* req)
 {
   int keycode;
-  int frame_len;
-  char frame[WEB_SSE_FRAME_BUF];
+  int keycodes[WEB_KEY_QUEUE_CAP];
+  int key_count;
+  int i;
+  int rc;
+  int fps;
+  web_frame_t* frame;
+  char body[48];
   static const char sse_headers[] = "HTTP/1.1 200 OK\r\n"
                                     "Content-Type: text/event-stream\r\n"
                                     "Cache-Control: no-cache\r\n"
@@ -971,36 +2000,54 @@ web_handle_request(web_client_t* c, const web_request_t* req)
                                     "\r\n";
   static const char sse_retry[] = "retry: 1000\n\n";
 
+  /* A POST acts before it replies, so while its largest reply would
+   * not fit behind the queued ones it waits, not acting twice */
+  if (req->method == WEB_METHOD_POST &&
+      web_scratch_reserve(c, WEB_REPLY_HEADER_MAX + WEB_MACRO_BODY_BUF) ==
+        NULL &&
+      web_client_pending_bytes(c) > 0) {
+    return 1;
+  }
+
   if (strcmp(req->path, "/") == 0) {
     if (req->method != WEB_METHOD_GET) {
       return web_queue_json_error(c, 405, "method_not_allowed");
     }
-    return web_queue_response_lines(
-      c, 200, "text/html; charset=utf-8", web_index_html);
+    return web_queue_index(c, req);
   }
 
   if (strcmp(req->path, "/events") == 0) {
     if (req->method != WEB_METHOD_GET) {
       return web_queue_json_error(c, 405, "method_not_allowed");
     }
-    if (web_queue_bytes(c, sse_headers, (int)strlen(sse_headers)) != 0) {
+    fps = 0;
+    rc = web_query_int(req->query, "fps", &fps);
+    if (rc < 0 || (rc > 0 && fps == 0)) {
+      return web_queue_json_error(c, 400, "invalid_fps");
+    }
+    if (web_scratch_reserve(c, 0) == NULL) {
+      return web_scratch_short(c);
+    }
+    if (web_queue_static(c, sse_headers, (int)strlen(sse_headers)) != 0) {
       return -1;
     }
-    if (web_queue_bytes(c, sse_retry, (int)strlen(sse_retry)) != 0) {
+    if (web_queue_static(c, sse_retry, (int)strlen(sse_retry)) != 0) {
       return -1;
     }
     c->is_sse = 1;
     c->close_after_tx = 0;
     c->stalled_ticks = 0;
+    c->sse_interval_ms = web_sse_interval_ms(fps);
+    c->sse_last_ms = hal_time_ms();
 
-    frame_len = web_build_sse_snapshot_frame(frame, sizeof(frame));
-    if (frame_len < 0) {
+    /* The first snapshot rides in the same write as the headers */
+    frame = web_build_sse_snapshot_frame();
+    if (frame == NULL) {
       return -1;
     }
-    if (web_queue_sse_frame(c, frame, frame_len) != 0) {
-      return -1;
-    }
-    return 0;
+    rc = web_queue_seg(c, frame->data, frame->len, frame);
+    web_frame_release(frame);
+    return rc;
   }
 
   if (strcmp(req->path, "/key") == 0) {
@@ -1008,48 +2055,133 @@ web_handle_request(web_client_t* c, const web_request_t* req)
       return web_queue_json_error(c, 405, "method_not_allowed");
     }
     if (web_parse_keycode_json(req->body, req->content_length, &keycode) != 0) {
+      web_stat_keys_invalid++;
       return web_queue_json_error(c, 400, "invalid_payload");
     }
     if (!web_keycode_is_valid(keycode)) {
+      web_stat_keys_invalid++;
       return web_queue_json_error(c, 400, "invalid_keycode");
     }
     if (web_key_enqueue(keycode) != 0) {
+      web_stat_keys_busy++;
       return web_queue_json_error(c, 503, "busy");
     }
     return web_queue_response(c, 200, "application/json", "{\"ok\":true}");
   }
 
+  if (strcmp(req->path, "/keys") == 0) {
+    if (req->method != WEB_METHOD_POST) {
+      return web_queue_json_error(c, 405, "method_not_allowed");
+    }
+    key_count = web_parse_keycodes_json(
+      req->body, req->content_length, keycodes, WEB_KEY_QUEUE_CAP);
+    if (key_count < 0) {
+      web_stat_keys_invalid++;
+      return web_queue_json_error(c, 400, "invalid_payload");
+    }
+    for (i = 0; i < key_count; i++) {
+      if (!web_keycode_is_valid(keycodes[i])) {
+        web_stat_keys_invalid++;
+        return web_queue_json_error(c, 400, "invalid_keycode");
+      }
+    }
+    /* All or nothing: a partial batch would leave pinball mid-sequence */
+    if (web_key_count + key_count > WEB_KEY_QUEUE_CAP) {
+      web_stat_keys_busy++;
+      return web_queue_json_error(c, 503, "busy");
+    }
+    for (i = 0; i < key_count; i++) {
+      web_key_enqueue(keycodes[i]);
+    }
+    sprintf(body, "{\"ok\":true,\"queued\":%d}", key_count);
+    return web_queue_response(c, 200, "application/json", body);
+  }
+
+  if (strcmp(req->path, "/macro") == 0) {
+    return web_queue_macro(c, req);
+  }
+
+  if (strcmp(req->path, "/monitor") == 0) {
+    return web_queue_monitor(c, req);
+  }
+
+  if (strcmp(req->path, "/orbits") == 0 ||
+      strcmp(req->path, "/orbits/clear") == 0 ||
+      strcmp(req->path, "/orbits/csm") == 0 ||
+      strcmp(req->path, "/orbits/lem") == 0) {
+    return web_queue_orbits(c, req);
+  }
+
+  if (strcmp(req->path, "/metrics") == 0) {
+    if (req->method != WEB_METHOD_GET) {
+      return web_queue_json_error(c, 405, "method_not_allowed");
+    }
+    return web_queue_metrics(c);
+  }
+
   return web_queue_json_error(c, 404, "not_found");
 }
 
 static int
-web_process_client_request(web_client_t* c)
+web_process_client_requests(web_client_t* c)
 {
   web_request_t req;
   int parse_result;
+  int consumed;
+  int handled;
+  int off;
+  int rc;
 
-  if (c->is_sse) {
-    return 0;
-  }
-  if (c->rx_len <= 0) {
-    return 0;
-  }
+  off = 0;
+  handled = 0;
+  rc = 0;
 
-  parse_result = web_try_parse_request(c, &req);
-  if (parse_result == 0) {
-    return 0;
+  /* Answer pipelined requests in order until the TX side pushes back */
+  while (!c->is_sse && !c->close_after_tx && off < c->rx_len &&
+         handled < WEB_MAX_PIPELINE_PER_TICK) {
+    parse_result =
+      web_try_parse_request(c->rx_buf + off, c->rx_len - off, &req, &consumed);
+    if (parse_result == 0) {
+      break;
+    }
+    if (parse_result != 1) {
+      /* The stream cannot be resynchronized after a malformed request */
+      off = c->rx_len;
+      c->keep_alive = 0;
+      if (parse_result == 413) {
+        rc = web_queue_json_error(c, 413, "too_large");
+      } else if (parse_result == 414) {
+        rc = web_queue_json_error(c, 414, "uri_too_long");
+      } else {
+        rc = web_queue_json_error(c, 400, "bad_request");
+      }
+      break;
+    }
+
+    c->keep_alive = req.keep_alive;
+    rc = web_handle_request(c, &req);
+    if (rc > 0) {
+      /* Deferred until the queued responses drain; parse it again then */
+      rc = 0;
+      break;
+    }
+    off += consumed;
+    handled++;
+    if (rc != 0) {
+      break;
+    }
   }
-  if (parse_result == 413) {
-    c->rx_len = 0;
-    return web_queue_json_error(c, 413, "too_large");
+
+  if (off > 0) {
+    if (off < c->rx_len) {
+      memmove(c->rx_buf, c->rx_buf + off, (size_t)(c->rx_len - off));
+    }
+    c->rx_len -= off;
   }
-  if (parse_result != 1) {
+  if (c->is_sse) {
     c->rx_len = 0;
-    return web_queue_json_error(c, 400, "bad_request");
   }
-
-  c->rx_len = 0;
-  return web_handle_request(c, &req);
+  return rc;
 }
 
 static int
@@ -1066,6 +2198,43 @@ web_send_data(web_socket_t sock, const char* buf, int len)
 #endif
 }
 
+/* Gather write: one syscall for the header, body and frame regions */
+static int
+web_send_vec(web_socket_t sock, const web_iov_t* iov, int count)
+{
+#ifdef _WIN32
+  WSABUF bufs[WEB_TX_SEGS];
+  DWORD sent;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    bufs[i].buf = (CHAR*)iov[i].base;
+    bufs[i].len = (ULONG)iov[i].len;
+  }
+  if (WSASend(sock, bufs, (DWORD)count, &sent, 0, NULL, NULL) != 0) {
+    return -1;
+  }
+  return (int)sent;
+#else
+  struct iovec vec[WEB_TX_SEGS];
+  struct msghdr msg;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    vec[i].iov_base = (void*)iov[i].base;
+    vec[i].iov_len = (size_t)iov[i].len;
+  }
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = vec;
+  msg.msg_iovlen = count;
+#ifdef MSG_NOSIGNAL
+  return (int)sendmsg(sock, &msg, MSG_NOSIGNAL);
+#else
+  return (int)sendmsg(sock, &msg, 0);
+#endif
+#endif
+}
+
 static int
 web_read_client(web_client_t* c)
 {
@@ -1077,14 +2246,16 @@ web_read_client(web_client_t* c)
     return 0;
   }
 
+  /* A full buffer holds pipelined requests waiting on TX; read later */
   space = WEB_RX_BUF - c->rx_len;
   if (space <= 0) {
-    return -1;
+    return 0;
   }
 
   n = recv(c->sock, c->rx_buf + c->rx_len, space, 0);
   if (n > 0) {
     c->rx_len += n;
+    c->idle_ticks = 0;
     return 0;
   }
   if (n == 0) {
@@ -1098,27 +2269,52 @@ web_read_client(web_client_t* c)
   return -1;
 }
 
+static void
+web_consume_tx(web_client_t* c, int n)
+{
+  web_tx_seg_t* seg;
+  int left;
+
+  c->tx_pending -= n;
+  while (n > 0 && c->tx_seg_count > 0) {
+    seg = &c->tx_segs[c->tx_seg_head];
+    left = seg->len - c->tx_seg_off;
+    if (n < left) {
+      c->tx_seg_off += n;
+      return;
+    }
+    n -= left;
+    web_frame_release(seg->frame);
+    seg->frame = NULL;
+    c->tx_seg_head = (c->tx_seg_head + 1) % WEB_TX_SEGS;
+    c->tx_seg_count--;
+    c->tx_seg_off = 0;
+  }
+  if (c->tx_seg_count == 0) {
+    c->tx_seg_head = 0;
+    c->tx_len = 0;
+  }
+}
+
 static int
 web_flush_client(web_client_t* c)
 {
-  int pending;
+  web_iov_t iov[WEB_TX_SEGS];
+  web_tx_seg_t* seg;
+  int iov_count;
   int n;
   int err;
+  int i;
 
   if (!c->active) {
     return 0;
   }
 
-  if (c->tx_len == c->tx_off) {
-    c->tx_len = 0;
-    c->tx_off = 0;
-    if (web_promote_next_sse_frame(c) != 0) {
-      return -1;
-    }
+  if (web_promote_next_sse_frame(c) != 0) {
+    return -1;
   }
 
-  pending = c->tx_len - c->tx_off;
-  if (pending <= 0) {
+  if (c->tx_seg_count == 0) {
     c->stalled_ticks = 0;
     if (c->close_after_tx) {
       return -1;
@@ -1126,16 +2322,22 @@ web_flush_client(web_client_t* c)
     return 0;
   }
 
-  n = web_send_data(c->sock, c->tx_buf + c->tx_off, pending);
+  iov_count = c->tx_seg_count;
+  for (i = 0; i < iov_count; i++) {
+    seg = &c->tx_segs[(c->tx_seg_head + i) % WEB_TX_SEGS];
+    iov[i].base = seg->base;
+    iov[i].len = seg->len;
+  }
+  iov[0].base += c->tx_seg_off;
+  iov[0].len -= c->tx_seg_off;
+
+  n = web_send_vec(c->sock, iov, iov_count);
   if (n > 0) {
-    c->tx_off += n;
+    web_consume_tx(c, n);
+    web_stat_bytes_sent += (unsigned long)n;
     c->stalled_ticks = 0;
-    if (c->tx_off == c->tx_len) {
-      c->tx_off = 0;
-      c->tx_len = 0;
-      if (web_promote_next_sse_frame(c) != 0) {
-        return -1;
-      }
+    if (web_promote_next_sse_frame(c) != 0) {
+      return -1;
     }
   } else if (n == 0) {
     return -1;
@@ -1149,6 +2351,7 @@ web_flush_client(web_client_t* c)
 
   if (web_client_pending_bytes(c) > 0 &&
       c->stalled_ticks > WEB_STALL_TICKS_LIMIT) {
+    web_stat_dropped_stalled++;
     return -1;
   }
   if (c->close_after_tx && web_client_pending_bytes(c) == 0) {
@@ -1200,6 +2403,7 @@ web_accept_connections(void)
 
     slot = web_find_free_client_slot();
     if (slot < 0) {
+      web_stat_rejected_full++;
       web_reject_extra_client(sock);
       continue;
     }
@@ -1213,22 +2417,23 @@ web_accept_connections(void)
 static void
 web_broadcast_snapshot(void)
 {
-  char frame[WEB_SSE_FRAME_BUF];
-  int frame_len;
+  web_frame_t* frame;
   int i;
 
-  frame_len = web_build_sse_snapshot_frame(frame, sizeof(frame));
-  if (frame_len < 0) {
+  frame = web_build_sse_snapshot_frame();
+  if (frame == NULL) {
     return;
   }
 
   for (i = 0; i < WEB_MAX_CLIENTS; i++) {
     if (web_clients[i].active && web_clients[i].is_sse) {
-      if (web_queue_sse_frame(&web_clients[i], frame, frame_len) != 0) {
+      if (web_queue_sse_frame(&web_clients[i], frame) != 0) {
+        web_stat_dropped_overflow++;
         web_drop_client(i);
       }
     }
   }
+  web_frame_release(frame);
 }
 
 static void
@@ -1246,8 +2451,9 @@ web_maybe_send_heartbeat(void)
   for (i = 0; i < WEB_MAX_CLIENTS; i++) {
     if (web_clients[i].active && web_clients[i].is_sse) {
       if (web_client_pending_bytes(&web_clients[i]) == 0) {
-        if (web_queue_bytes(
+        if (web_queue_static(
               &web_clients[i], heartbeat, (int)strlen(heartbeat)) != 0) {
+          web_stat_dropped_overflow++;
           web_drop_client(i);
         }
       }
@@ -1261,17 +2467,15 @@ web_init_server(void)
   struct sockaddr_in addr;
   int i;
   int on;
-  int html_len;
   int net_rc;
   int rc;
   char open_cmd[192];
   int open_cmd_len;
 
-  /* Keep a hard bound: root page + response headers must fit TX buffer. */
-  html_len = web_text_lines_len(web_index_html);
-  if (html_len + 256 > WEB_TX_BUF) {
+  if (web_build_index_cache() != 0) {
     fprintf(stderr,
-            "Web backend init failed: WEB_TX_BUF too small for index HTML\n");
+            "Web backend init failed: WEB_INDEX_BUF too small for index "
+            "HTML\n");
     exit(1);
   }
 
@@ -1333,12 +2537,14 @@ web_init_server(void)
   for (i = 0; i < WEB_MAX_CLIENTS; i++) {
     web_reset_client(&web_clients[i]);
   }
+  memset(web_frames, 0, sizeof(web_frames));
 
   web_key_head = 0;
   web_key_tail = 0;
   web_key_count = 0;
   web_heartbeat_counter = 0;
   web_prev_display_valid = 0;
+  web_broadcast_pending = 0;
   web_running = 1;
 
   printf("Web backend listening on all interfaces: http://0.0.0.0:%d/\n",
@@ -1374,6 +2580,7 @@ static void
 web_update_server(void)
 {
   int i;
+  long now;
 
   if (!web_running) {
     return;
@@ -1392,7 +2599,13 @@ web_update_server(void)
     if (!web_clients[i].active) {
       continue;
     }
-    if (web_process_client_request(&web_clients[i]) != 0) {
+    if (web_process_client_requests(&web_clients[i]) != 0) {
+      web_drop_client(i);
+      continue;
+    }
+    if (!web_clients[i].is_sse &&
+        web_client_pending_bytes(&web_clients[i]) == 0 &&
+        ++web_clients[i].idle_ticks > WEB_IDLE_TICKS_LIMIT) {
       web_drop_client(i);
     }
   }
@@ -1401,7 +2614,19 @@ web_update_server(void)
       memcmp(&dsky_display, &web_prev_display, sizeof(dsky_display)) != 0) {
     web_prev_display = dsky_display;
     web_prev_display_valid = 1;
-    web_broadcast_snapshot();
+    web_broadcast_pending = 1;
+  }
+
+  /* Leading edge goes out at once; later changes in the window are
+   * coalesced into one frame of the latest state when it closes. */
+  if (web_broadcast_pending) {
+    now = hal_time_ms();
+    if (web_sse_max_fps <= 0 ||
+        now - web_last_broadcast_ms >= 1000 / web_sse_max_fps) {
+      web_broadcast_pending = 0;
+      web_last_broadcast_ms = now;
+      web_broadcast_snapshot();
+    }
   }
 
   web_maybe_send_heartbeat();
@@ -1451,6 +2676,12 @@ web_sleep(int ms)
   hal_sleep_ms(ms);
 }
 
+void
+dsky_web_set_max_fps(int fps)
+{
+  web_sse_max_fps = fps < 0 ? 0 : fps;
+}
+
 dsky_backend_t dsky_web_backend = { web_init_server,
                                     web_update_server,
                                     web_poll_key_input,
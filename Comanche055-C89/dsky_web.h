@@ -11,4 +11,14 @@
 
 extern dsky_backend_t dsky_web_backend;
 
+/* Caps SSE display broadcasts at fps frames/s; 0 sends every change */
+void
+dsky_web_set_max_fps(int fps);
+
+/* Encodes the display state as one SSE frame ("data: {...}\n\n"),
+ * as broadcast to subscribers.  Returns its length, or -1 if cap is
+ * too small. */
+int
+dsky_web_encode_state(char* out, int cap);
+
 #endif /* DSKY_WEB_H */
@@ -0,0 +1,262 @@
+/*
+ * dsky_web_bench.c -- Per-frame cost of the SSE broadcast.
+ *
+ * Checks that the web backend's frame encoder produces the same bytes
+ * as the old sprintf and copy path over a changing display, then
+ * times both for the given number of subscribers:
+ *
+ *   copy   state JSON formatted by sprintf into a temporary, copied
+ *          into a frame, and the frame copied to every subscriber
+ *   pool   state encoded by dsky_web_encode_state() straight into a
+ *          shared frame, and a reference taken per subscriber
+ *
+ * No sockets are opened; the numbers are the CPU cost per broadcast
+ * before the gather write.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "dsky.h"
+#include "dsky_web.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WB_DEFAULT_SUBSCRIBERS 16
+#define WB_MAX_SUBSCRIBERS 16 /* The web backend's client limit */
+#define WB_DEFAULT_SECONDS 0.5
+#define WB_FRAME_BUF 1024
+#define WB_CHECK_FRAMES 99UL
+
+/* A frame of the pool: shared by reference, never copied */
+typedef struct
+{
+  int refs;
+  int len;
+  char data[WB_FRAME_BUF];
+} wb_frame_t;
+
+/* ----------------------------------------------------------------
+ * Copy path, as the web backend broadcast before the frame pool
+ * ---------------------------------------------------------------- */
+
+static int
+wb_copy_frame(char* out, int cap)
+{
+  char json[768];
+  int json_len;
+
+  json_len = sprintf(json,
+                     "{\"lights\":{\"uplink_acty\":%d,\"temp\":%d,"
+                     "\"key_rel\":%d,\"vel\":%d,\"no_att\":%d,\"alt\":%d,"
+                     "\"gimbal_lock\":%d,\"tracker\":%d,\"prog_alarm\":%d,"
+                     "\"stby\":%d,\"restart\":%d,\"opr_err\":%d,"
+                     "\"comp_acty\":%d},"
+                     "\"prog\":[%d,%d],\"verb\":[%d,%d],\"noun\":[%d,%d],"
+                     "\"r1\":{\"sign\":%d,\"digits\":[%d,%d,%d,%d,%d]},"
+                     "\"r2\":{\"sign\":%d,\"digits\":[%d,%d,%d,%d,%d]},"
+                     "\"r3\":{\"sign\":%d,\"digits\":[%d,%d,%d,%d,%d]}}",
+                     dsky_display.light_uplink_acty,
+                     dsky_display.light_temp,
+                     dsky_display.light_key_rel,
+                     dsky_display.light_vel,
+                     dsky_display.light_no_att,
+                     dsky_display.light_alt,
+                     dsky_display.light_gimbal_lock,
+                     dsky_display.light_tracker,
+                     dsky_display.light_prog_alarm,
+                     dsky_display.light_stby,
+                     dsky_display.light_restart,
+                     dsky_display.light_opr_err,
+                     dsky_display.light_comp_acty,
+                     dsky_display.prog[0],
+                     dsky_display.prog[1],
+                     dsky_display.verb[0],
+                     dsky_display.verb[1],
+                     dsky_display.noun[0],
+                     dsky_display.noun[1],
+                     dsky_display.r1_sign,
+                     dsky_display.r1[0],
+                     dsky_display.r1[1],
+                     dsky_display.r1[2],
+                     dsky_display.r1[3],
+                     dsky_display.r1[4],
+                     dsky_display.r2_sign,
+                     dsky_display.r2[0],
+                     dsky_display.r2[1],
+                     dsky_display.r2[2],
+                     dsky_display.r2[3],
+                     dsky_display.r2[4],
+                     dsky_display.r3_sign,
+                     dsky_display.r3[0],
+                     dsky_display.r3[1],
+                     dsky_display.r3[2],
+                     dsky_display.r3[3],
+                     dsky_display.r3[4]);
+  if (json_len < 0 || 6 + json_len + 2 > cap) {
+    return -1;
+  }
+  memcpy(out, "data: ", 6);
+  memcpy(out + 6, json, (size_t)json_len);
+  out[6 + json_len] = '\n';
+  out[6 + json_len + 1] = '\n';
+  return 6 + json_len + 2;
+}
+
+/* ----------------------------------------------------------------
+ * Checks and timing
+ * ---------------------------------------------------------------- */
+
+/* Steps the registers through every digit, blank and sign, so both
+ * paths encode a changing display */
+static void
+wb_step_display(unsigned long n)
+{
+  int i;
+
+  for (i = 0; i < 5; i++) {
+    dsky_display.r1[i] = (int)((n + (unsigned long)i) % 11UL) - 1;
+    dsky_display.r2[i] = (int)((n * 3UL + (unsigned long)i) % 11UL) - 1;
+    dsky_display.r3[i] = (int)((n * 7UL + (unsigned long)i) % 11UL) - 1;
+  }
+  dsky_display.r1_sign = (int)(n % 3UL) - 1;
+  dsky_display.r2_sign = (int)((n / 3UL) % 3UL) - 1;
+  dsky_display.r3_sign = (int)((n / 9UL) % 3UL) - 1;
+  dsky_display.light_comp_acty = (int)(n & 1UL);
+}
+
+static double
+wb_seconds(clock_t start)
+{
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* Both paths must put the same bytes on the wire */
+static int
+wb_check(void)
+{
+  char copy[WB_FRAME_BUF];
+  char pool[WB_FRAME_BUF];
+  unsigned long n;
+  int copy_len, pool_len;
+
+  for (n = 0; n < WB_CHECK_FRAMES; n++) {
+    wb_step_display(n);
+    copy_len = wb_copy_frame(copy, WB_FRAME_BUF);
+    pool_len = dsky_web_encode_state(pool, WB_FRAME_BUF);
+    if (copy_len < 0 || copy_len != pool_len ||
+        memcmp(copy, pool, (size_t)copy_len) != 0) {
+      printf("frame %lu differs from the copy path\n", n);
+      return 1;
+    }
+  }
+  printf("check   %lu frames identical to the copy path\n",
+         WB_CHECK_FRAMES);
+  return 0;
+}
+
+static double
+wb_time_copy(int subscribers, double seconds)
+{
+  static char copies[WB_MAX_SUBSCRIBERS][WB_FRAME_BUF];
+  char frame[WB_FRAME_BUF];
+  unsigned long n;
+  clock_t start;
+  int len, i;
+
+  start = clock();
+  for (n = 0; wb_seconds(start) < seconds; n++) {
+    wb_step_display(n);
+    len = wb_copy_frame(frame, WB_FRAME_BUF);
+    for (i = 0; i < subscribers; i++) {
+      memcpy(copies[i], frame, (size_t)len);
+    }
+  }
+  return wb_seconds(start) / (double)(n > 0 ? n : 1);
+}
+
+static double
+wb_time_pool(int subscribers, double seconds)
+{
+  static wb_frame_t frame;
+  unsigned long n;
+  clock_t start;
+  int i;
+
+  start = clock();
+  for (n = 0; wb_seconds(start) < seconds; n++) {
+    wb_step_display(n);
+    frame.refs = 1;
+    frame.len = dsky_web_encode_state(frame.data, WB_FRAME_BUF);
+    for (i = 0; i < subscribers; i++) {
+      frame.refs++;
+    }
+    for (i = 0; i < subscribers; i++) {
+      frame.refs--;
+    }
+    frame.refs--;
+  }
+  return wb_seconds(start) / (double)(n > 0 ? n : 1);
+}
+
+/* ----------------------------------------------------------------
+ * Main
+ * ---------------------------------------------------------------- */
+
+static void
+wb_usage(void)
+{
+  printf("usage: dsky_web_bench [--subscribers 1-16] [--seconds S]\n");
+}
+
+int
+main(int argc, char* argv[])
+{
+  char* end;
+  double seconds, copy_sec, pool_sec;
+  long subscribers;
+  int i;
+
+  subscribers = WB_DEFAULT_SUBSCRIBERS;
+  seconds = WB_DEFAULT_SECONDS;
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--subscribers") == 0 && i + 1 < argc) {
+      subscribers = strtol(argv[++i], &end, 10);
+      if (*end != '\0' || end == argv[i] || subscribers < 1 ||
+          subscribers > WB_MAX_SUBSCRIBERS) {
+        printf("Invalid --subscribers value: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = strtod(argv[++i], &end);
+      if (*end != '\0' || end == argv[i] || seconds < 0.0) {
+        printf("Invalid --seconds value: %s\n", argv[i]);
+        return 2;
+      }
+    } else {
+      wb_usage();
+      return 2;
+    }
+  }
+
+  if (wb_check() != 0) {
+    printf("FAIL\n");
+    return 1;
+  }
+  copy_sec = wb_time_copy((int)subscribers, seconds);
+  pool_sec = wb_time_pool((int)subscribers, seconds);
+  printf("SSE broadcast, %ld subscriber(s):\n", subscribers);
+  printf("  copy   %8.1f ns/frame  sprintf, then a copy per subscriber\n",
+         copy_sec * 1e9);
+  printf("  pool   %8.1f ns/frame  encoded once, a reference per "
+         "subscriber\n",
+         pool_sec * 1e9);
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * ephemeris.c -- Lunar and solar ephemerides (LSPOS, LUNPOS, LUNVEL,
+ * SOLPOS).
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#include "agc_fixed.h"
+#include "ephemeris.h"
+#include "navigation.h"
+
+#include <math.h>
+
+#define EPHEM_NODES (EPHEM_DEGREE + 1)
+#define EPHEM_DAY_CS 8640000.0
+#define EPHEM_J2000_JD 2451545.0
+#define EPHEM_AU_KM 149597870.7
+#define EPHEM_PI 3.14159265358979323846
+#define EPHEM_RAD (EPHEM_PI / 180.0)
+
+/* ----------------------------------------------------------------
+ * Model
+ * ----------------------------------------------------------------
+ * Degrees, with T in Julian centuries from J2000:
+ *   lambda = 218.32 + 481267.881 T + sum a sin(b + c T)
+ *   beta   = sum a sin(b + c T)
+ *   pi     = 0.9508 + sum a cos(b + c T)
+ */
+
+typedef struct
+{
+  double a, b, c;
+} ephem_term_t;
+
+static const ephem_term_t ephem_moon_lon[] = {
+  { 6.29, 135.0, 477198.87 },  { -1.27, 259.3, -413335.36 },
+  { 0.66, 235.7, 890534.22 },  { 0.21, 269.9, 954397.74 },
+  { -0.19, 357.5, 35999.05 },  { -0.11, 186.5, 966404.03 }
+};
+
+static const ephem_term_t ephem_moon_lat[] = {
+  { 5.13, 93.3, 483202.02 },
+  { 0.28, 228.2, 960400.89 },
+  { -0.28, 318.3, 6003.15 },
+  { -0.17, 217.6, -407332.21 }
+};
+
+static const ephem_term_t ephem_moon_par[] = {
+  { 0.0518, 135.0, 477198.87 },
+  { 0.0095, 259.3, -413335.36 },
+  { 0.0078, 235.7, 890534.22 },
+  { 0.0028, 269.9, 954397.74 }
+};
+
+#define EPHEM_TERMS(t) (sizeof(t) / sizeof((t)[0]))
+
+static double
+ephem_series(const ephem_term_t* t, int n, double c, int use_cos)
+{
+  double sum, arg;
+  int i;
+
+  sum = 0.0;
+  for (i = 0; i < n; i++) {
+    arg = (t[i].b + t[i].c * c) * EPHEM_RAD;
+    sum += t[i].a * (use_cos ? cos(arg) : sin(arg));
+  }
+  return sum;
+}
+
+void
+ephem_model(int body, double get_cs, double r[3])
+{
+  double d, c, lon, lat, dist, eps, x, y, z, g;
+
+  d = (EPHEM_EPOCH_JD - EPHEM_J2000_JD) + get_cs / EPHEM_DAY_CS;
+  c = d / 36525.0;
+  if (body == EPHEM_MOON) {
+    lon = 218.32 + 481267.881 * c +
+          ephem_series(ephem_moon_lon, (int)EPHEM_TERMS(ephem_moon_lon), c, 0);
+    lat = ephem_series(ephem_moon_lat, (int)EPHEM_TERMS(ephem_moon_lat), c, 0);
+    dist = 1.0 / sin((0.9508 + ephem_series(ephem_moon_par,
+                                            (int)EPHEM_TERMS(ephem_moon_par),
+                                            c,
+                                            1)) *
+                     EPHEM_RAD);
+  } else {
+    g = (357.528 + 0.9856003 * d) * EPHEM_RAD;
+    lon = 280.460 + 0.9856474 * d + 1.915 * sin(g) + 0.020 * sin(2.0 * g);
+    lat = 0.0;
+    dist = (1.00014 - 0.01671 * cos(g) - 0.00014 * cos(2.0 * g)) *
+           EPHEM_AU_KM / NAV_DU_KM;
+  }
+
+  /* Ecliptic of date to the equator */
+  lon *= EPHEM_RAD;
+  lat *= EPHEM_RAD;
+  eps = (23.439 - 0.0130 * c) * EPHEM_RAD;
+  x = cos(lat) * cos(lon);
+  y = cos(lat) * sin(lon);
+  z = sin(lat);
+  r[0] = dist * x;
+  r[1] = dist * (cos(eps) * y - sin(eps) * z);
+  r[2] = dist * (sin(eps) * y + cos(eps) * z);
+}
+
+/* ----------------------------------------------------------------
+ * Segment cache
+ * ----------------------------------------------------------------
+ * Within segment s, x = 2 (t - s S) / S - 1 runs over [-1, 1) and
+ *   r(t) = sum c_k T_k(x),  k = 0..EPHEM_DEGREE,
+ * fitted at the Chebyshev nodes x_j = cos(pi (j + 1/2) / N).  A
+ * segment lives in slot s mod EPHEM_SLOTS of its body, so a pass
+ * forward or back in time keeps the segments around it.
+ */
+
+typedef struct
+{
+  int valid;
+  long segment;
+  agc_fx_t c[3][EPHEM_NODES];
+} ephem_slot_t;
+
+unsigned long ephem_lookup_count = 0;
+unsigned long ephem_fit_count = 0;
+
+static ephem_slot_t ephem_cache[EPHEM_BODIES][EPHEM_SLOTS];
+
+static void
+ephem_fit(int body, long segment, ephem_slot_t* slot)
+{
+  double f[EPHEM_NODES][3];
+  double t0, arg, sum;
+  int j, k, i;
+
+  t0 = (double)segment * (double)EPHEM_SEGMENT_CS;
+  for (j = 0; j < EPHEM_NODES; j++) {
+    arg = cos(EPHEM_PI * (j + 0.5) / EPHEM_NODES);
+    ephem_model(body, t0 + (arg + 1.0) * 0.5 * EPHEM_SEGMENT_CS, f[j]);
+  }
+  for (i = 0; i < 3; i++) {
+    for (k = 0; k < EPHEM_NODES; k++) {
+      sum = 0.0;
+      for (j = 0; j < EPHEM_NODES; j++) {
+        sum += f[j][i] * cos(EPHEM_PI * k * (j + 0.5) / EPHEM_NODES);
+      }
+      sum *= 2.0 / EPHEM_NODES;
+      slot->c[i][k] = agc_fx_from_double(k == 0 ? sum / 2 : sum);
+    }
+  }
+  slot->segment = segment;
+  slot->valid = 1;
+  ephem_fit_count++;
+}
+
+/* Returns the segment holding get_cs, fitting it on a miss, and its
+ * x in *x */
+static const ephem_slot_t*
+ephem_segment(int body, long get_cs, agc_fx_t* x)
+{
+  ephem_slot_t* slot;
+  long segment, offset;
+
+  if (get_cs >= 0) {
+    segment = get_cs / EPHEM_SEGMENT_CS;
+  } else {
+    segment = -((-get_cs - 1) / EPHEM_SEGMENT_CS) - 1;
+  }
+  offset = get_cs - segment * EPHEM_SEGMENT_CS;
+  slot = &ephem_cache[body][(int)(segment % EPHEM_SLOTS + EPHEM_SLOTS) %
+                            EPHEM_SLOTS];
+  ephem_lookup_count++;
+  if (!slot->valid || slot->segment != segment) {
+    ephem_fit(body, segment, slot);
+  }
+  *x = (agc_fx_t)(2 * offset - EPHEM_SEGMENT_CS) * AGC_FX_ONE /
+       EPHEM_SEGMENT_CS;
+  return slot;
+}
+
+/* Clenshaw: b_k = 2x b_(k+1) - b_(k+2) + c_k, sum = x b_1 - b_2 + c_0 */
+static agc_fx_t
+ephem_clenshaw(const agc_fx_t* c, int degree, agc_fx_t x)
+{
+  agc_fx_t b1, b2, b;
+  int k;
+
+  b1 = 0;
+  b2 = 0;
+  for (k = degree; k >= 1; k--) {
+    b = 2 * agc_fx_mul(x, b1) - b2 + c[k];
+    b2 = b1;
+    b1 = b;
+  }
+  return agc_fx_mul(x, b1) - b2 + c[0];
+}
+
+void
+ephem_position(int body, long get_cs, agc_fx_t r[3])
+{
+  const ephem_slot_t* slot;
+  agc_fx_t x;
+  int i;
+
+  slot = ephem_segment(body, get_cs, &x);
+  for (i = 0; i < 3; i++) {
+    r[i] = ephem_clenshaw(slot->c[i], EPHEM_DEGREE, x);
+  }
+}
+
+/* The derivative series, d_(k-1) = d_(k+1) + 2k c_k with d_0 halved,
+ * scaled by dx/dt = 2 / S */
+void
+ephem_velocity(int body, long get_cs, agc_fx_t v[3])
+{
+  const ephem_slot_t* slot;
+  agc_fx_t d[EPHEM_NODES + 1];
+  agc_fx_t x, dxdt;
+  int i, k;
+
+  slot = ephem_segment(body, get_cs, &x);
+  dxdt = agc_fx_div(AGC_FX_INT(2), nav_cs_to_tu(EPHEM_SEGMENT_CS));
+  for (i = 0; i < 3; i++) {
+    d[EPHEM_DEGREE] = 0;
+    d[EPHEM_DEGREE - 1] = 2 * EPHEM_DEGREE * slot->c[i][EPHEM_DEGREE];
+    for (k = EPHEM_DEGREE - 1; k >= 1; k--) {
+      d[k - 1] = d[k + 1] + 2 * k * slot->c[i][k];
+    }
+    d[0] /= 2;
+    v[i] = agc_fx_mul(ephem_clenshaw(d, EPHEM_DEGREE - 1, x), dxdt);
+  }
+}
@@ -0,0 +1,64 @@
+/*
+ * ephemeris.h -- Lunar and solar ephemerides (LSPOS, LUNPOS, LUNVEL,
+ * SOLPOS).
+ *
+ * Positions of the Moon and the Sun relative to the Earth, in the
+ * equatorial frame of the state vectors, at a ground elapsed time.
+ * GET 0 is the Apollo 11 liftoff.
+ *
+ * The model is the low precision series of the Astronomical Almanac:
+ * a few periodic terms in the ecliptic longitude, latitude and
+ * parallax of the Moon (about 0.3 degree), and the mean anomaly
+ * equation of centre for the Sun (about 0.01 degree).  It takes a
+ * dozen sines per call, so the flight routines do not call it
+ * directly.  Time is cut into EPHEM_SEGMENT_CS segments, and each body
+ * keeps a Chebyshev fit of EPHEM_DEGREE for the last EPHEM_SLOTS
+ * segments it was asked about.  A query inside a kept segment costs
+ * a table lookup and a short Clenshaw sum in fixed point; a miss fits
+ * the segment from EPHEM_DEGREE + 1 model evaluations.
+ *
+ * The table depends on nothing but time, so every AGC instance
+ * (agc_context.h) shares it.
+ *
+ * Maps to LUNAR_AND_SOLAR_EPHEMERIDES_SUBROUTINES.agc.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include "agc_fixed.h"
+
+#define EPHEM_MOON 0
+#define EPHEM_SUN 1
+#define EPHEM_BODIES 2
+
+/* Julian date of GET 0, 1969-07-16 13:32:00 UTC */
+#define EPHEM_EPOCH_JD 2440419.0638889
+
+/* Gravitational parameters in units of the Earth's (mu = 1) */
+#define EPHEM_MU_MOON (4902.800066 / 398600.4418)
+#define EPHEM_MU_SUN (1.32712440018e11 / 398600.4418)
+
+#define EPHEM_SEGMENT_CS 2160000L /* 6 hours */
+#define EPHEM_DEGREE 8
+#define EPHEM_SLOTS 8
+
+extern unsigned long ephem_lookup_count;
+extern unsigned long ephem_fit_count;
+
+/* Position in DU (LUNPOS, SOLPOS) */
+void
+ephem_position(int body, long get_cs, agc_fx_t r[3]);
+
+/* Velocity in DU/TU (LUNVEL, and the same for the Sun) */
+void
+ephem_velocity(int body, long get_cs, agc_fx_t v[3]);
+
+/* The model itself, in double precision, for the reference
+ * integration and for checking the fits */
+void
+ephem_model(int body, double get_cs, double r[3]);
+
+#endif /* EPHEMERIS_H */
@@ -5,6 +5,7 @@
  */
 
 #include "agc.h"
+#include "agc_context.h"
 #include "executive.h"
 
 #include <string.h>
@@ -16,6 +17,7 @@
 agc_coreset_t agc_coresets[NUM_CORE_SETS];
 int agc_current_job = -1;
 int agc_newjob = 0;
+unsigned long exec_dispatch_count[NUM_CORE_SETS];
 
 static int vac_inuse[NUM_VAC_AREAS];
 static volatile int job_ended;
@@ -38,6 +40,15 @@ exec_init(void)
   job_ended = 0;
 }
 
+void
+exec_register_state(void)
+{
+  agc_context_register(agc_coresets, sizeof(agc_coresets));
+  agc_context_register(&agc_current_job, sizeof(agc_current_job));
+  agc_context_register(&agc_newjob, sizeof(agc_newjob));
+  agc_context_register(vac_inuse, sizeof(vac_inuse));
+}
+
 /* ----------------------------------------------------------------
  * Internal helpers
  * ---------------------------------------------------------------- */
@@ -199,6 +210,7 @@ exec_run(void)
   agc_current_job = best;
   agc_newjob = 0;
   job_ended = 0;
+  exec_dispatch_count[best]++;
 
   if (agc_coresets[best].entry != NULL) {
     agc_coresets[best].entry();
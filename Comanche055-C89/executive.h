@@ -25,8 +25,13 @@ extern agc_coreset_t agc_coresets[NUM_CORE_SETS];
 extern int agc_current_job;
 extern int agc_newjob;
 
+/* Jobs dispatched per core set since power-on (not cleared by restart) */
+extern unsigned long exec_dispatch_count[NUM_CORE_SETS];
+
 void
 exec_init(void);
+void
+exec_register_state(void);
 int
 exec_novac(int priority, agc_jobfunc_t entry);
 int
@@ -0,0 +1,288 @@
+/*
+ * gzip.c -- Minimal gzip encoder: greedy LZ77 + fixed Huffman deflate.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#include "gzip.h"
+
+#include <string.h>
+
+#define GZ_WINDOW 32768
+#define GZ_MIN_MATCH 3
+#define GZ_MAX_MATCH 258
+#define GZ_HASH_BITS 12
+#define GZ_HASH_SIZE (1 << GZ_HASH_BITS)
+#define GZ_MAX_CHAIN 32
+
+/* ----------------------------------------------------------------
+ * CRC-32 (IEEE 802.3, reflected)
+ * ---------------------------------------------------------------- */
+
+static unsigned long gz_crc_table[256];
+static int gz_crc_ready = 0;
+
+static void
+gz_crc_init(void)
+{
+  unsigned long c;
+  int n, k;
+  for (n = 0; n < 256; n++) {
+    c = (unsigned long)n;
+    for (k = 0; k < 8; k++) {
+      c = (c & 1) ? (0xEDB88320UL ^ (c >> 1)) : (c >> 1);
+    }
+    gz_crc_table[n] = c;
+  }
+  gz_crc_ready = 1;
+}
+
+unsigned long
+gzip_crc32(const unsigned char* data, int len)
+{
+  unsigned long c;
+  int i;
+  if (!gz_crc_ready) {
+    gz_crc_init();
+  }
+  c = 0xFFFFFFFFUL;
+  for (i = 0; i < len; i++) {
+    c = gz_crc_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+  }
+  return (c ^ 0xFFFFFFFFUL) & 0xFFFFFFFFUL;
+}
+
+/* ----------------------------------------------------------------
+ * Bit writer (deflate packs bits LSB first)
+ * ---------------------------------------------------------------- */
+
+typedef struct
+{
+  unsigned char* out;
+  int cap;
+  int len;
+  unsigned long bitbuf;
+  int bitcount;
+  int overflow;
+} gz_writer_t;
+
+static void
+gz_put_bits(gz_writer_t* w, unsigned long bits, int count)
+{
+  w->bitbuf |= bits << w->bitcount;
+  w->bitcount += count;
+  while (w->bitcount >= 8) {
+    if (w->len < w->cap) {
+      w->out[w->len++] = (unsigned char)(w->bitbuf & 0xFF);
+    } else {
+      w->overflow = 1;
+    }
+    w->bitbuf >>= 8;
+    w->bitcount -= 8;
+  }
+}
+
+/* Huffman codes are defined MSB first; reverse them for the stream */
+static void
+gz_put_code(gz_writer_t* w, unsigned int code, int count)
+{
+  unsigned long rev;
+  int i;
+  rev = 0;
+  for (i = 0; i < count; i++) {
+    rev = (rev << 1) | ((code >> i) & 1);
+  }
+  gz_put_bits(w, rev, count);
+}
+
+static void
+gz_flush_bits(gz_writer_t* w)
+{
+  if (w->bitcount > 0) {
+    gz_put_bits(w, 0, 8 - w->bitcount);
+  }
+}
+
+static void
+gz_put_byte(gz_writer_t* w, int b)
+{
+  if (w->len < w->cap) {
+    w->out[w->len++] = (unsigned char)b;
+  } else {
+    w->overflow = 1;
+  }
+}
+
+static void
+gz_put_le32(gz_writer_t* w, unsigned long v)
+{
+  gz_put_byte(w, (int)(v & 0xFF));
+  gz_put_byte(w, (int)((v >> 8) & 0xFF));
+  gz_put_byte(w, (int)((v >> 16) & 0xFF));
+  gz_put_byte(w, (int)((v >> 24) & 0xFF));
+}
+
+/* ----------------------------------------------------------------
+ * Fixed Huffman symbols (RFC 1951 section 3.2.6)
+ * ---------------------------------------------------------------- */
+
+static const int gz_len_base[29] = { 3,  4,  5,  6,   7,   8,   9,   10,
+                                     11, 13, 15, 17,  19,  23,  27,  31,
+                                     35, 43, 51, 59,  67,  83,  99,  115,
+                                     131, 163, 195, 227, 258 };
+static const int gz_len_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                      1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                      4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const int gz_dist_base[30] = { 1,    2,    3,    4,     5,     7,
+                                      9,    13,   17,   25,    33,    49,
+                                      65,   97,   129,  193,   257,   385,
+                                      513,  769,  1025, 1537,  2049,  3073,
+                                      4097, 6145, 8193, 12289, 16385, 24577 };
+static const int gz_dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+                                       4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+                                       9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static void
+gz_put_litlen(gz_writer_t* w, int sym)
+{
+  if (sym < 144) {
+    gz_put_code(w, (unsigned int)(0x30 + sym), 8);
+  } else if (sym < 256) {
+    gz_put_code(w, (unsigned int)(0x190 + sym - 144), 9);
+  } else if (sym < 280) {
+    gz_put_code(w, (unsigned int)(sym - 256), 7);
+  } else {
+    gz_put_code(w, (unsigned int)(0xC0 + sym - 280), 8);
+  }
+}
+
+static void
+gz_put_match(gz_writer_t* w, int length, int distance)
+{
+  int i;
+
+  i = 28;
+  while (gz_len_base[i] > length) {
+    i--;
+  }
+  gz_put_litlen(w, 257 + i);
+  gz_put_bits(w, (unsigned long)(length - gz_len_base[i]), gz_len_extra[i]);
+
+  i = 29;
+  while (gz_dist_base[i] > distance) {
+    i--;
+  }
+  gz_put_code(w, (unsigned int)i, 5);
+  gz_put_bits(w, (unsigned long)(distance - gz_dist_base[i]), gz_dist_extra[i]);
+}
+
+/* ----------------------------------------------------------------
+ * Compressor
+ * ---------------------------------------------------------------- */
+
+static int gz_head[GZ_HASH_SIZE];
+static int gz_prev[GZ_WINDOW];
+
+static unsigned int
+gz_hash(const unsigned char* p)
+{
+  unsigned long h;
+  h = ((unsigned long)p[0] << 10) ^ ((unsigned long)p[1] << 5) ^ p[2];
+  return (unsigned int)((h * 2654435761UL) >> 8) & (GZ_HASH_SIZE - 1);
+}
+
+static void
+gz_insert(const unsigned char* in, int pos)
+{
+  unsigned int h = gz_hash(in + pos);
+  gz_prev[pos % GZ_WINDOW] = gz_head[h];
+  gz_head[h] = pos;
+}
+
+int
+gzip_compress(const unsigned char* in,
+              int in_len,
+              unsigned char* out,
+              int out_cap)
+{
+  gz_writer_t w;
+  int pos, cand, chain, best_len, best_dist, len, max_len, i;
+
+  memset(&w, 0, sizeof(w));
+  w.out = out;
+  w.cap = out_cap;
+
+  /* Member header: deflate, no flags, no mtime, unknown OS */
+  gz_put_byte(&w, 0x1F);
+  gz_put_byte(&w, 0x8B);
+  gz_put_byte(&w, 8);
+  for (i = 0; i < 6; i++) {
+    gz_put_byte(&w, 0);
+  }
+  gz_put_byte(&w, 0xFF);
+
+  for (i = 0; i < GZ_HASH_SIZE; i++) {
+    gz_head[i] = -1;
+  }
+
+  /* Single final block, fixed Huffman (BFINAL=1, BTYPE=01) */
+  gz_put_bits(&w, 1, 1);
+  gz_put_bits(&w, 1, 2);
+
+  pos = 0;
+  while (pos < in_len) {
+    best_len = 0;
+    best_dist = 0;
+
+    if (pos + GZ_MIN_MATCH <= in_len) {
+      max_len = in_len - pos;
+      if (max_len > GZ_MAX_MATCH) {
+        max_len = GZ_MAX_MATCH;
+      }
+      cand = gz_head[gz_hash(in + pos)];
+      chain = 0;
+      while (cand >= 0 && pos - cand <= GZ_WINDOW && chain < GZ_MAX_CHAIN) {
+        len = 0;
+        while (len < max_len && in[cand + len] == in[pos + len]) {
+          len++;
+        }
+        if (len > best_len) {
+          best_len = len;
+          best_dist = pos - cand;
+          if (len == max_len) {
+            break;
+          }
+        }
+        cand = gz_prev[cand % GZ_WINDOW];
+        chain++;
+      }
+    }
+
+    if (best_len >= GZ_MIN_MATCH) {
+      gz_put_match(&w, best_len, best_dist);
+      for (i = 0; i < best_len; i++) {
+        if (pos + GZ_MIN_MATCH <= in_len) {
+          gz_insert(in, pos);
+        }
+        pos++;
+      }
+    } else {
+      gz_put_litlen(&w, in[pos]);
+      if (pos + GZ_MIN_MATCH <= in_len) {
+        gz_insert(in, pos);
+      }
+      pos++;
+    }
+  }
+
+  gz_put_litlen(&w, 256);
+  gz_flush_bits(&w);
+
+  gz_put_le32(&w, gzip_crc32(in, in_len));
+  gz_put_le32(&w, (unsigned long)in_len);
+
+  if (w.overflow) {
+    return -1;
+  }
+  return w.len;
+}
@@ -0,0 +1,24 @@
+/*
+ * gzip.h -- Minimal gzip (RFC 1952) encoder and CRC-32.
+ *
+ * Compresses a buffer with LZ77 and the fixed Huffman code of
+ * deflate (RFC 1951).  Meant for static content prepared once at
+ * startup, so it trades ratio for size and simplicity.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifndef GZIP_H
+#define GZIP_H
+
+unsigned long
+gzip_crc32(const unsigned char* data, int len);
+
+/* Returns the compressed length, or -1 if out_cap is too small. */
+int
+gzip_compress(const unsigned char* in,
+              int in_len,
+              unsigned char* out,
+              int out_cap);
+
+#endif /* GZIP_H */
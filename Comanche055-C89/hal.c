@@ -10,6 +10,8 @@
 
 #include "hal.h"
 
+#include <stdio.h>
+
 #ifdef _WIN32
 
 #include <conio.h>
@@ -44,6 +46,24 @@ hal_time_ms(void)
   return (long)GetTickCount64();
 }
 
+int
+hal_write_stdout(const char* buf, int len)
+{
+  HANDLE h = GetStdHandle(STD_OUTPUT_HANDLE);
+  DWORD written;
+  int off = 0;
+
+  fflush(stdout);
+  while (off < len) {
+    if (!WriteFile(h, buf + off, (DWORD)(len - off), &written, NULL) ||
+        written == 0) {
+      return -1;
+    }
+    off += (int)written;
+  }
+  return 0;
+}
+
 void
 hal_term_init(void)
 {
@@ -68,6 +88,7 @@ hal_term_cleanup(void)
 
 #else
 
+#include <errno.h>
 #include <sys/select.h>
 #include <termios.h>
 #include <time.h>
@@ -115,6 +136,26 @@ hal_time_ms(void)
   return (long)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
 }
 
+int
+hal_write_stdout(const char* buf, int len)
+{
+  ssize_t n;
+  int off = 0;
+
+  fflush(stdout);
+  while (off < len) {
+    n = write(STDOUT_FILENO, buf + off, (size_t)(len - off));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    off += (int)n;
+  }
+  return 0;
+}
+
 void
 hal_term_init(void)
 {
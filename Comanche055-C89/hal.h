@@ -4,6 +4,9 @@
  * Provides non-blocking keyboard input, terminal mode setup/restore,
  * sleep, and monotonic time services for front-end modules.
  *
+ * hal_write_stdout() bypasses stdio: it flushes stdout, then hands the
+ * buffer to the OS in as few writes as it will take (normally one).
+ *
  * Comanche055 (Apollo 11 CM) ANSI C89 port.
  */
 
@@ -22,5 +25,7 @@ void
 hal_sleep_ms(int ms);
 long
 hal_time_ms(void);
+int
+hal_write_stdout(const char* buf, int len);
 
 #endif /* HAL_H */
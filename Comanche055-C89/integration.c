@@ -0,0 +1,467 @@
+/*
+ * integration.c -- Orbital integration: Encke's method for the
+ * CSM and LEM state vectors.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#include "agc.h"
+#include "agc_context.h"
+#include "agc_cpu.h"
+#include "agc_fixed.h"
+#include "ephemeris.h"
+#include "executive.h"
+#include "integration.h"
+#include "navigation.h"
+#include "waitlist.h"
+
+#include <math.h>
+#include <string.h>
+
+#define INTEG_VEHICLES 2
+#define INTEG_PRIORITY PRIO5
+
+/* ----------------------------------------------------------------
+ * State
+ * ---------------------------------------------------------------- */
+
+typedef struct
+{
+  int active;
+  agc_state_vector_t synced; /* Vector as last written back */
+  nav_fx_state_t conic;      /* Osculating conic at rectification */
+  long conic_cs;             /* Time of rectification */
+  agc_fx_t delta[3];         /* Position deviation from the conic */
+  agc_fx_t nu[3];            /* Velocity deviation */
+  long t_cs;                 /* Time integrated to */
+  double ref_r[3];           /* Reference path, DU and DU/TU */
+  double ref_v[3];
+} integ_vehicle_t;
+
+int integ_reference_enabled = 0;
+double integ_reference_error_m = 0.0;
+unsigned long integ_step_count = 0;
+unsigned long integ_rectify_count = 0;
+
+static integ_vehicle_t integ_vehicles[INTEG_VEHICLES];
+static int integ_job_pending = 0;
+
+static agc_state_vector_t* const integ_states[INTEG_VEHICLES] = {
+  &nav_csm_state,
+  &nav_lem_state
+};
+
+static void
+integ_task(void);
+
+void
+integ_init(void)
+{
+  memset(integ_vehicles, 0, sizeof(integ_vehicles));
+  integ_job_pending = 0;
+  waitlist_cancel(integ_task);
+  waitlist_add(INTEG_PERIOD_CS, integ_task);
+}
+
+void
+integ_register_state(void)
+{
+  agc_context_register(integ_vehicles, sizeof(integ_vehicles));
+  agc_context_register(&integ_job_pending, sizeof(integ_job_pending));
+}
+
+static long
+integ_now(void)
+{
+  return (long)agc_time2 * 16384L + (long)agc_time1;
+}
+
+/* ----------------------------------------------------------------
+ * Force model
+ * ---------------------------------------------------------------- */
+
+/* Oblateness: with mu = 1 and Re = 1,
+ *   a = -3/2 J2 / r^5 * (x (1 - 5 z^2/r^2), y (1 - ...), z (3 - ...)) */
+static void
+integ_j2_fx(const agc_fx_t* r, agc_fx_t* a)
+{
+  agc_fx_t r2, r5, k, zz;
+
+  r2 = agc_fx_vec_dot(r, r);
+  r5 = agc_fx_mul(agc_fx_mul(r2, r2), agc_fx_sqrt(r2));
+  k = agc_fx_div(AGC_FX_CONST(-1.5 * NAV_J2), r5);
+  zz = agc_fx_div(5 * agc_fx_mul(r[2], r[2]), r2);
+  a[0] = agc_fx_mul(agc_fx_mul(k, r[0]), AGC_FX_ONE - zz);
+  a[1] = agc_fx_mul(agc_fx_mul(k, r[1]), AGC_FX_ONE - zz);
+  a[2] = agc_fx_mul(agc_fx_mul(k, r[2]), AGC_FX_INT(3) - zz);
+}
+
+/* Magnitude of a vector as far out as the Sun, whose square would not
+ * fit: taken on the vector scaled down by 2^12 */
+static agc_fx_t
+integ_far_mag(const agc_fx_t* r)
+{
+  agc_fx_t s[3];
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    s[i] = r[i] / 4096;
+  }
+  return agc_fx_vec_mag(s) * 4096;
+}
+
+/* Moon and Sun at distance rb, with d = rb - r:
+ *   a = mu_b (d / |d|^3 - rb / |rb|^3)
+ *     = mu_b / |rb|^3 (d (|rb| / |d|)^3 - rb),
+ * in which neither cube overflows */
+static void
+integ_third_body_fx(const agc_fx_t* r, long t_cs, agc_fx_t* a)
+{
+  static const agc_fx_t mu[EPHEM_BODIES] = {
+    AGC_FX_CONST(EPHEM_MU_MOON),
+    AGC_FX_CONST(EPHEM_MU_SUN)
+  };
+  agc_fx_t rb[3], d[3], rbm, ratio, k;
+  int b, i;
+
+  a[0] = 0;
+  a[1] = 0;
+  a[2] = 0;
+  for (b = 0; b < EPHEM_BODIES; b++) {
+    ephem_position(b, t_cs, rb);
+    agc_fx_vec_sub(rb, r, d);
+    rbm = integ_far_mag(rb);
+    ratio = agc_fx_div(rbm, integ_far_mag(d));
+    ratio = agc_fx_mul(agc_fx_mul(ratio, ratio), ratio);
+    k = agc_fx_div(agc_fx_div(agc_fx_div(mu[b], rbm), rbm), rbm);
+    for (i = 0; i < 3; i++) {
+      a[i] += agc_fx_mul(k, agc_fx_mul(d[i], ratio) - rb[i]);
+    }
+  }
+}
+
+/* Deviation acceleration at tau after rectification.  With r = rc + d
+ * and q = d.(d + 2 rc) / rc^2,
+ *   d'' = -d / rc^3 + f(q) r / r^3 + a_J2(r) + a_3(r),
+ *   f(q) = q (3 + 3q + q^2) / (1 + (1 + q)^3/2),
+ * which avoids differencing two nearly equal central accelerations.
+ * t_cs is the same time on the clock, for the Moon and the Sun.  The
+ * conic state at tau is returned in *conic. */
+static void
+integ_deviation_accel(const integ_vehicle_t* v,
+                      agc_fx_t tau,
+                      long t_cs,
+                      const agc_fx_t* delta,
+                      agc_fx_t* accel,
+                      nav_fx_state_t* conic)
+{
+  agc_fx_t r[3], sum[3], j2[3], third[3];
+  agc_fx_t rc2, rc3, q, one_q, fq, r3;
+
+  nav_kepler_fx(&v->conic, tau, conic);
+  agc_fx_vec_add(conic->r, delta, r);
+
+  rc2 = agc_fx_vec_dot(conic->r, conic->r);
+  rc3 = agc_fx_mul(rc2, agc_fx_sqrt(rc2));
+  agc_fx_vec_madd(delta, AGC_FX_INT(2), conic->r, sum);
+  q = agc_fx_div(agc_fx_vec_dot(delta, sum), rc2);
+  one_q = AGC_FX_ONE + q;
+  fq = agc_fx_div(
+    agc_fx_mul(q, AGC_FX_INT(3) + 3 * q + agc_fx_mul(q, q)),
+    AGC_FX_ONE + agc_fx_mul(one_q, agc_fx_sqrt(one_q)));
+  r3 = agc_fx_mul(agc_fx_mul(rc2, one_q), agc_fx_sqrt(agc_fx_mul(rc2, one_q)));
+
+  agc_fx_vec_scale(agc_fx_div(-AGC_FX_ONE, rc3), delta, accel);
+  agc_fx_vec_madd(accel, agc_fx_div(fq, r3), r, accel);
+  integ_j2_fx(r, j2);
+  agc_fx_vec_add(accel, j2, accel);
+  integ_third_body_fx(r, t_cs, third);
+  agc_fx_vec_add(accel, third, accel);
+}
+
+/* ----------------------------------------------------------------
+ * Encke step (fourth-order Nystrom)
+ * ----------------------------------------------------------------
+ *   k1 = g(t, d)
+ *   k2 = g(t + h/2, d + h/2 n + h^2/8 k1)
+ *   k3 = g(t + h, d + h n + h^2/2 k2)
+ *   d' = d + h n + h^2/6 (k1 + 2 k2)
+ *   n' = n + h/6 (k1 + 4 k2 + k3)
+ */
+
+static void
+integ_step(integ_vehicle_t* v, long h_cs, nav_fx_state_t* now)
+{
+  agc_fx_t k1[3], k2[3], k3[3], d[3], sum[3];
+  agc_fx_t tau, h, h2;
+  nav_fx_state_t conic;
+  int i;
+
+  tau = nav_cs_to_tu(v->t_cs - v->conic_cs);
+  h = nav_cs_to_tu(h_cs);
+  h2 = agc_fx_mul(h, h);
+
+  integ_deviation_accel(v, tau, v->t_cs, v->delta, k1, &conic);
+
+  agc_fx_vec_madd(v->delta, h / 2, v->nu, d);
+  agc_fx_vec_madd(d, h2 / 8, k1, d);
+  integ_deviation_accel(v, tau + h / 2, v->t_cs + h_cs / 2, d, k2, &conic);
+
+  agc_fx_vec_madd(v->delta, h, v->nu, d);
+  agc_fx_vec_madd(d, h2 / 2, k2, d);
+  integ_deviation_accel(v, tau + h, v->t_cs + h_cs, d, k3, &conic);
+
+  for (i = 0; i < 3; i++) {
+    sum[i] = k1[i] + 2 * k2[i];
+  }
+  agc_fx_vec_madd(v->delta, h, v->nu, v->delta);
+  agc_fx_vec_madd(v->delta, h2 / 6, sum, v->delta);
+  for (i = 0; i < 3; i++) {
+    sum[i] = k1[i] + 4 * k2[i] + k3[i];
+  }
+  agc_fx_vec_madd(v->nu, h / 6, sum, v->nu);
+
+  v->t_cs += h_cs;
+  agc_fx_vec_add(conic.r, v->delta, now->r);
+  agc_fx_vec_add(conic.v, v->nu, now->v);
+  integ_step_count++;
+
+  /* Rectify once |d| > |rc| / INTEG_RECTIFY_RATIO */
+  if (agc_fx_mul(agc_fx_vec_dot(v->delta, v->delta),
+                 AGC_FX_INT((long)INTEG_RECTIFY_RATIO * INTEG_RECTIFY_RATIO)) >
+        agc_fx_vec_dot(conic.r, conic.r) ||
+      v->t_cs - v->conic_cs >= INTEG_CONIC_MAX_CS) {
+    v->conic = *now;
+    v->conic_cs = v->t_cs;
+    memset(v->delta, 0, sizeof(v->delta));
+    memset(v->nu, 0, sizeof(v->nu));
+    integ_rectify_count++;
+  }
+}
+
+/* ----------------------------------------------------------------
+ * Reference path (double precision, Cowell, classical RK4)
+ * ---------------------------------------------------------------- */
+
+static void
+integ_ref_accel(const double* r, double t_cs, double* a)
+{
+  static const double mu[EPHEM_BODIES] = { EPHEM_MU_MOON, EPHEM_MU_SUN };
+  double rb[3], d[3];
+  double r2, rm, k, zz, dm, rbm;
+  int b, i;
+
+  r2 = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+  rm = sqrt(r2);
+  for (i = 0; i < 3; i++) {
+    a[i] = -r[i] / (r2 * rm);
+  }
+  k = -1.5 * NAV_J2 / (r2 * r2 * rm);
+  zz = 5.0 * r[2] * r[2] / r2;
+  a[0] += k * r[0] * (1.0 - zz);
+  a[1] += k * r[1] * (1.0 - zz);
+  a[2] += k * r[2] * (3.0 - zz);
+  for (b = 0; b < EPHEM_BODIES; b++) {
+    ephem_model(b, t_cs, rb);
+    for (i = 0; i < 3; i++) {
+      d[i] = rb[i] - r[i];
+    }
+    dm = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    rbm = sqrt(rb[0] * rb[0] + rb[1] * rb[1] + rb[2] * rb[2]);
+    for (i = 0; i < 3; i++) {
+      a[i] += mu[b] * (d[i] / (dm * dm * dm) - rb[i] / (rbm * rbm * rbm));
+    }
+  }
+}
+
+/* From t_cs, h in TU */
+static void
+integ_ref_step(integ_vehicle_t* v, long t_cs, long h_cs, double h)
+{
+  double r[4][3], vel[4][3], a[4][3];
+  double w;
+  int s, i;
+
+  for (i = 0; i < 3; i++) {
+    r[0][i] = v->ref_r[i];
+    vel[0][i] = v->ref_v[i];
+  }
+  integ_ref_accel(r[0], (double)t_cs, a[0]);
+  for (s = 1; s < 4; s++) {
+    w = s < 3 ? h / 2 : h;
+    for (i = 0; i < 3; i++) {
+      r[s][i] = v->ref_r[i] + w * vel[s - 1][i];
+      vel[s][i] = v->ref_v[i] + w * a[s - 1][i];
+    }
+    integ_ref_accel(r[s], t_cs + (s < 3 ? h_cs / 2.0 : (double)h_cs), a[s]);
+  }
+  for (i = 0; i < 3; i++) {
+    v->ref_r[i] +=
+      h / 6 * (vel[0][i] + 2 * vel[1][i] + 2 * vel[2][i] + vel[3][i]);
+    v->ref_v[i] += h / 6 * (a[0][i] + 2 * a[1][i] + 2 * a[2][i] + a[3][i]);
+  }
+}
+
+static double
+integ_ref_error_m(const integ_vehicle_t* v, const nav_fx_state_t* now)
+{
+  double d, sum;
+  int i;
+
+  sum = 0.0;
+  for (i = 0; i < 3; i++) {
+    d = agc_fx_to_double(now->r[i]) - v->ref_r[i];
+    sum += d * d;
+  }
+  return sqrt(sum) * NAV_DU_KM * 1000.0;
+}
+
+/* ----------------------------------------------------------------
+ * Executive job
+ * ---------------------------------------------------------------- */
+
+static void
+integ_sync(integ_vehicle_t* v, const agc_state_vector_t* sv)
+{
+  int i;
+
+  memset(v, 0, sizeof(*v));
+  nav_state_to_fx(sv, &v->conic);
+  v->conic_cs = (long)sv->time;
+  v->t_cs = v->conic_cs;
+  for (i = 0; i < 3; i++) {
+    v->ref_r[i] = agc_fx_to_double(v->conic.r[i]);
+    v->ref_v[i] = agc_fx_to_double(v->conic.v[i]);
+  }
+  v->synced = *sv;
+  v->active = 1;
+}
+
+/* Steps one vehicle towards now; returns the steps taken */
+static int
+integ_advance(integ_vehicle_t* v,
+              agc_state_vector_t* sv,
+              long now,
+              int budget)
+{
+  nav_fx_state_t state;
+  double error;
+  long h_cs;
+  int steps;
+
+  if (nav_state_empty(sv)) {
+    v->active = 0;
+    return 0;
+  }
+  if (!v->active || memcmp(sv, &v->synced, sizeof(*sv)) != 0) {
+    integ_sync(v, sv);
+  }
+
+  steps = 0;
+  while (v->t_cs < now && steps < budget) {
+    h_cs = now - v->t_cs;
+    if (h_cs > INTEG_STEP_MAX_CS) {
+      h_cs = INTEG_STEP_MAX_CS;
+    }
+    integ_step(v, h_cs, &state);
+    if (integ_reference_enabled) {
+      integ_ref_step(
+        v, v->t_cs - h_cs, h_cs, agc_fx_to_double(nav_cs_to_tu(h_cs)));
+      error = integ_ref_error_m(v, &state);
+      if (error > integ_reference_error_m) {
+        integ_reference_error_m = error;
+      }
+    }
+    steps++;
+  }
+
+  if (steps > 0) {
+    nav_state_from_fx(&state, sv);
+    sv->time = (agc_dp_t)v->t_cs;
+    v->synced = *sv;
+  }
+  return steps;
+}
+
+static void
+integ_job(void)
+{
+  long now;
+  int i, budget, behind;
+
+  now = integ_now();
+  budget = INTEG_STEPS_PER_JOB;
+  behind = 0;
+  for (i = 0; i < INTEG_VEHICLES; i++) {
+    budget -= integ_advance(&integ_vehicles[i], integ_states[i], now, budget);
+    if (integ_vehicles[i].active && integ_vehicles[i].t_cs < now) {
+      behind = 1;
+    }
+  }
+
+  /* Catching up on a long gap continues at the next dispatch */
+  if (behind) {
+    exec_changejob();
+    return;
+  }
+  integ_job_pending = 0;
+  exec_endofjob();
+}
+
+static void
+integ_task(void)
+{
+  waitlist_add(INTEG_PERIOD_CS, integ_task);
+  if (!integ_job_pending && exec_novac(INTEG_PRIORITY, integ_job) >= 0) {
+    integ_job_pending = 1;
+  }
+}
+
+/* ----------------------------------------------------------------
+ * One-call propagation
+ * ---------------------------------------------------------------- */
+
+static long
+integ_step_cs(long t_cs, long time_cs)
+{
+  return time_cs - t_cs > INTEG_STEP_MAX_CS ? INTEG_STEP_MAX_CS
+                                            : time_cs - t_cs;
+}
+
+long
+integ_encke(const agc_state_vector_t* sv, long time_cs, nav_fx_state_t* out)
+{
+  integ_vehicle_t v;
+  long steps;
+
+  integ_sync(&v, sv);
+  *out = v.conic;
+  for (steps = 0; v.t_cs < time_cs; steps++) {
+    integ_step(&v, integ_step_cs(v.t_cs, time_cs), out);
+  }
+  return steps;
+}
+
+long
+integ_cowell(const agc_state_vector_t* sv,
+             long time_cs,
+             double r[3],
+             double v[3])
+{
+  integ_vehicle_t veh;
+  long t_cs, h_cs, steps;
+  int i;
+
+  integ_sync(&veh, sv);
+  t_cs = veh.t_cs;
+  for (steps = 0; t_cs < time_cs; steps++) {
+    h_cs = integ_step_cs(t_cs, time_cs);
+    integ_ref_step(&veh, t_cs, h_cs, agc_fx_to_double(nav_cs_to_tu(h_cs)));
+    t_cs += h_cs;
+  }
+  for (i = 0; i < 3; i++) {
+    r[i] = veh.ref_r[i];
+    v[i] = veh.ref_v[i];
+  }
+  return steps;
+}
@@ -0,0 +1,63 @@
+/*
+ * integration.h -- Orbital integration: Encke's method for the
+ * CSM and LEM state vectors.
+ *
+ * Each vehicle follows an osculating conic (nav_kepler_fx) plus a
+ * deviation from it, integrated with a fourth-order Nystrom step
+ * under Earth oblateness (J2).  Once the deviation passes
+ * 1/INTEG_RECTIFY_RATIO of the radius, or the conic arc passes
+ * INTEG_CONIC_MAX_CS, the conic is rectified: restarted from the
+ * current state with no deviation.
+ *
+ * A waitlist task every INTEG_PERIOD_CS puts a background job on the
+ * executive that brings both vehicles up to the current time, taking
+ * at most INTEG_STEPS_PER_JOB steps per dispatch.  A state vector
+ * changed from outside is picked up on the next pass and integrated
+ * forward from its time tag.
+ *
+ * When integ_reference_enabled is set (--nav-reference), a double
+ * precision Cowell integration of the same force model runs alongside,
+ * and integ_reference_error_m holds the largest position difference.
+ *
+ * Maps to ORBITAL_INTEGRATION.agc.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifndef INTEGRATION_H
+#define INTEGRATION_H
+
+#include "navigation.h"
+
+#define INTEG_PERIOD_CS 200
+#define INTEG_STEP_MAX_CS 2000
+#define INTEG_STEPS_PER_JOB 8
+#define INTEG_RECTIFY_RATIO 1024
+#define INTEG_CONIC_MAX_CS 360000L
+
+extern int integ_reference_enabled;
+extern double integ_reference_error_m;
+extern unsigned long integ_step_count;
+extern unsigned long integ_rectify_count;
+
+/* Resynchronizes from the state vectors and arms the waitlist task;
+ * called by fresh_start() */
+void
+integ_init(void);
+void
+integ_register_state(void);
+
+/* For tools: carry sv to time_cs in one call, outside the executive,
+ * in steps of at most INTEG_STEP_MAX_CS.  integ_encke() takes the
+ * Encke steps of the background job; integ_cowell() runs the double
+ * precision reference alone, into DU and DU/TU.  Both return the
+ * steps taken. */
+long
+integ_encke(const agc_state_vector_t* sv, long time_cs, nav_fx_state_t* out);
+long
+integ_cowell(const agc_state_vector_t* sv,
+             long time_cs,
+             double r[3],
+             double v[3]);
+
+#endif /* INTEGRATION_H */
@@ -0,0 +1,240 @@
+/*
+ * latlong.c -- Latitude, longitude and altitude of the CSM (noun 43).
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#include "agc.h"
+#include "agc_context.h"
+#include "agc_cpu.h"
+#include "agc_fixed.h"
+#include "latlong.h"
+#include "navigation.h"
+
+#include <string.h>
+
+#define LATLONG_PI AGC_FX_CONST(3.14159265358979323846)
+#define LATLONG_DEG_PER_RAD AGC_FX_CONST(57.295779513082320877)
+#define LATLONG_TAN_PI_8 AGC_FX_CONST(0.41421356237309504880)
+/* Scaled by 2^-8 */
+#define LATLONG_REV_PER_CS_256                                                 \
+  AGC_FX_CONST(4294967296.0 * LATLONG_REV_PER_DAY / 8640000.0)
+#define LATLONG_ONE_MINUS_F_SQ                                                 \
+  AGC_FX_CONST((1.0 - LATLONG_FLATTENING) * (1.0 - LATLONG_FLATTENING))
+#define LATLONG_TENTH_NM_PER_KM AGC_FX_CONST(10.0 / 1.852)
+
+#define LATLONG_ATAN_TERMS 15
+
+typedef struct
+{
+  int valid;
+  int status;
+  long t_cs;
+  agc_state_vector_t sv; /* CSM vector the fix came from */
+  latlong_t fix;
+} latlong_cache_t;
+
+static latlong_cache_t latlong_cache;
+
+void
+latlong_init(void)
+{
+  memset(&latlong_cache, 0, sizeof(latlong_cache));
+}
+
+void
+latlong_register_state(void)
+{
+  agc_context_register(&latlong_cache, sizeof(latlong_cache));
+}
+
+/* ----------------------------------------------------------------
+ * Trigonometry
+ * ----------------------------------------------------------------
+ * Taylor series on |x| <= pi/4 after reduction by quarter turns (sine,
+ * cosine) or by the octant symmetries (arctangent); the last terms kept
+ * are below the 2^-40 LSB.
+ */
+
+/* Sine and cosine of an angle in revolutions, 0 <= rev < 1 */
+static void
+latlong_sincos(agc_fx_t rev, agc_fx_t* s, agc_fx_t* c)
+{
+  agc_fx_t x, x2, sn, cs;
+  int q;
+
+  q = (int)((rev + AGC_FX_ONE / 8) / (AGC_FX_ONE / 4));
+  x = agc_fx_mul(rev - q * (AGC_FX_ONE / 4), 2 * LATLONG_PI);
+  x2 = agc_fx_mul(x, x);
+
+  sn = AGC_FX_ONE - agc_fx_div(x2, AGC_FX_INT(156));
+  sn = AGC_FX_ONE - agc_fx_mul(agc_fx_div(x2, AGC_FX_INT(110)), sn);
+  sn = AGC_FX_ONE - agc_fx_mul(agc_fx_div(x2, AGC_FX_INT(72)), sn);
+  sn = AGC_FX_ONE - agc_fx_mul(agc_fx_div(x2, AGC_FX_INT(42)), sn);
+  sn = AGC_FX_ONE - agc_fx_mul(agc_fx_div(x2, AGC_FX_INT(20)), sn);
+  sn = AGC_FX_ONE - agc_fx_mul(agc_fx_div(x2, AGC_FX_INT(6)), sn);
+  sn = agc_fx_mul(x, sn);
+
+  cs = AGC_FX_ONE - agc_fx_div(x2, AGC_FX_INT(132));
+  cs = AGC_FX_ONE - agc_fx_mul(agc_fx_div(x2, AGC_FX_INT(90)), cs);
+  cs = AGC_FX_ONE - agc_fx_mul(agc_fx_div(x2, AGC_FX_INT(56)), cs);
+  cs = AGC_FX_ONE - agc_fx_mul(agc_fx_div(x2, AGC_FX_INT(30)), cs);
+  cs = AGC_FX_ONE - agc_fx_mul(agc_fx_div(x2, AGC_FX_INT(12)), cs);
+  cs = AGC_FX_ONE - agc_fx_mul(agc_fx_div(x2, AGC_FX_INT(2)), cs);
+
+  switch (q & 3) {
+    case 0:
+      *s = sn;
+      *c = cs;
+      break;
+    case 1:
+      *s = cs;
+      *c = -sn;
+      break;
+    case 2:
+      *s = -sn;
+      *c = -cs;
+      break;
+    default:
+      *s = -cs;
+      *c = sn;
+      break;
+  }
+}
+
+/* atan(u) for |u| <= tan(pi/8) */
+static agc_fx_t
+latlong_atan_series(agc_fx_t u)
+{
+  agc_fx_t u2, p;
+  int k;
+
+  u2 = agc_fx_mul(u, u);
+  p = 0;
+  for (k = LATLONG_ATAN_TERMS - 1; k >= 0; k--) {
+    p = agc_fx_div(k % 2 == 0 ? AGC_FX_ONE : -AGC_FX_ONE,
+                   AGC_FX_INT(2 * k + 1)) +
+        agc_fx_mul(u2, p);
+  }
+  return agc_fx_mul(u, p);
+}
+
+/* atan2(y, x) in degrees, -180..180 */
+static agc_fx_t
+latlong_atan2_deg(agc_fx_t y, agc_fx_t x)
+{
+  agc_fx_t ax, ay, t, a;
+  int swap;
+
+  ax = agc_fx_abs(x);
+  ay = agc_fx_abs(y);
+  if (ax == 0 && ay == 0) {
+    return 0;
+  }
+  swap = ay > ax;
+  t = swap ? agc_fx_div(ax, ay) : agc_fx_div(ay, ax);
+  if (t > LATLONG_TAN_PI_8) {
+    a = LATLONG_PI / 4 +
+        latlong_atan_series(agc_fx_div(t - AGC_FX_ONE, t + AGC_FX_ONE));
+  } else {
+    a = latlong_atan_series(t);
+  }
+  if (swap) {
+    a = LATLONG_PI / 2 - a;
+  }
+  if (x < 0) {
+    a = LATLONG_PI - a;
+  }
+  if (y < 0) {
+    a = -a;
+  }
+  return agc_fx_mul(a, LATLONG_DEG_PER_RAD);
+}
+
+/* ----------------------------------------------------------------
+ * LAT-LONG
+ * ----------------------------------------------------------------
+ * With the Earth-fixed position (x, y, z), rho = sqrt(x^2 + y^2) and
+ * the flattening f,
+ *   long = atan2(y, x)
+ *   lat  = atan2(z, (1 - f)^2 rho)
+ *   alt  = r - (1 - f sin^2 latc),  sin latc = z / r  (DU = a)
+ * The latitude is exact on the ellipsoid and off by under 0.005
+ * degree at orbital altitudes.
+ */
+
+int
+latlong_compute(const nav_fx_state_t* s, long t_cs, latlong_t* out)
+{
+  agc_fx_t theta, sn, cs, x, y, z, r2, rho;
+
+  r2 = agc_fx_vec_dot(s->r, s->r);
+  if (r2 == 0) {
+    return -1;
+  }
+
+  /* Greenwich hour angle, reduced to one turn */
+  theta = AGC_FX_CONST(LATLONG_AZO_REV) +
+          agc_fx_mul((agc_fx_t)t_cs * 256, LATLONG_REV_PER_CS_256);
+  theta %= AGC_FX_ONE;
+  if (theta < 0) {
+    theta += AGC_FX_ONE;
+  }
+  latlong_sincos(theta, &sn, &cs);
+
+  x = agc_fx_mul(cs, s->r[0]) + agc_fx_mul(sn, s->r[1]);
+  y = agc_fx_mul(cs, s->r[1]) - agc_fx_mul(sn, s->r[0]);
+  z = s->r[2];
+  rho = agc_fx_sqrt(agc_fx_mul(x, x) + agc_fx_mul(y, y));
+
+  out->lng_deg = latlong_atan2_deg(y, x);
+  out->lat_deg = latlong_atan2_deg(z, agc_fx_mul(LATLONG_ONE_MINUS_F_SQ, rho));
+  out->alt_km = agc_fx_mul(
+    agc_fx_sqrt(r2) - AGC_FX_ONE +
+      agc_fx_mul(AGC_FX_CONST(LATLONG_FLATTENING),
+                 agc_fx_div(agc_fx_mul(z, z), r2)),
+    AGC_FX_CONST(NAV_DU_KM));
+  return 0;
+}
+
+int
+latlong_csm(latlong_t* out)
+{
+  nav_fx_state_t s, now;
+  long t_cs;
+
+  t_cs = (long)agc_time2 * 16384L + (long)agc_time1;
+  if (!latlong_cache.valid || latlong_cache.t_cs != t_cs ||
+      memcmp(&latlong_cache.sv, &nav_csm_state, sizeof(nav_csm_state)) != 0) {
+    latlong_cache.valid = 1;
+    latlong_cache.t_cs = t_cs;
+    latlong_cache.sv = nav_csm_state;
+    nav_state_to_fx(&nav_csm_state, &s);
+    if (agc_fx_vec_dot(s.r, s.r) == 0 ||
+        nav_kepler_fx(
+          &s, nav_cs_to_tu(t_cs - (long)nav_csm_state.time), &now) < 0) {
+      latlong_cache.status = -1;
+    } else {
+      latlong_cache.status = latlong_compute(&now, t_cs, &latlong_cache.fix);
+    }
+  }
+  *out = latlong_cache.fix;
+  return latlong_cache.status;
+}
+
+static int
+latlong_round(agc_fx_t x)
+{
+  if (x < 0) {
+    return -(int)((-x + AGC_FX_ONE / 2) / AGC_FX_ONE);
+  }
+  return (int)((x + AGC_FX_ONE / 2) / AGC_FX_ONE);
+}
+
+void
+latlong_to_noun(const latlong_t* fix, int values[3])
+{
+  values[0] = latlong_round(fix->lat_deg * 100);
+  values[1] = latlong_round(fix->lng_deg * 100);
+  values[2] = latlong_round(agc_fx_mul(fix->alt_km, LATLONG_TENTH_NM_PER_KM));
+}
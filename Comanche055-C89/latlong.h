@@ -0,0 +1,59 @@
+/*
+ * latlong.h -- Latitude, longitude and altitude of the CSM (noun 43).
+ *
+ * The CSM state vector is carried along its conic from its time tag
+ * to the current time.  It is then rotated into the Earth-fixed frame
+ * and reduced to geodetic latitude, longitude east of Greenwich and
+ * altitude above the reference ellipsoid.  The Earth turns at the
+ * sidereal rate from its Greenwich hour angle at GET 0.  Everything,
+ * including the sines and arctangents, is done in 64-bit fixed point.
+ *
+ * The result is kept with the time and the state vector it came from.
+ * A V16 N43 monitor and the web observers all fetch the noun on the
+ * same tick, so only the first fetch computes it.
+ *
+ * Maps to LATITUDE_LONGITUDE_SUBROUTINES.agc.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifndef LATLONG_H
+#define LATLONG_H
+
+#include "agc_fixed.h"
+#include "navigation.h"
+
+/* Greenwich hour angle at GET 0 (EPHEM_EPOCH_JD), revolutions */
+#define LATLONG_AZO_REV 0.38114175817
+/* Sidereal turns per day */
+#define LATLONG_REV_PER_DAY (360.98564736629 / 360.0)
+#define LATLONG_FLATTENING (1.0 / 298.257223563)
+
+typedef struct
+{
+  agc_fx_t lat_deg; /* Geodetic, north positive */
+  agc_fx_t lng_deg; /* East positive, -180..180 */
+  agc_fx_t alt_km;  /* Above the ellipsoid */
+} latlong_t;
+
+void
+latlong_init(void);
+void
+latlong_register_state(void);
+
+/* Position of s, an inertial state at t_cs; returns -1 at the centre
+ * of the Earth */
+int
+latlong_compute(const nav_fx_state_t* s, long t_cs, latlong_t* out);
+
+/* The CSM now, computed at most once per tick and state vector;
+ * returns -1 if the state vector is empty or cannot be carried to the
+ * current time */
+int
+latlong_csm(latlong_t* out);
+
+/* Noun 43: latitude and longitude in 0.01 degree, altitude in 0.1 NM */
+void
+latlong_to_noun(const latlong_t* fix, int values[3]);
+
+#endif /* LATLONG_H */
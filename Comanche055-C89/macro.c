@@ -0,0 +1,404 @@
+/*
+ * macro.c -- Scripted DSKY keystrokes with display checks.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "dsky.h"
+#include "dsky_log.h"
+#include "macro.h"
+#include "waitlist.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MACRO_STEP_KEY 0
+#define MACRO_STEP_WAIT 1
+#define MACRO_STEP_CHECK 2
+
+#define MACRO_NAME_MAX 16
+#define MACRO_FILE_MAX 16384
+
+typedef struct
+{
+  int kind;
+  int arg;   /* Keycode, delay, or first check */
+  int count; /* Checks in a CHECK step */
+  int line;
+} macro_step_t;
+
+typedef struct
+{
+  int field; /* Index into dsky_log_fields */
+  int value;
+} macro_check_t;
+
+macro_status_t macro_status;
+int macro_interval_cs = MACRO_DEFAULT_INTERVAL_CS;
+int macro_exit_when_done = 0;
+
+static macro_step_t macro_steps[MACRO_MAX_STEPS];
+static int macro_step_count = 0;
+static macro_check_t macro_checks[MACRO_MAX_CHECKS];
+static int macro_check_count = 0;
+static int macro_pc = 0;
+
+/* ----------------------------------------------------------------
+ * Compiler
+ * ---------------------------------------------------------------- */
+
+static int
+macro_add_step(int kind, int arg, int count, int line)
+{
+  if (macro_step_count >= MACRO_MAX_STEPS) {
+    return -1;
+  }
+  macro_steps[macro_step_count].kind = kind;
+  macro_steps[macro_step_count].arg = arg;
+  macro_steps[macro_step_count].count = count;
+  macro_steps[macro_step_count].line = line;
+  macro_step_count++;
+  return 0;
+}
+
+static int
+macro_add_check(const char* field_name, int value)
+{
+  int i;
+  for (i = 0; i < DSKY_LOG_FIELD_COUNT; i++) {
+    if (strcmp(dsky_log_fields[i].name, field_name) == 0) {
+      break;
+    }
+  }
+  if (i == DSKY_LOG_FIELD_COUNT || macro_check_count >= MACRO_MAX_CHECKS) {
+    return -1;
+  }
+  macro_checks[macro_check_count].field = i;
+  macro_checks[macro_check_count].value = value;
+  macro_check_count++;
+  return 0;
+}
+
+static int
+macro_digit_value(int ch)
+{
+  if (ch == '_') {
+    return -1;
+  }
+  if (ch >= '0' && ch <= '9') {
+    return ch - '0';
+  }
+  return -2;
+}
+
+/* One NAME=VALUE pair of a check; returns -1 if it is malformed */
+static int
+macro_compile_pair(const char* name, const char* value)
+{
+  char field[MACRO_NAME_MAX + sizeof("_sign") + 3]; /* Name plus suffix */
+  int len, sign, d, i;
+
+  len = (int)strlen(value);
+  if (strcmp(name, "prog") == 0 || strcmp(name, "verb") == 0 ||
+      strcmp(name, "noun") == 0) {
+    if (len != 2) {
+      return -1;
+    }
+    for (i = 0; i < 2; i++) {
+      d = macro_digit_value(value[i]);
+      sprintf(field, "%s%d", name, i);
+      if (d < -1 || macro_add_check(field, d) != 0) {
+        return -1;
+      }
+    }
+    return 0;
+  }
+
+  if (name[0] == 'r' && name[1] >= '1' && name[1] <= '3' &&
+      name[2] == '\0') {
+    if (len != 6) {
+      return -1;
+    }
+    sign = value[0] == '+' ? 1 : value[0] == '-' ? -1 : 0;
+    sprintf(field, "%s_sign", name);
+    if ((sign == 0 && value[0] != '_') || macro_add_check(field, sign) != 0) {
+      return -1;
+    }
+    for (i = 0; i < 5; i++) {
+      d = macro_digit_value(value[i + 1]);
+      sprintf(field, "%s_%d", name, i);
+      if (d < -1 || macro_add_check(field, d) != 0) {
+        return -1;
+      }
+    }
+    return 0;
+  }
+
+  d = macro_digit_value(value[0]);
+  if (len != 1 || d < -1) {
+    return -1;
+  }
+  return macro_add_check(name, d);
+}
+
+/* Compiles "{...}" at *pp into one CHECK step */
+static int
+macro_compile_check(const char** pp, int* line, char* err)
+{
+  char name[MACRO_NAME_MAX];
+  char value[MACRO_NAME_MAX];
+  const char* p;
+  int first, start_line, n;
+
+  p = *pp + 1;
+  start_line = *line;
+  first = macro_check_count;
+  while (1) {
+    while (*p != '\0' && *p != '}' && isspace((unsigned char)*p)) {
+      if (*p == '\n') {
+        (*line)++;
+      }
+      p++;
+    }
+    if (*p == '}') {
+      break;
+    }
+    if (*p == '\0') {
+      sprintf(err, "line %d: '{' without '}'", start_line);
+      return -1;
+    }
+
+    n = 0;
+    while (*p != '\0' && *p != '=' && *p != '}' &&
+           !isspace((unsigned char)*p) && n < MACRO_NAME_MAX - 1) {
+      name[n++] = (char)tolower((unsigned char)*p++);
+    }
+    name[n] = '\0';
+    if (*p != '=') {
+      sprintf(err, "line %d: check needs NAME=VALUE", *line);
+      return -1;
+    }
+    p++;
+    n = 0;
+    while (*p != '\0' && *p != '}' && !isspace((unsigned char)*p) &&
+           n < MACRO_NAME_MAX - 1) {
+      value[n++] = *p++;
+    }
+    value[n] = '\0';
+
+    if (macro_compile_pair(name, value) != 0) {
+      sprintf(err, "line %d: bad check on %.16s", *line, name);
+      return -1;
+    }
+  }
+
+  *pp = p + 1;
+  if (macro_check_count == first) {
+    return 0;
+  }
+  if (macro_add_step(
+        MACRO_STEP_CHECK, first, macro_check_count - first, start_line) !=
+      0) {
+    sprintf(err, "line %d: script too long", start_line);
+    return -1;
+  }
+  return 0;
+}
+
+int
+macro_load(const char* text, char* err, int err_cap)
+{
+  const char* p;
+  int line, keycode, delay, digits;
+  char local_err[MACRO_MESSAGE_MAX];
+
+  macro_stop();
+  macro_step_count = 0;
+  macro_check_count = 0;
+  memset(&macro_status, 0, sizeof(macro_status));
+
+  p = text;
+  line = 1;
+  local_err[0] = '\0';
+  while (*p != '\0') {
+    if (*p == '\n') {
+      line++;
+      p++;
+    } else if (isspace((unsigned char)*p)) {
+      p++;
+    } else if (*p == '#') {
+      while (*p != '\0' && *p != '\n') {
+        p++;
+      }
+    } else if (*p == '{') {
+      if (macro_compile_check(&p, &line, local_err) != 0) {
+        break;
+      }
+    } else if (*p == 'W' || *p == 'w') {
+      p++;
+      delay = 0;
+      digits = 0;
+      while (*p >= '0' && *p <= '9' && delay < 100000) {
+        delay = delay * 10 + (*p++ - '0');
+        digits++;
+      }
+      if (digits == 0 || delay > 16383) {
+        sprintf(local_err, "line %d: W takes 1-16383 centiseconds", line);
+        break;
+      }
+      if (macro_add_step(MACRO_STEP_WAIT, delay, 0, line) != 0) {
+        sprintf(local_err, "line %d: script too long", line);
+        break;
+      }
+    } else {
+      keycode = dsky_keycode_for_char(*p);
+      if (keycode == DSKY_KEY_NONE) {
+        sprintf(local_err, "line %d: not a DSKY key", line);
+        break;
+      }
+      if (macro_add_step(MACRO_STEP_KEY, keycode, 0, line) != 0) {
+        sprintf(local_err, "line %d: script too long", line);
+        break;
+      }
+      p++;
+    }
+  }
+
+  if (local_err[0] != '\0') {
+    macro_step_count = 0;
+    macro_check_count = 0;
+    if (err != NULL && err_cap > 0) {
+      strncpy(err, local_err, (size_t)err_cap - 1);
+      err[err_cap - 1] = '\0';
+    }
+    return -1;
+  }
+  macro_status.loaded = 1;
+  macro_status.steps = macro_step_count;
+  return 0;
+}
+
+int
+macro_load_file(const char* path, char* err, int err_cap)
+{
+  static char text[MACRO_FILE_MAX + 1];
+  FILE* f;
+  size_t len;
+
+  f = fopen(path, "rb");
+  if (f == NULL) {
+    if (err != NULL && err_cap > 0) {
+      strncpy(err, "cannot open script", (size_t)err_cap - 1);
+      err[err_cap - 1] = '\0';
+    }
+    return -1;
+  }
+  len = fread(text, 1, MACRO_FILE_MAX, f);
+  fclose(f);
+  text[len] = '\0';
+  return macro_load(text, err, err_cap);
+}
+
+/* ----------------------------------------------------------------
+ * Player
+ * ---------------------------------------------------------------- */
+
+static void
+macro_run_check(const macro_step_t* step)
+{
+  const macro_check_t* check;
+  int i, actual;
+
+  for (i = 0; i < step->count; i++) {
+    check = &macro_checks[step->arg + i];
+    actual = *(const int*)((const char*)&dsky_display +
+                           dsky_log_fields[check->field].offset);
+    if (actual != check->value) {
+      if (macro_status.checks_failed == 0) {
+        sprintf(macro_status.failure,
+                "line %d: %s is %d, expected %d",
+                step->line,
+                dsky_log_fields[check->field].name,
+                actual,
+                check->value);
+      }
+      macro_status.checks_failed++;
+      return;
+    }
+  }
+  macro_status.checks_passed++;
+}
+
+static void
+macro_task(void)
+{
+  const macro_step_t* step;
+
+  while (macro_pc < macro_step_count) {
+    step = &macro_steps[macro_pc++];
+    macro_status.step = macro_pc;
+    switch (step->kind) {
+      case MACRO_STEP_KEY:
+        dsky_submit_key(step->arg);
+        if (macro_interval_cs > 0) {
+          waitlist_add(macro_interval_cs, macro_task);
+          return;
+        }
+        break;
+      case MACRO_STEP_WAIT:
+        waitlist_add(step->arg, macro_task);
+        return;
+      case MACRO_STEP_CHECK:
+        macro_run_check(step);
+        break;
+    }
+  }
+  macro_status.running = 0;
+  macro_status.finished = 1;
+}
+
+void
+macro_play(void)
+{
+  if (!macro_status.loaded) {
+    return;
+  }
+  macro_stop();
+  macro_pc = 0;
+  macro_status.step = 0;
+  macro_status.checks_passed = 0;
+  macro_status.checks_failed = 0;
+  macro_status.failure[0] = '\0';
+  macro_status.finished = 0;
+  macro_status.running = 1;
+  waitlist_add(1, macro_task);
+}
+
+void
+macro_stop(void)
+{
+  waitlist_cancel(macro_task);
+  macro_status.running = 0;
+}
+
+int
+macro_report(void)
+{
+  if (!macro_status.loaded) {
+    return 0;
+  }
+  printf("Macro: %d/%d steps, %d checks passed, %d failed\n",
+         macro_status.step,
+         macro_status.steps,
+         macro_status.checks_passed,
+         macro_status.checks_failed);
+  if (macro_status.checks_failed > 0) {
+    printf("First failure: %s\n", macro_status.failure);
+  }
+  return (macro_status.checks_failed > 0 || !macro_status.finished) ? 1 : 0;
+}
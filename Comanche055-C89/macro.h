@@ -0,0 +1,68 @@
+/*
+ * macro.h -- Scripted DSKY keystrokes with display checks.
+ *
+ * A script is compiled into steps and played by a waitlist task that
+ * feeds dsky_submit_key().  Script syntax (case-insensitive, tokens
+ * separated by white space):
+ *
+ *   V37E 00E       keys as typed on the keyboard: V N E 0-9 + - C R
+ *                  P K; a token may hold any number of them
+ *   W150           wait 150 centiseconds
+ *   {VERB=16 NOUN=36 R1=+00012 OPR_ERR=0}
+ *                  check the display: PROG, VERB, NOUN (2 digits),
+ *                  R1-R3 (sign and 5 digits) or a light by its
+ *                  dsky_log field name (0/1); '_' is a blank digit
+ *                  or sign
+ *   # ...          comment to end of line
+ *
+ * One script plays at a time.  It runs in the AGC context that was
+ * live when it started.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifndef MACRO_H
+#define MACRO_H
+
+#define MACRO_MAX_STEPS 512
+#define MACRO_MAX_CHECKS 512
+#define MACRO_DEFAULT_INTERVAL_CS 10
+#define MACRO_MESSAGE_MAX 96
+
+typedef struct
+{
+  int loaded;
+  int running;
+  int finished;
+  int step;  /* Steps executed */
+  int steps; /* Steps in the script */
+  int checks_passed;
+  int checks_failed;
+  char failure[MACRO_MESSAGE_MAX]; /* First failed check */
+} macro_status_t;
+
+extern macro_status_t macro_status;
+
+/* Delay after each key in centiseconds; 0 feeds keys back to back */
+extern int macro_interval_cs;
+/* Leave the main loop once the script has finished (--macro-exit) */
+extern int macro_exit_when_done;
+
+/* Compiles a script, stopping and replacing the loaded one.  Returns
+ * 0, or -1 with a message in err. */
+int
+macro_load(const char* text, char* err, int err_cap);
+int
+macro_load_file(const char* path, char* err, int err_cap);
+
+/* Starts the loaded script from the top; no-op if none is loaded */
+void
+macro_play(void);
+void
+macro_stop(void);
+
+/* Prints the outcome of a played script; returns the exit status */
+int
+macro_report(void);
+
+#endif /* MACRO_H */
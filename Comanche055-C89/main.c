@@ -7,11 +7,13 @@
  * Comanche055 (Apollo 11 CM) ANSI C89 port.
  */
 
+#include "agc_context.h"
 #include "agc_cpu.h"
 #include "args.h"
 #include "dsky_backend.h"
 #include "executive.h"
 #include "hal.h"
+#include "macro.h"
 #include "menu.h"
 #include "navigation.h"
 #include "service.h"
@@ -29,6 +31,7 @@ main(int argc, char* argv[])
   dsky_backend_t* backend;
   long last_time;
   int accumulated_ms;
+  int ctx;
 
   backend = args_parse_backend(argc, argv);
   if (!backend) {
@@ -42,24 +45,33 @@ main(int argc, char* argv[])
   fresh_start();
 
   backend->init();
+  macro_play();
 
   last_time = hal_time_ms();
   accumulated_ms = 0;
 
   /* Main loop: 100 Hz (10ms per tick) */
-  while (1) {
+  while (!(macro_exit_when_done && macro_status.finished)) {
     long current_time = hal_time_ms();
     int elapsed = (int)(current_time - last_time);
     last_time = current_time;
 
     accumulated_ms += elapsed;
     if (accumulated_ms > 500) {
+      timer_ticks_skipped += (unsigned long)((accumulated_ms - 500) / 10);
       accumulated_ms = 500;
     }
 
     while (accumulated_ms >= 10) {
-      timer_tick();
-      exec_run();
+      timer_tick_count++;
+      timer_note_lateness(accumulated_ms - 10);
+      /* Every AGC instance (see agc_context.h) advances on this tick */
+      for (ctx = 0; ctx < agc_context_count(); ctx++) {
+        agc_context_switch(ctx);
+        timer_tick();
+        exec_run();
+      }
+      agc_context_switch(0);
       accumulated_ms -= 10;
     }
 
@@ -72,5 +84,5 @@ main(int argc, char* argv[])
   }
 
   backend->cleanup();
-  return 0;
+  return macro_report();
 }
@@ -0,0 +1,195 @@
+/*
+ * monitor.c -- Shared noun monitors.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#include "agc.h"
+#include "agc_context.h"
+#include "agc_cpu.h"
+#include "monitor.h"
+#include "service.h"
+#include "waitlist.h"
+
+#include <string.h>
+
+#define MONITOR_PERIOD_MAX 16383 /* Longest single waitlist delay */
+
+/* ----------------------------------------------------------------
+ * State
+ * ---------------------------------------------------------------- */
+
+monitor_t monitor_table[MONITOR_MAX];
+unsigned long monitor_refresh_count = 0;
+
+static void
+monitor_task(void);
+
+void
+monitor_init(void)
+{
+  memset(monitor_table, 0, sizeof(monitor_table));
+  waitlist_cancel(monitor_task);
+}
+
+void
+monitor_register_state(void)
+{
+  agc_context_register(monitor_table, sizeof(monitor_table));
+}
+
+/* ----------------------------------------------------------------
+ * Scheduling
+ * ---------------------------------------------------------------- */
+
+static long
+monitor_now(void)
+{
+  return (long)agc_time2 * 16384L + (long)agc_time1;
+}
+
+/* Points the one waitlist task at the earliest due monitor */
+static void
+monitor_arm(void)
+{
+  long now, next;
+  int i, found;
+
+  waitlist_cancel(monitor_task);
+
+  found = 0;
+  next = 0;
+  for (i = 0; i < MONITOR_MAX; i++) {
+    if (monitor_table[i].active &&
+        (!found || monitor_table[i].due_cs < next)) {
+      next = monitor_table[i].due_cs;
+      found = 1;
+    }
+  }
+  if (!found) {
+    return;
+  }
+
+  now = monitor_now();
+  waitlist_add(next > now ? (int)(next - now) : 1, monitor_task);
+}
+
+static void
+monitor_task(void)
+{
+  const noun_table_entry_t* entries[MONITOR_MAX];
+  int fetched[MONITOR_MAX]; /* Slot whose values this pass fetched */
+  int fetch_count;
+  monitor_t* m;
+  long now;
+  int i, j;
+
+  now = monitor_now();
+  fetch_count = 0;
+  for (i = 0; i < MONITOR_MAX; i++) {
+    m = &monitor_table[i];
+    if (!m->active || m->due_cs > now) {
+      continue;
+    }
+
+    for (j = 0; j < fetch_count; j++) {
+      if (monitor_table[fetched[j]].noun == m->noun) {
+        break;
+      }
+    }
+    if (j < fetch_count) {
+      memcpy(m->values, monitor_table[fetched[j]].values, sizeof(m->values));
+    } else {
+      entries[fetch_count] = noun_fetch(m->noun, m->values);
+      fetched[fetch_count++] = i;
+    }
+
+    m->due_cs += m->period_cs;
+    if (m->due_cs <= now) {
+      m->due_cs = now + m->period_cs;
+    }
+    monitor_refresh_count++;
+    if (m->sink != NULL) {
+      m->sink(i, entries[j], m->values);
+    }
+  }
+
+  monitor_arm();
+}
+
+/* ----------------------------------------------------------------
+ * API
+ * ---------------------------------------------------------------- */
+
+int
+monitor_start(int noun, int period_cs, monitor_sink_t sink)
+{
+  monitor_t* m;
+  int i;
+
+  if (noun_lookup(noun) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < MONITOR_MAX; i++) {
+    if (!monitor_table[i].active) {
+      break;
+    }
+  }
+  if (i == MONITOR_MAX) {
+    return -1;
+  }
+
+  if (period_cs < 1) {
+    period_cs = 1;
+  }
+  if (period_cs > MONITOR_PERIOD_MAX) {
+    period_cs = MONITOR_PERIOD_MAX;
+  }
+
+  m = &monitor_table[i];
+  m->active = 1;
+  m->noun = noun;
+  m->period_cs = period_cs;
+  m->due_cs = monitor_now() + period_cs;
+  m->sink = sink;
+  noun_fetch(noun, m->values);
+  monitor_refresh_count++;
+  monitor_arm();
+  return i;
+}
+
+void
+monitor_stop(int slot)
+{
+  if (slot < 0 || slot >= MONITOR_MAX || !monitor_table[slot].active) {
+    return;
+  }
+  monitor_table[slot].active = 0;
+  monitor_arm();
+}
+
+int
+monitor_find(int noun, monitor_sink_t sink)
+{
+  int i;
+  for (i = 0; i < MONITOR_MAX; i++) {
+    if (monitor_table[i].active && monitor_table[i].noun == noun &&
+        monitor_table[i].sink == sink) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int
+monitor_active_count(void)
+{
+  int i, count;
+  count = 0;
+  for (i = 0; i < MONITOR_MAX; i++) {
+    if (monitor_table[i].active) {
+      count++;
+    }
+  }
+  return count;
+}
@@ -0,0 +1,56 @@
+/*
+ * monitor.h -- Shared noun monitors (MONREQ, extended).
+ *
+ * A monitor refreshes one noun at a fixed period and hands the
+ * values to its consumer: the DSKY for V16, web observers, and so
+ * on.  All monitors are serviced by a single waitlist task armed for
+ * the next one due, so they hold one waitlist slot however many are
+ * running.  Monitors due together share one fetch per noun.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include "service.h"
+
+#define MONITOR_MAX 8
+
+/* Called with fresh values on every refresh of the monitor in slot */
+typedef void (*monitor_sink_t)(int slot,
+                               const noun_table_entry_t* entry,
+                               const int values[NOUN_MAX_COMPONENTS]);
+
+typedef struct
+{
+  int active;
+  int noun;
+  int period_cs;
+  long due_cs; /* Mission time of the next refresh */
+  monitor_sink_t sink;
+  int values[NOUN_MAX_COMPONENTS]; /* From the latest refresh */
+} monitor_t;
+
+extern monitor_t monitor_table[MONITOR_MAX];
+extern unsigned long monitor_refresh_count;
+
+void
+monitor_init(void);
+void
+monitor_register_state(void);
+
+/* Starts a monitor; its first values are in monitor_table[slot] on
+ * return, and sink is called from the next refresh on.  Returns the
+ * slot, or -1 for an undefined noun or a full table. */
+int
+monitor_start(int noun, int period_cs, monitor_sink_t sink);
+void
+monitor_stop(int slot);
+/* Slot of the active monitor of noun feeding sink, or -1 */
+int
+monitor_find(int noun, monitor_sink_t sink);
+int
+monitor_active_count(void);
+
+#endif /* MONITOR_H */
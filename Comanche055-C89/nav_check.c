@@ -0,0 +1,623 @@
+/*
+ * nav_check.c -- Checks and benchmarks of the navigation routines.
+ *
+ * Compares the 64-bit fixed-point routines against double precision
+ * references over random inputs and exits non-zero if any result is
+ * outside its tolerance:
+ *
+ *   kepler   nav_kepler_fx() on random closed and open conics and
+ *            times, against a double universal-variable solve:
+ *            position within NC_KEPLER_TOL_M
+ *   encke    integ_encke() from the nominal CSM state over
+ *            NC_ARC_CS, against the double Cowell reference
+ *            (integ_cowell) under the same forces: position within
+ *            NC_ENCKE_TOL_M
+ *   orbit    nav_compute_orbit() on random DP state vectors inside
+ *            the input limits, closed and open, against the same
+ *            formulas in double: the same open/closed verdict, HA
+ *            and HP within NC_ORBIT_TOL_KM, period within
+ *            NC_ORBIT_TOL_SEC (each plus NC_ORBIT_TOL_REL of the
+ *            value)
+ *
+ * With --bench it then times propagation over the same arc (one
+ * nav_kepler() call, the Encke steps of the background job, and the
+ * Cowell reference) and the orbit computation against its double
+ * precision counterpart.
+ *
+ *   nav_check [--samples N] [--seed S] [--bench]
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "agc.h"
+#include "agc_fixed.h"
+#include "agc_math.h"
+#include "integration.h"
+#include "navigation.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NC_DEFAULT_SAMPLES 20000UL
+#define NC_KEPLER_TOL_M 0.05
+#define NC_ENCKE_TOL_M 25.0
+#define NC_ARC_CS 2160000L /* 6 hours */
+#define NC_ORBIT_TOL_KM 1.0
+#define NC_ORBIT_TOL_SEC 1.0
+#define NC_ORBIT_TOL_REL 1e-6
+#define NC_ORBIT_MAX_A 4096.0  /* DU; larger conics count as open */
+#define NC_ORBIT_EDGE 1e-9     /* Skipped: alpha this close to open */
+#define NC_BENCH_SEC 0.5
+#define NC_BENCH_ORBITS 4096
+
+#define NC_U64(hi, lo)                                                         \
+  (((agc_uint64_t)(hi) << 32) | (agc_uint64_t)(unsigned long)(lo))
+
+/* ----------------------------------------------------------------
+ * Random numbers
+ * ---------------------------------------------------------------- */
+
+/* SplitMix64 */
+static agc_uint64_t
+nc_next(agc_uint64_t* state)
+{
+  agc_uint64_t z;
+
+  *state += NC_U64(0x9E3779B9UL, 0x7F4A7C15UL);
+  z = *state;
+  z = (z ^ (z >> 30)) * NC_U64(0xBF58476DUL, 0x1CE4E5B9UL);
+  z = (z ^ (z >> 27)) * NC_U64(0x94D049BBUL, 0x133111EBUL);
+  return z ^ (z >> 31);
+}
+
+/* Uniform on [lo, hi) */
+static double
+nc_uniform(agc_uint64_t* state, double lo, double hi)
+{
+  return lo + (hi - lo) * ((double)(nc_next(state) >> 11) /
+                           9007199254740992.0);
+}
+
+/* Uniform on the unit sphere */
+static void
+nc_direction(agc_uint64_t* state, double u[3])
+{
+  double z, phi, s;
+
+  z = nc_uniform(state, -1.0, 1.0);
+  phi = nc_uniform(state, 0.0, 6.283185307179586);
+  s = sqrt(1.0 - z * z);
+  u[0] = s * cos(phi);
+  u[1] = s * sin(phi);
+  u[2] = z;
+}
+
+/* A random conic through radius r_lo..r_hi DU, with speed u_lo..u_hi
+ * times the local escape speed */
+static void
+nc_random_state(agc_uint64_t* state,
+                double r_lo,
+                double r_hi,
+                double u_lo,
+                double u_hi,
+                double r[3],
+                double v[3])
+{
+  double rm, vm, ur[3], uv[3];
+  int i;
+
+  rm = nc_uniform(state, r_lo, r_hi);
+  vm = sqrt(2.0 / rm) * nc_uniform(state, u_lo, u_hi);
+  nc_direction(state, ur);
+  nc_direction(state, uv);
+  for (i = 0; i < 3; i++) {
+    r[i] = rm * ur[i];
+    v[i] = vm * uv[i];
+  }
+}
+
+static double
+nc_seconds(clock_t start)
+{
+  return (double)(clock() - start) / (double)CLOCKS_PER_SEC;
+}
+
+/* ----------------------------------------------------------------
+ * Double precision conic (universal variables, mu = 1)
+ * ---------------------------------------------------------------- */
+
+static void
+nc_stumpff(double z, double* c, double* s)
+{
+  double sz;
+
+  if (z > 1e-6) {
+    sz = sqrt(z);
+    *c = (1.0 - cos(sz)) / z;
+    *s = (sz - sin(sz)) / (z * sz);
+  } else if (z < -1e-6) {
+    sz = sqrt(-z);
+    *c = (cosh(sz) - 1.0) / -z;
+    *s = (sinh(sz) - sz) / (-z * sz);
+  } else {
+    *c = 0.5 - z / 24.0 + z * z / 720.0;
+    *s = 1.0 / 6.0 - z / 120.0 + z * z / 5040.0;
+  }
+}
+
+/* Time from r0, v0 at universal anomaly x; also the radius there */
+static double
+nc_kepler_time(double r0,
+               double sigma0,
+               double alpha,
+               double x,
+               double* r)
+{
+  double z, c, s;
+
+  z = alpha * x * x;
+  nc_stumpff(z, &c, &s);
+  *r = x * x * c + sigma0 * x * (1.0 - z * s) + r0 * (1.0 - z * c);
+  return x * x * x * s + sigma0 * x * x * c + r0 * x * (1.0 - z * s);
+}
+
+/* The state dt after r0, v0.  t(x) increases with x (dt/dx = r), so
+ * the root is bracketed and then narrowed by Newton steps kept inside
+ * the bracket. */
+static void
+nc_kepler_double(const double r0v[3],
+                 const double v0[3],
+                 double dt,
+                 double r[3],
+                 double v[3])
+{
+  double r0, sigma0, alpha, lo, hi, x, t, rx, z, c, s, f, g, fd, gd;
+  int i;
+
+  r0 = sqrt(r0v[0] * r0v[0] + r0v[1] * r0v[1] + r0v[2] * r0v[2]);
+  sigma0 = r0v[0] * v0[0] + r0v[1] * v0[1] + r0v[2] * v0[2];
+  alpha = 2.0 / r0 - (v0[0] * v0[0] + v0[1] * v0[1] + v0[2] * v0[2]);
+
+  lo = 0.0;
+  hi = 0.0;
+  x = dt >= 0.0 ? 1.0 : -1.0;
+  while (dt >= 0.0 ? nc_kepler_time(r0, sigma0, alpha, x, &rx) < dt
+                   : nc_kepler_time(r0, sigma0, alpha, x, &rx) > dt) {
+    x *= 2.0;
+  }
+  if (dt >= 0.0) {
+    hi = x;
+  } else {
+    lo = x;
+  }
+
+  x = 0.5 * (lo + hi);
+  for (i = 0; i < 200; i++) {
+    t = nc_kepler_time(r0, sigma0, alpha, x, &rx);
+    if (t < dt) {
+      lo = x;
+    } else {
+      hi = x;
+    }
+    x += (dt - t) / rx;
+    if (x <= lo || x >= hi) {
+      x = 0.5 * (lo + hi);
+    }
+    if (hi - lo < 1e-15 * (fabs(x) + 1.0)) {
+      break;
+    }
+  }
+
+  t = nc_kepler_time(r0, sigma0, alpha, x, &rx);
+  z = alpha * x * x;
+  nc_stumpff(z, &c, &s);
+  f = 1.0 - x * x * c / r0;
+  g = t - x * x * x * s;
+  fd = x * (z * s - 1.0) / (rx * r0);
+  gd = 1.0 - x * x * c / rx;
+  for (i = 0; i < 3; i++) {
+    r[i] = f * r0v[i] + g * v0[i];
+    v[i] = fd * r0v[i] + gd * v0[i];
+  }
+}
+
+static double
+nc_error_m(const nav_fx_state_t* fx, const double r[3])
+{
+  double d, sum;
+  int i;
+
+  sum = 0.0;
+  for (i = 0; i < 3; i++) {
+    d = agc_fx_to_double(fx->r[i]) - r[i];
+    sum += d * d;
+  }
+  return sqrt(sum) * NAV_DU_KM * 1000.0;
+}
+
+/* ----------------------------------------------------------------
+ * Double precision orbit
+ * ---------------------------------------------------------------- */
+
+typedef struct
+{
+  int open;
+  double apogee_km;
+  double perigee_km;
+  double period_sec;
+  double alpha; /* 1/a in 1/DU */
+} nc_orbit_t;
+
+/* A DP state vector from DU and DU/TU, rounded to the word scales */
+static void
+nc_state_from_double(const double r[3],
+                     const double v[3],
+                     agc_state_vector_t* sv)
+{
+  int i;
+
+  memset(sv, 0, sizeof(*sv));
+  for (i = 0; i < 3; i++) {
+    agc_dp_unpack((agc_dp_t)floor(r[i] * NAV_DU_KM * 16384.0 + 0.5),
+                  &sv->r[2 * i],
+                  &sv->r[2 * i + 1]);
+    agc_dp_unpack(
+      (agc_dp_t)floor(v[i] * NAV_DU_KM / NAV_TU_SEC * 256.0 + 0.5),
+      &sv->v[2 * i],
+      &sv->v[2 * i + 1]);
+  }
+}
+
+/* The orbit of the DP words themselves, as nav_compute_orbit sees
+ * them */
+static void
+nc_orbit_double(const agc_state_vector_t* sv, nc_orbit_t* o)
+{
+  double r[3], v[3], h[3], rm, p, e2, e, rp, a;
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    r[i] = (double)agc_dp_pack(sv->r[2 * i], sv->r[2 * i + 1]) /
+           (16384.0 * NAV_DU_KM);
+    v[i] = (double)agc_dp_pack(sv->v[2 * i], sv->v[2 * i + 1]) /
+           (256.0 * NAV_DU_KM / NAV_TU_SEC);
+  }
+  rm = sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+  o->alpha = 2.0 / rm - (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  h[0] = r[1] * v[2] - r[2] * v[1];
+  h[1] = r[2] * v[0] - r[0] * v[2];
+  h[2] = r[0] * v[1] - r[1] * v[0];
+  p = h[0] * h[0] + h[1] * h[1] + h[2] * h[2];
+  e2 = 1.0 - o->alpha * p;
+  e = e2 > 0.0 ? sqrt(e2) : 0.0;
+  rp = p / (1.0 + e);
+  o->perigee_km = (rp - 1.0) * NAV_DU_KM;
+  o->open = o->alpha <= 0.0 || o->alpha * NC_ORBIT_MAX_A < 1.0;
+  if (o->open) {
+    o->apogee_km = 0.0;
+    o->period_sec = 0.0;
+    return;
+  }
+  a = 1.0 / o->alpha;
+  o->apogee_km = (2.0 * a - rp - 1.0) * NAV_DU_KM;
+  o->period_sec = 6.283185307179586 * a * sqrt(a) * NAV_TU_SEC;
+}
+
+static int
+nc_within(double got, double want, double tol)
+{
+  return fabs(got - want) <= tol + NC_ORBIT_TOL_REL * fabs(want);
+}
+
+/* A random state vector for the orbit checks: radius 1.02-2.5 DU,
+ * which keeps every component inside NAV_MAX_RADIUS_KM, and speeds
+ * from suborbital to hyperbolic */
+static void
+nc_random_sv(agc_uint64_t* state, agc_state_vector_t* sv)
+{
+  double r[3], v[3];
+
+  nc_random_state(state, 1.02, 2.5, 0.3, 1.3, r, v);
+  nc_state_from_double(r, v, sv);
+}
+
+/* ----------------------------------------------------------------
+ * Checks
+ * ---------------------------------------------------------------- */
+
+static int
+nc_check_kepler(unsigned long samples, unsigned long seed)
+{
+  agc_uint64_t state;
+  nav_fx_state_t s0, s1;
+  double r0[3], v0[3], r1[3], v1[3], dt, err, worst;
+  unsigned long n, bad, failed;
+  int i;
+
+  state = NC_U64(seed, 0x4B45504CUL);
+  worst = 0.0;
+  bad = 0;
+  failed = 0;
+  for (n = 0; n < samples; n++) {
+    nc_random_state(&state, 1.02, 2.5, 0.6, 1.3, r0, v0);
+    dt = nc_uniform(&state, -20.0, 20.0);
+    for (i = 0; i < 3; i++) {
+      s0.r[i] = agc_fx_from_double(r0[i]);
+      s0.v[i] = agc_fx_from_double(v0[i]);
+      r0[i] = agc_fx_to_double(s0.r[i]);
+      v0[i] = agc_fx_to_double(s0.v[i]);
+    }
+    if (nav_kepler_fx(&s0, agc_fx_from_double(dt), &s1) < 0) {
+      failed++;
+      continue;
+    }
+    dt = agc_fx_to_double(agc_fx_from_double(dt));
+    nc_kepler_double(r0, v0, dt, r1, v1);
+    err = nc_error_m(&s1, r1);
+    if (err > worst) {
+      worst = err;
+    }
+    if (err > NC_KEPLER_TOL_M) {
+      bad++;
+    }
+  }
+  printf("kepler  %lu conics, worst %.6f m, %lu over %.3f m, %lu unsolved\n",
+         samples,
+         worst,
+         bad,
+         NC_KEPLER_TOL_M,
+         failed);
+  return bad == 0 && failed == 0 ? 0 : 1;
+}
+
+static int
+nc_check_encke(void)
+{
+  nav_fx_state_t encke;
+  double r[3], v[3], err;
+  long steps;
+
+  steps = integ_encke(&nav_csm_state, NC_ARC_CS, &encke);
+  integ_cowell(&nav_csm_state, NC_ARC_CS, r, v);
+  err = nc_error_m(&encke, r);
+  printf("encke   %ld steps over %ld s, %.3f m from Cowell (limit %.0f m)\n",
+         steps,
+         NC_ARC_CS / 100,
+         err,
+         NC_ENCKE_TOL_M);
+  return err <= NC_ENCKE_TOL_M ? 0 : 1;
+}
+
+static int
+nc_check_orbit(unsigned long samples, unsigned long seed)
+{
+  agc_uint64_t state;
+  agc_state_vector_t sv;
+  nc_orbit_t want;
+  long apogee, perigee, period;
+  double worst_km, worst_sec, d;
+  unsigned long n, bad, open, skipped;
+  int is_open;
+
+  state = NC_U64(seed, 0x4F524249UL);
+  worst_km = 0.0;
+  worst_sec = 0.0;
+  bad = 0;
+  open = 0;
+  skipped = 0;
+  for (n = 0; n < samples; n++) {
+    nc_random_sv(&state, &sv);
+    nc_orbit_double(&sv, &want);
+    if (fabs(want.alpha) < NC_ORBIT_EDGE ||
+        fabs(want.alpha * NC_ORBIT_MAX_A - 1.0) < NC_ORBIT_EDGE) {
+      skipped++;
+      continue;
+    }
+    is_open = nav_compute_orbit(&sv, &apogee, &perigee, &period);
+    open += (unsigned long)is_open;
+    if (is_open != want.open ||
+        !nc_within((double)perigee, want.perigee_km, NC_ORBIT_TOL_KM) ||
+        !nc_within((double)apogee, want.apogee_km, NC_ORBIT_TOL_KM) ||
+        !nc_within((double)period, want.period_sec, NC_ORBIT_TOL_SEC)) {
+      if (bad == 0) {
+        printf("orbit   sample %lu: HA %ld HP %ld T %ld open %d, "
+               "expected %.1f %.1f %.1f open %d\n",
+               n,
+               apogee,
+               perigee,
+               period,
+               is_open,
+               want.apogee_km,
+               want.perigee_km,
+               want.period_sec,
+               want.open);
+      }
+      bad++;
+      continue;
+    }
+    d = fabs((double)perigee - want.perigee_km);
+    if (fabs((double)apogee - want.apogee_km) > d) {
+      d = fabs((double)apogee - want.apogee_km);
+    }
+    if (d > worst_km) {
+      worst_km = d;
+    }
+    d = fabs((double)period - want.period_sec);
+    if (d > worst_sec) {
+      worst_sec = d;
+    }
+  }
+  printf("orbit   %lu states (%lu open, %lu at the edge skipped), "
+         "worst %.3f km %.3f s, %lu out of tolerance\n",
+         samples,
+         open,
+         skipped,
+         worst_km,
+         worst_sec,
+         bad);
+  return bad == 0 ? 0 : 1;
+}
+
+/* ----------------------------------------------------------------
+ * Benchmarks
+ * ---------------------------------------------------------------- */
+
+static void
+nc_bench_propagation(void)
+{
+  agc_state_vector_t out;
+  nav_fx_state_t encke, conic;
+  double r[3], v[3];
+  unsigned long n;
+  long steps;
+  clock_t start;
+  double sec;
+
+  integ_cowell(&nav_csm_state, NC_ARC_CS, r, v);
+  printf("propagation over %ld s from the nominal CSM state:\n",
+         NC_ARC_CS / 100);
+
+  start = clock();
+  for (n = 0; nc_seconds(start) < NC_BENCH_SEC; n++) {
+    nav_kepler(&nav_csm_state, (agc_dp_t)NC_ARC_CS, &out);
+  }
+  sec = nc_seconds(start);
+  nav_state_to_fx(&out, &conic);
+  printf("  kepler   %10.2f us/call   1 call    %10.1f m from Cowell "
+         "(conic only)\n",
+         sec * 1e6 / (double)n,
+         nc_error_m(&conic, r));
+
+  steps = 0;
+  start = clock();
+  for (n = 0; nc_seconds(start) < NC_BENCH_SEC; n++) {
+    steps = integ_encke(&nav_csm_state, NC_ARC_CS, &encke);
+  }
+  sec = nc_seconds(start);
+  printf("  encke    %10.2f us/call   %ld steps %10.1f m from Cowell\n",
+         sec * 1e6 / (double)n,
+         steps,
+         nc_error_m(&encke, r));
+
+  start = clock();
+  for (n = 0; nc_seconds(start) < NC_BENCH_SEC; n++) {
+    steps = integ_cowell(&nav_csm_state, NC_ARC_CS, r, v);
+  }
+  sec = nc_seconds(start);
+  printf("  cowell   %10.2f us/call   %ld steps (double reference)\n",
+         sec * 1e6 / (double)n,
+         steps);
+}
+
+static void
+nc_bench_orbit(unsigned long seed)
+{
+  static agc_state_vector_t svs[NC_BENCH_ORBITS];
+  static nav_orbit_t out[NC_BENCH_ORBITS];
+  agc_uint64_t state;
+  nc_orbit_t o;
+  unsigned long n;
+  clock_t start;
+  double sec, sink;
+  int i;
+
+  state = NC_U64(seed, 0x42454E43UL);
+  for (i = 0; i < NC_BENCH_ORBITS; i++) {
+    nc_random_sv(&state, &svs[i]);
+  }
+  printf("orbit computation over %d random state vectors:\n",
+         NC_BENCH_ORBITS);
+
+  start = clock();
+  for (n = 0; nc_seconds(start) < NC_BENCH_SEC; n++) {
+    nav_compute_orbits(svs, NC_BENCH_ORBITS, out);
+  }
+  sec = nc_seconds(start);
+  printf("  q40      %10.1f ns/orbit  %10.0f orbits/s\n",
+         sec * 1e9 / ((double)n * NC_BENCH_ORBITS),
+         (double)n * NC_BENCH_ORBITS / sec);
+
+  sink = 0.0;
+  start = clock();
+  for (n = 0; nc_seconds(start) < NC_BENCH_SEC; n++) {
+    for (i = 0; i < NC_BENCH_ORBITS; i++) {
+      nc_orbit_double(&svs[i], &o);
+      sink += o.period_sec;
+    }
+  }
+  sec = nc_seconds(start);
+  printf("  double   %10.1f ns/orbit  %10.0f orbits/s%s\n",
+         sec * 1e9 / ((double)n * NC_BENCH_ORBITS),
+         (double)n * NC_BENCH_ORBITS / sec,
+         sink < 0.0 ? " " : "");
+}
+
+/* ----------------------------------------------------------------
+ * Main
+ * ---------------------------------------------------------------- */
+
+static void
+nc_usage(void)
+{
+  printf("usage: nav_check [--samples N] [--seed S] [--bench]\n");
+}
+
+static int
+nc_parse_ulong(const char* s, unsigned long* out)
+{
+  char* end;
+
+  if (*s == '-') {
+    return -1;
+  }
+  *out = strtoul(s, &end, 10);
+  return *end == '\0' && end != s ? 0 : -1;
+}
+
+int
+main(int argc, char* argv[])
+{
+  unsigned long samples, seed;
+  int bench, rc, i;
+
+  samples = NC_DEFAULT_SAMPLES;
+  seed = 1;
+  bench = 0;
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+      if (nc_parse_ulong(argv[++i], &samples) < 0) {
+        printf("Invalid --samples value: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      if (nc_parse_ulong(argv[++i], &seed) < 0 || seed > 0xFFFFFFFFUL) {
+        printf("Invalid --seed value: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--bench") == 0) {
+      bench = 1;
+    } else {
+      nc_usage();
+      return 2;
+    }
+  }
+
+  nav_init();
+  rc = 0;
+  rc |= nc_check_kepler(samples, seed);
+  rc |= nc_check_encke();
+  rc |= nc_check_orbit(samples, seed);
+  if (bench) {
+    nc_bench_propagation();
+    nc_bench_orbit(seed);
+  }
+  printf("%s\n", rc == 0 ? "PASS" : "FAIL");
+  return rc;
+}
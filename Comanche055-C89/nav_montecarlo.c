@@ -0,0 +1,666 @@
+/*
+ * nav_montecarlo.c -- Monte Carlo dispersions of the CSM state vector.
+ *
+ * Draws dispersed copies of the nominal CSM state (as set by
+ * nav_init), each position and velocity component offset by a normal
+ * deviate, takes every copy along its conic to a common time and runs
+ * nav_compute_orbit() on the result.  Prints percentiles of apogee,
+ * perigee and period, and can stream every result to a file.
+ *
+ *   nav_montecarlo [--samples N] [--seed S] [--sigma-r M]
+ *                  [--sigma-v MPS] [--time CS] [--shard I/N]
+ *                  [--out FILE]
+ *   nav_montecarlo --merge FILE...
+ *
+ * Sample i has a generator of its own, seeded from S and i, so it
+ * comes out the same whichever process draws it.  --shard I/N runs
+ * the I-th (from 0) of N contiguous slices of the samples: start one
+ * process per core, each with --out, then --merge the files for the
+ * statistics of the whole run.
+ *
+ * Samples go through in blocks of MC_BLOCK, held as one column per
+ * quantity, and each block is written out as soon as it is done.
+ * File layout, little-endian:
+ *
+ *   header     "AGMC", version, 3 zero bytes, seed (u32), samples in
+ *              the whole run (u32)
+ *   row group  first sample (u32), count (u32), then count values of
+ *              each column in turn: apogee km (i32), perigee km
+ *              (i32), period s (i32), status (u8, MC_STATUS_*)
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "agc.h"
+#include "agc_fixed.h"
+#include "navigation.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MC_VERSION 1
+#define MC_HEADER_SIZE 16
+#define MC_BLOCK 4096
+#define MC_GROUP_SIZE(n) (8 + 13 * (n))
+#define MC_MAX_SAMPLES 16777216UL /* Per process, for the statistics */
+
+#define MC_DEFAULT_SAMPLES 100000UL
+#define MC_DEFAULT_SIGMA_R_M 1000.0
+#define MC_DEFAULT_SIGMA_V_MPS 1.0
+#define MC_DEFAULT_TIME_CS 360000L
+
+#define MC_STATUS_OK 0
+#define MC_STATUS_NO_CONIC 1 /* Propagation failed or left the limits */
+#define MC_STATUS_ESCAPE 2   /* Not a closed orbit */
+
+typedef struct
+{
+  unsigned long samples;
+  unsigned long seed;
+  double sigma_r_m;
+  double sigma_v_mps;
+  long time_cs;
+  unsigned long shard;
+  unsigned long shards;
+  const char* out;
+} mc_options_t;
+
+/* One block of samples, a column per quantity */
+typedef struct
+{
+  agc_fx_t r[3][MC_BLOCK];
+  agc_fx_t v[3][MC_BLOCK];
+  long apogee_km[MC_BLOCK];
+  long perigee_km[MC_BLOCK];
+  long period_sec[MC_BLOCK];
+  unsigned char status[MC_BLOCK];
+} mc_block_t;
+
+/* Results of closed orbits, kept for the percentiles */
+typedef struct
+{
+  long* apogee_km;
+  long* perigee_km;
+  long* period_sec;
+  unsigned long ok;
+  unsigned long total;
+  unsigned long no_conic;
+  unsigned long escape;
+} mc_stats_t;
+
+static mc_block_t mc_block;
+static unsigned char mc_buf[MC_GROUP_SIZE(MC_BLOCK)];
+
+/* ----------------------------------------------------------------
+ * Random numbers
+ * ---------------------------------------------------------------- */
+
+#define MC_U64(hi, lo)                                                         \
+  (((agc_uint64_t)(hi) << 32) | (agc_uint64_t)(unsigned long)(lo))
+
+/* SplitMix64 */
+static agc_uint64_t
+mc_next(agc_uint64_t* state)
+{
+  agc_uint64_t z;
+
+  *state += MC_U64(0x9E3779B9UL, 0x7F4A7C15UL);
+  z = *state;
+  z = (z ^ (z >> 30)) * MC_U64(0xBF58476DUL, 0x1CE4E5B9UL);
+  z = (z ^ (z >> 27)) * MC_U64(0x94D049BBUL, 0x133111EBUL);
+  return z ^ (z >> 31);
+}
+
+/* Generator of sample index: the seed and index mixed once, so that
+ * neighbouring samples start far apart */
+static agc_uint64_t
+mc_sample_state(unsigned long seed, unsigned long index)
+{
+  agc_uint64_t state;
+
+  state = MC_U64(seed, index);
+  return mc_next(&state);
+}
+
+/* Uniform on (0, 1] */
+static double
+mc_uniform(agc_uint64_t* state)
+{
+  return ((double)(mc_next(state) >> 11) + 1.0) / 9007199254740992.0;
+}
+
+/* Two standard normal deviates (Box-Muller) */
+static void
+mc_normal_pair(agc_uint64_t* state, double* a, double* b)
+{
+  double radius, angle;
+
+  radius = sqrt(-2.0 * log(mc_uniform(state)));
+  angle = 6.283185307179586 * mc_uniform(state);
+  *a = radius * cos(angle);
+  *b = radius * sin(angle);
+}
+
+/* ----------------------------------------------------------------
+ * Samples
+ * ---------------------------------------------------------------- */
+
+static void
+mc_draw(const mc_options_t* opt,
+        const nav_fx_state_t* nominal,
+        unsigned long first,
+        int count)
+{
+  agc_uint64_t state;
+  double n[6], dr, dv;
+  int i, k;
+
+  /* Sigmas in DU and DU/TU */
+  dr = opt->sigma_r_m / (1000.0 * NAV_DU_KM);
+  dv = opt->sigma_v_mps * NAV_TU_SEC / (1000.0 * NAV_DU_KM);
+  for (i = 0; i < count; i++) {
+    state = mc_sample_state(opt->seed, first + (unsigned long)i);
+    mc_normal_pair(&state, &n[0], &n[1]);
+    mc_normal_pair(&state, &n[2], &n[3]);
+    mc_normal_pair(&state, &n[4], &n[5]);
+    for (k = 0; k < 3; k++) {
+      mc_block.r[k][i] = nominal->r[k] + agc_fx_from_double(n[k] * dr);
+      mc_block.v[k][i] = nominal->v[k] + agc_fx_from_double(n[3 + k] * dv);
+    }
+  }
+}
+
+static void
+mc_propagate(int count, agc_fx_t dt_tu)
+{
+  nav_fx_state_t s0, s1;
+  agc_state_vector_t sv;
+  agc_fx_t r_limit, v_limit;
+  int i, k;
+
+  /* The state vector word limits of nav_load_user_state() */
+  r_limit = AGC_FX_CONST((double)NAV_MAX_RADIUS_KM / NAV_DU_KM);
+  v_limit =
+    AGC_FX_CONST(NAV_MAX_SPEED_MPS * NAV_TU_SEC / (1000.0 * NAV_DU_KM));
+  for (i = 0; i < count; i++) {
+    for (k = 0; k < 3; k++) {
+      s0.r[k] = mc_block.r[k][i];
+      s0.v[k] = mc_block.v[k][i];
+    }
+    mc_block.apogee_km[i] = 0;
+    mc_block.perigee_km[i] = 0;
+    mc_block.period_sec[i] = 0;
+    mc_block.status[i] = MC_STATUS_NO_CONIC;
+    if (nav_kepler_fx(&s0, dt_tu, &s1) < 0) {
+      continue;
+    }
+    for (k = 0; k < 3; k++) {
+      if (agc_fx_abs(s1.r[k]) > r_limit || agc_fx_abs(s1.v[k]) > v_limit) {
+        break;
+      }
+    }
+    if (k < 3) {
+      continue;
+    }
+
+    nav_state_from_fx(&s1, &sv);
+    mc_block.status[i] = nav_compute_orbit(&sv,
+                                           &mc_block.apogee_km[i],
+                                           &mc_block.perigee_km[i],
+                                           &mc_block.period_sec[i])
+                           ? MC_STATUS_ESCAPE
+                           : MC_STATUS_OK;
+  }
+}
+
+/* ----------------------------------------------------------------
+ * File
+ * ---------------------------------------------------------------- */
+
+static unsigned char*
+mc_put_u32(unsigned char* p, unsigned long x)
+{
+  p[0] = (unsigned char)(x & 0xFF);
+  p[1] = (unsigned char)((x >> 8) & 0xFF);
+  p[2] = (unsigned char)((x >> 16) & 0xFF);
+  p[3] = (unsigned char)((x >> 24) & 0xFF);
+  return p + 4;
+}
+
+static unsigned long
+mc_get_u32(const unsigned char* p)
+{
+  return (unsigned long)p[0] | ((unsigned long)p[1] << 8) |
+         ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+static long
+mc_get_i32(const unsigned char* p)
+{
+  unsigned long x;
+
+  x = mc_get_u32(p);
+  return x >= 0x80000000UL ? -(long)(0xFFFFFFFFUL - x) - 1 : (long)x;
+}
+
+static int
+mc_write_header(FILE* f, const mc_options_t* opt)
+{
+  unsigned char header[MC_HEADER_SIZE];
+
+  memcpy(header, "AGMC", 4);
+  header[4] = MC_VERSION;
+  header[5] = 0;
+  header[6] = 0;
+  header[7] = 0;
+  mc_put_u32(header + 8, opt->seed);
+  mc_put_u32(header + 12, opt->samples);
+  return fwrite(header, 1, MC_HEADER_SIZE, f) == MC_HEADER_SIZE ? 0 : -1;
+}
+
+static int
+mc_write_group(FILE* f, unsigned long first, int count)
+{
+  unsigned char* p;
+  int i;
+
+  p = mc_put_u32(mc_buf, first);
+  p = mc_put_u32(p, (unsigned long)count);
+  for (i = 0; i < count; i++) {
+    p = mc_put_u32(p, (unsigned long)mc_block.apogee_km[i]);
+  }
+  for (i = 0; i < count; i++) {
+    p = mc_put_u32(p, (unsigned long)mc_block.perigee_km[i]);
+  }
+  for (i = 0; i < count; i++) {
+    p = mc_put_u32(p, (unsigned long)mc_block.period_sec[i]);
+  }
+  memcpy(p, mc_block.status, (size_t)count);
+  return fwrite(mc_buf, 1, MC_GROUP_SIZE(count), f) ==
+             (size_t)MC_GROUP_SIZE(count)
+           ? 0
+           : -1;
+}
+
+/* ----------------------------------------------------------------
+ * Statistics
+ * ---------------------------------------------------------------- */
+
+static int
+mc_stats_alloc(mc_stats_t* st, unsigned long capacity)
+{
+  memset(st, 0, sizeof(*st));
+  if (capacity == 0) {
+    capacity = 1;
+  }
+  st->apogee_km = (long*)malloc(capacity * sizeof(long));
+  st->perigee_km = (long*)malloc(capacity * sizeof(long));
+  st->period_sec = (long*)malloc(capacity * sizeof(long));
+  return st->apogee_km && st->perigee_km && st->period_sec ? 0 : -1;
+}
+
+static void
+mc_stats_free(mc_stats_t* st)
+{
+  free(st->apogee_km);
+  free(st->perigee_km);
+  free(st->period_sec);
+}
+
+static void
+mc_stats_add(mc_stats_t* st, long apogee, long perigee, long period, int status)
+{
+  st->total++;
+  if (status == MC_STATUS_NO_CONIC) {
+    st->no_conic++;
+  } else if (status == MC_STATUS_ESCAPE) {
+    st->escape++;
+  } else {
+    st->apogee_km[st->ok] = apogee;
+    st->perigee_km[st->ok] = perigee;
+    st->period_sec[st->ok] = period;
+    st->ok++;
+  }
+}
+
+static int
+mc_compare_long(const void* a, const void* b)
+{
+  long x = *(const long*)a;
+  long y = *(const long*)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/* Nearest-rank percentile of sorted values */
+static long
+mc_percentile(const long* sorted, unsigned long n, double pct)
+{
+  unsigned long rank;
+
+  rank = (unsigned long)ceil(pct / 100.0 * (double)n);
+  if (rank < 1) {
+    rank = 1;
+  }
+  if (rank > n) {
+    rank = n;
+  }
+  return sorted[rank - 1];
+}
+
+static void
+mc_report_row(const char* name, long* values, unsigned long n)
+{
+  static const double pcts[] = { 1.0, 5.0, 50.0, 95.0, 99.0 };
+  double sum;
+  unsigned long i;
+  int k;
+
+  qsort(values, n, sizeof(long), mc_compare_long);
+  sum = 0.0;
+  for (i = 0; i < n; i++) {
+    sum += (double)values[i];
+  }
+  printf("%-11s %8ld", name, values[0]);
+  for (k = 0; k < (int)(sizeof(pcts) / sizeof(pcts[0])); k++) {
+    printf(" %8ld", mc_percentile(values, n, pcts[k]));
+  }
+  printf(" %8ld %10.1f\n", values[n - 1], sum / (double)n);
+}
+
+static void
+mc_report(mc_stats_t* st)
+{
+  printf("samples %lu  closed %lu  escape %lu  no conic %lu\n",
+         st->total,
+         st->ok,
+         st->escape,
+         st->no_conic);
+  if (st->ok == 0) {
+    return;
+  }
+  printf("%-11s %8s %8s %8s %8s %8s %8s %8s %10s\n",
+         "",
+         "min",
+         "p1",
+         "p5",
+         "p50",
+         "p95",
+         "p99",
+         "max",
+         "mean");
+  mc_report_row("apogee km", st->apogee_km, st->ok);
+  mc_report_row("perigee km", st->perigee_km, st->ok);
+  mc_report_row("period s", st->period_sec, st->ok);
+}
+
+/* ----------------------------------------------------------------
+ * Run and merge
+ * ---------------------------------------------------------------- */
+
+static int
+mc_run(const mc_options_t* opt)
+{
+  nav_fx_state_t nominal;
+  mc_stats_t st;
+  FILE* f;
+  unsigned long first, end, at;
+  agc_fx_t dt_tu;
+  clock_t start;
+  int count, i, rc;
+
+  first = (unsigned long)((agc_uint64_t)opt->samples * opt->shard /
+                          opt->shards);
+  end = (unsigned long)((agc_uint64_t)opt->samples * (opt->shard + 1) /
+                        opt->shards);
+  if (end - first > MC_MAX_SAMPLES) {
+    fprintf(stderr, "At most %lu samples per process\n", MC_MAX_SAMPLES);
+    return 2;
+  }
+  if (mc_stats_alloc(&st, end - first) < 0) {
+    fprintf(stderr, "Out of memory\n");
+    mc_stats_free(&st);
+    return 1;
+  }
+
+  f = NULL;
+  if (opt->out != NULL) {
+    f = fopen(opt->out, "wb");
+    if (f == NULL || mc_write_header(f, opt) < 0) {
+      fprintf(stderr, "Cannot write %s\n", opt->out);
+      if (f != NULL) {
+        fclose(f);
+      }
+      mc_stats_free(&st);
+      return 1;
+    }
+  }
+
+  nav_init();
+  nav_state_to_fx(&nav_csm_state, &nominal);
+  dt_tu = nav_cs_to_tu(opt->time_cs - (long)nav_csm_state.time);
+
+  rc = 0;
+  start = clock();
+  for (at = first; at < end; at += (unsigned long)count) {
+    count = end - at > MC_BLOCK ? MC_BLOCK : (int)(end - at);
+    mc_draw(opt, &nominal, at, count);
+    mc_propagate(count, dt_tu);
+    for (i = 0; i < count; i++) {
+      mc_stats_add(&st,
+                   mc_block.apogee_km[i],
+                   mc_block.perigee_km[i],
+                   mc_block.period_sec[i],
+                   mc_block.status[i]);
+    }
+    if (f != NULL && mc_write_group(f, at, count) < 0) {
+      fprintf(stderr, "Cannot write %s\n", opt->out);
+      rc = 1;
+      break;
+    }
+  }
+  if (f != NULL && fclose(f) != 0 && rc == 0) {
+    fprintf(stderr, "Cannot write %s\n", opt->out);
+    rc = 1;
+  }
+
+  printf("shard %lu/%lu: samples %lu..%lu in %.2f s\n",
+         opt->shard,
+         opt->shards,
+         first,
+         end,
+         (double)(clock() - start) / CLOCKS_PER_SEC);
+  mc_report(&st);
+  mc_stats_free(&st);
+  return rc;
+}
+
+/* Adds the row groups of one file to st */
+static int
+mc_merge_file(const char* path, mc_stats_t* st, unsigned long capacity)
+{
+  unsigned char header[MC_HEADER_SIZE];
+  unsigned long count, i;
+  FILE* f;
+  int rc;
+
+  f = fopen(path, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "Cannot read %s\n", path);
+    return -1;
+  }
+  if (fread(header, 1, MC_HEADER_SIZE, f) != MC_HEADER_SIZE ||
+      memcmp(header, "AGMC", 4) != 0 || header[4] != MC_VERSION) {
+    fprintf(stderr, "%s is not a version %d sample file\n", path, MC_VERSION);
+    fclose(f);
+    return -1;
+  }
+
+  rc = 0;
+  while (fread(mc_buf, 1, 8, f) == 8) {
+    count = mc_get_u32(mc_buf + 4);
+    if (count == 0 || count > MC_BLOCK ||
+        fread(mc_buf + 8, 1, (size_t)(13 * count), f) != 13 * count ||
+        st->total + count > capacity) {
+      fprintf(stderr, "%s: bad or truncated row group\n", path);
+      rc = -1;
+      break;
+    }
+    for (i = 0; i < count; i++) {
+      mc_stats_add(st,
+                   mc_get_i32(mc_buf + 8 + 4 * i),
+                   mc_get_i32(mc_buf + 8 + 4 * (count + i)),
+                   mc_get_i32(mc_buf + 8 + 4 * (2 * count + i)),
+                   mc_buf[8 + 12 * count + i]);
+    }
+  }
+  fclose(f);
+  return rc;
+}
+
+static int
+mc_merge(int count, char* paths[])
+{
+  unsigned char header[MC_HEADER_SIZE];
+  mc_stats_t st;
+  unsigned long samples;
+  FILE* f;
+  int i, rc;
+
+  /* The header of the first file gives the size of the whole run */
+  f = fopen(paths[0], "rb");
+  if (f == NULL || fread(header, 1, MC_HEADER_SIZE, f) != MC_HEADER_SIZE) {
+    fprintf(stderr, "Cannot read %s\n", paths[0]);
+    if (f != NULL) {
+      fclose(f);
+    }
+    return 1;
+  }
+  fclose(f);
+  samples = mc_get_u32(header + 12);
+  if (samples > MC_MAX_SAMPLES) {
+    fprintf(stderr, "At most %lu samples can be merged\n", MC_MAX_SAMPLES);
+    return 2;
+  }
+  if (mc_stats_alloc(&st, samples) < 0) {
+    fprintf(stderr, "Out of memory\n");
+    mc_stats_free(&st);
+    return 1;
+  }
+
+  rc = 0;
+  for (i = 0; i < count && rc == 0; i++) {
+    if (mc_merge_file(paths[i], &st, samples) < 0) {
+      rc = 1;
+    }
+  }
+  if (rc == 0) {
+    if (st.total != samples) {
+      fprintf(stderr,
+              "warning: %lu of %lu samples present\n",
+              st.total,
+              samples);
+    }
+    mc_report(&st);
+  }
+  mc_stats_free(&st);
+  return rc;
+}
+
+/* ----------------------------------------------------------------
+ * Main
+ * ---------------------------------------------------------------- */
+
+static void
+mc_usage(void)
+{
+  printf("usage: nav_montecarlo [--samples N] [--seed S] [--sigma-r M]\n"
+         "                      [--sigma-v MPS] [--time CS] [--shard I/N]\n"
+         "                      [--out FILE]\n"
+         "       nav_montecarlo --merge FILE...\n");
+}
+
+static int
+mc_parse_ulong(const char* s, unsigned long* out)
+{
+  char* end;
+
+  if (*s == '-') {
+    return -1;
+  }
+  *out = strtoul(s, &end, 10);
+  return *end == '\0' && end != s ? 0 : -1;
+}
+
+int
+main(int argc, char* argv[])
+{
+  mc_options_t opt;
+  char* end;
+  int i;
+
+  if (argc > 2 && strcmp(argv[1], "--merge") == 0) {
+    return mc_merge(argc - 2, argv + 2);
+  }
+
+  opt.samples = MC_DEFAULT_SAMPLES;
+  opt.seed = 1;
+  opt.sigma_r_m = MC_DEFAULT_SIGMA_R_M;
+  opt.sigma_v_mps = MC_DEFAULT_SIGMA_V_MPS;
+  opt.time_cs = MC_DEFAULT_TIME_CS;
+  opt.shard = 0;
+  opt.shards = 1;
+  opt.out = NULL;
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+      if (mc_parse_ulong(argv[++i], &opt.samples) < 0 ||
+          opt.samples > 0xFFFFFFFFUL) {
+        printf("Invalid --samples value: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      if (mc_parse_ulong(argv[++i], &opt.seed) < 0 ||
+          opt.seed > 0xFFFFFFFFUL) {
+        printf("Invalid --seed value: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--sigma-r") == 0 && i + 1 < argc) {
+      opt.sigma_r_m = strtod(argv[++i], &end);
+      if (*end != '\0' || opt.sigma_r_m < 0.0) {
+        printf("Invalid --sigma-r value: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--sigma-v") == 0 && i + 1 < argc) {
+      opt.sigma_v_mps = strtod(argv[++i], &end);
+      if (*end != '\0' || opt.sigma_v_mps < 0.0) {
+        printf("Invalid --sigma-v value: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+      opt.time_cs = strtol(argv[++i], &end, 10);
+      if (*end != '\0') {
+        printf("Invalid --time value: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--shard") == 0 && i + 1 < argc) {
+      opt.shard = strtoul(argv[++i], &end, 10);
+      if (*end != '/' || mc_parse_ulong(end + 1, &opt.shards) < 0 ||
+          opt.shards == 0 || opt.shard >= opt.shards) {
+        printf("Invalid --shard value: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      opt.out = argv[++i];
+    } else {
+      mc_usage();
+      return 2;
+    }
+  }
+  return mc_run(&opt);
+}
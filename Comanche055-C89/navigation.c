@@ -8,11 +8,15 @@
  */
 
 #include "agc.h"
+#include "agc_context.h"
 #include "agc_cpu.h"
+#include "agc_fixed.h"
 #include "agc_math.h"
 #include "navigation.h"
 #include "pinball.h"
+#include "tff.h"
 
+#include <math.h>
 #include <string.h>
 
 /* ----------------------------------------------------------------
@@ -21,32 +25,10 @@
 
 agc_state_vector_t nav_csm_state;
 agc_state_vector_t nav_lem_state;
-
-/* ----------------------------------------------------------------
- * Integer square root (Newton's method)
- * ---------------------------------------------------------------- */
-
-static long
-isqrt_long(long val)
-{
-  long x, prev;
-  if (val <= 0) {
-    return 0;
-  }
-  x = val;
-  while (x > 32767) {
-    x >>= 1;
-  }
-  if (x < 1) {
-    x = 1;
-  }
-  prev = 0;
-  while (x != prev) {
-    prev = x;
-    x = (x + val / x) / 2;
-  }
-  return x;
-}
+agc_state_vector_t nav_user_states[NAV_USER_STATES];
+int nav_user_state_count = 0;
+nav_orbit_report_t nav_orbit_report;
+nav_r30_t nav_r30;
 
 /* ----------------------------------------------------------------
  * Initialize navigation
@@ -75,127 +57,1023 @@ nav_init(void)
   nav_csm_state.v[3] = l;
 
   nav_csm_state.time = 0;
+  memset(&nav_r30, 0, sizeof(nav_r30));
+
+  nav_clear_user_states();
+}
+
+void
+nav_register_state(void)
+{
+  agc_context_register(&nav_csm_state, sizeof(nav_csm_state));
+  agc_context_register(&nav_lem_state, sizeof(nav_lem_state));
+  agc_context_register(nav_user_states, sizeof(nav_user_states));
+  agc_context_register(&nav_user_state_count, sizeof(nav_user_state_count));
+  agc_context_register(&nav_orbit_report, sizeof(nav_orbit_report));
+  agc_context_register(&nav_r30, sizeof(nav_r30));
+}
+
+void
+nav_clear_user_states(void)
+{
+  memset(nav_user_states, 0, sizeof(nav_user_states));
+  nav_user_state_count = 0;
+  memset(&nav_orbit_report, 0, sizeof(nav_orbit_report));
+  nav_orbit_report.cursor = -1;
+}
+
+/* Fills sv from ECI position (km) and velocity (m/s), time-tagged
+ * now; -1 if a component is outside the input limits */
+static int
+nav_fill_state(agc_state_vector_t* sv, const long r_km[3], const long v_mps[3])
+{
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    if (r_km[i] < -NAV_MAX_RADIUS_KM || r_km[i] > NAV_MAX_RADIUS_KM ||
+        v_mps[i] < -NAV_MAX_SPEED_MPS || v_mps[i] > NAV_MAX_SPEED_MPS) {
+      return -1;
+    }
+  }
+
+  memset(sv, 0, sizeof(*sv));
+  for (i = 0; i < 3; i++) {
+    agc_dp_unpack(
+      (agc_dp_t)(r_km[i] * 16384L), &sv->r[2 * i], &sv->r[2 * i + 1]);
+    agc_dp_unpack(
+      (agc_dp_t)(v_mps[i] * 256L / 1000L), &sv->v[2 * i], &sv->v[2 * i + 1]);
+  }
+  sv->time = (agc_dp_t)agc_time2 * 16384 + (agc_dp_t)agc_time1;
+  return 0;
+}
+
+int
+nav_load_user_state(const long r_km[3], const long v_mps[3])
+{
+  if (nav_user_state_count >= NAV_USER_STATES ||
+      nav_fill_state(
+        &nav_user_states[nav_user_state_count], r_km, v_mps) < 0) {
+    return -1;
+  }
+  return NAV_SLOT_USER + nav_user_state_count++;
+}
+
+int
+nav_load_vehicle_state(int slot, const long r_km[3], const long v_mps[3])
+{
+  agc_state_vector_t sv;
+
+  if ((slot != NAV_SLOT_CSM && slot != NAV_SLOT_LEM) ||
+      nav_fill_state(&sv, r_km, v_mps) < 0) {
+    return -1;
+  }
+  if (slot == NAV_SLOT_CSM) {
+    nav_csm_state = sv;
+  } else {
+    nav_lem_state = sv;
+  }
+  return 0;
 }
 
 /* ----------------------------------------------------------------
- * Compute orbital parameters from state vector
+ * Canonical units
  * ----------------------------------------------------------------
- * Uses vis-viva equation: a = mu*r / (2*mu - v^2*r)
- * Eccentricity from angular momentum: e^2 = 1 - h^2/(mu*a)
+ * DP position words hold km * 2^14 and velocity words km/s * 2^8.
+ * Each factor is applied as a Q40 multiply; the shifts keep the
+ * constants and operands inside 64 bits.
  */
 
+#define NAV_FX_PER_R_WORD AGC_FX_CONST(1099511627776.0 / (16384.0 * NAV_DU_KM))
+#define NAV_R_WORDS_PER_FX AGC_FX_CONST(16384.0 * NAV_DU_KM / 1099511627776.0)
+#define NAV_KM_S_PER_DU_TU (NAV_DU_KM / NAV_TU_SEC)
+/* Scaled by 2^-16 */
+#define NAV_FX_PER_V_WORD                                                     \
+  AGC_FX_CONST(16777216.0 / (256.0 * NAV_KM_S_PER_DU_TU))
+#define NAV_V_WORDS_PER_FX                                                     \
+  AGC_FX_CONST(256.0 * NAV_KM_S_PER_DU_TU / 1099511627776.0)
+/* Scaled by 2^-8 */
+#define NAV_TU_PER_CS_256 AGC_FX_CONST(4294967296.0 / (100.0 * NAV_TU_SEC))
+
 void
-nav_compute_orbit(const agc_state_vector_t* sv,
-                  long* apogee_km,
-                  long* perigee_km,
-                  long* period_sec)
+nav_state_to_fx(const agc_state_vector_t* sv, nav_fx_state_t* out)
 {
-  long rx, ry, rz, vx, vy, vz;
-  long r_mag, v_sq, r_mag_sq;
-  long mu, two_mu;
-  long energy_num, a_km;
-  agc_int64_t h_sq;
-  long e_num, e_den;
-  long apo, peri;
+  agc_fx_t r, v;
+  int i;
 
-  rx = (long)agc_dp_pack(sv->r[0], sv->r[1]) / 16384L;
-  ry = (long)agc_dp_pack(sv->r[2], sv->r[3]) / 16384L;
-  rz = (long)agc_dp_pack(sv->r[4], sv->r[5]) / 16384L;
+  for (i = 0; i < 3; i++) {
+    r = (agc_fx_t)agc_dp_pack(sv->r[2 * i], sv->r[2 * i + 1]);
+    v = (agc_fx_t)agc_dp_pack(sv->v[2 * i], sv->v[2 * i + 1]);
+    out->r[i] = agc_fx_mul(r, NAV_FX_PER_R_WORD);
+    out->v[i] = agc_fx_mul(v * 65536, NAV_FX_PER_V_WORD);
+  }
+}
 
-  vx = (long)agc_dp_pack(sv->v[0], sv->v[1]) * 64L / 16384L;
-  vy = (long)agc_dp_pack(sv->v[2], sv->v[3]) * 64L / 16384L;
-  vz = (long)agc_dp_pack(sv->v[4], sv->v[5]) * 64L / 16384L;
+void
+nav_state_from_fx(const nav_fx_state_t* in, agc_state_vector_t* sv)
+{
+  agc_fx_t r, v;
+  int i;
 
-  r_mag_sq = rx * rx + ry * ry + rz * rz;
-  r_mag = isqrt_long(r_mag_sq);
-  if (r_mag == 0) {
-    r_mag = 1;
+  for (i = 0; i < 3; i++) {
+    r = agc_fx_mul(in->r[i], NAV_R_WORDS_PER_FX);
+    v = agc_fx_mul(in->v[i], NAV_V_WORDS_PER_FX);
+    agc_dp_unpack((agc_dp_t)r, &sv->r[2 * i], &sv->r[2 * i + 1]);
+    agc_dp_unpack((agc_dp_t)v, &sv->v[2 * i], &sv->v[2 * i + 1]);
   }
+}
 
-  v_sq = vx * vx + vy * vy + vz * vz;
-  mu = MU_EARTH_KM3S2;
+agc_fx_t
+nav_cs_to_tu(long cs)
+{
+  return agc_fx_mul((agc_fx_t)cs * 256, NAV_TU_PER_CS_256);
+}
 
-  /* Semi-major axis: a = mu*r / (2*mu - v^2*r) */
-  two_mu = 2 * mu;
-  energy_num = two_mu - v_sq * r_mag;
+int
+nav_state_empty(const agc_state_vector_t* sv)
+{
+  int i;
+  for (i = 0; i < 6; i++) {
+    if (sv->r[i] != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
 
-  if (energy_num <= 0) {
-    *apogee_km = 99999;
-    *perigee_km = r_mag - EARTH_RADIUS_KM;
-    *period_sec = 0;
-    return;
+void
+nav_time_to_noun(long cs, int values[3])
+{
+  long secs;
+  int sign;
+
+  sign = cs < 0 ? -1 : 1;
+  secs = (cs < 0 ? -cs : cs) / 100;
+  values[0] = sign * (int)(secs / 3600);
+  values[1] = sign * (int)((secs % 3600) / 60);
+  values[2] = sign * (int)(secs % 60);
+}
+
+/* ----------------------------------------------------------------
+ * Conic subroutines: KEPLER (universal variables)
+ * ----------------------------------------------------------------
+ * With mu = 1 and alpha = 1/a, the universal anomaly x satisfies
+ *   t(x) = sigma0 x^2 C(z) + (1 - alpha r0) x^3 S(z) + r0 x,
+ * z = alpha x^2, where C and S are the Stumpff functions.  t(x) is
+ * increasing (dt/dx = r > 0), so the root is kept in a bracket and a
+ * Newton step that leaves it, or is not half the previous step, is
+ * replaced by bisection.  Elliptic transfers are first reduced to
+ * within half a period of s0; for open orbits the bracket is grown
+ * by doubling, with saturating sums so an overshoot reads as "too
+ * late" instead of wrapping.  The Lagrange f and g coefficients then
+ * give the new state.
+ */
+
+#define NAV_STUMPFF_TERMS 12
+#define NAV_KEPLER_TOLERANCE 64 /* Q40 units of x */
+#define NAV_TWO_PI AGC_FX_CONST(6.283185307179586)
+
+typedef struct
+{
+  agc_fx_t r0;
+  agc_fx_t sigma0; /* r0 . v0 */
+  agc_fx_t alpha;  /* 1/a */
+  agc_fx_t one_ar0;
+} nav_kepler_t;
+
+/* C(z) = sum (-z)^k / (2k+2)!,  S(z) = sum (-z)^k / (2k+3)!.
+ * The series runs on z / 4^n with |z / 4^n| <= 1, and the results are
+ * scaled back up with C(4z) = (1 - z S)^2 / 2 and
+ * S(4z) = (C + S - z C S) / 4. */
+static void
+nav_stumpff(agc_fx_t z, agc_fx_t* c, agc_fx_t* s)
+{
+  agc_fx_t term_c, term_s, sn, s4;
+  long k;
+  int quarterings;
+
+  quarterings = 0;
+  while (agc_fx_abs(z) > AGC_FX_ONE) {
+    z /= 4;
+    quarterings++;
   }
 
-  a_km = (long)(((agc_int64_t)mu * r_mag) / energy_num);
+  term_c = AGC_FX_ONE / 2;
+  term_s = AGC_FX_ONE / 6;
+  *c = 0;
+  *s = 0;
+  for (k = 0; k < NAV_STUMPFF_TERMS && (term_c != 0 || term_s != 0); k++) {
+    *c += term_c;
+    *s += term_s;
+    term_c = -agc_fx_mul(term_c, z) / ((2 * k + 3) * (2 * k + 4));
+    term_s = -agc_fx_mul(term_s, z) / ((2 * k + 4) * (2 * k + 5));
+  }
 
-  /* Specific angular momentum squared */
-  {
-    agc_int64_t hx = (agc_int64_t)ry * vz - (agc_int64_t)rz * vy;
-    agc_int64_t hy = (agc_int64_t)rz * vx - (agc_int64_t)rx * vz;
-    agc_int64_t hz = (agc_int64_t)rx * vy - (agc_int64_t)ry * vx;
-    h_sq = hx * hx + hy * hy + hz * hz;
+  while (quarterings-- > 0) {
+    sn = agc_fx_add(AGC_FX_ONE, -agc_fx_mul(z, *s));
+    s4 = agc_fx_add(agc_fx_add(*c, *s), -agc_fx_mul(z, agc_fx_mul(*c, *s))) / 4;
+    *c = agc_fx_mul(sn, sn) / 2;
+    *s = s4;
+    z *= 4;
   }
+}
+
+static void
+nav_kepler_init(const nav_fx_state_t* s0, nav_kepler_t* k)
+{
+  k->r0 = agc_fx_vec_mag(s0->r);
+  k->sigma0 = agc_fx_vec_dot(s0->r, s0->v);
+  k->alpha = agc_fx_div(AGC_FX_INT(2), k->r0) - agc_fx_vec_dot(s0->v, s0->v);
+  k->one_ar0 = AGC_FX_ONE - agc_fx_mul(k->alpha, k->r0);
+}
+
+/* t(x) and r(x) = dt/dx */
+static void
+nav_kepler_eval(const nav_kepler_t* k, agc_fx_t x, agc_fx_t* t, agc_fx_t* r)
+{
+  agc_fx_t x2, x3, z, c, s;
+
+  x2 = agc_fx_mul(x, x);
+  x3 = agc_fx_mul(x2, x);
+  z = agc_fx_mul(k->alpha, x2);
+  nav_stumpff(z, &c, &s);
+
+  *t = agc_fx_add(agc_fx_add(agc_fx_mul(agc_fx_mul(k->sigma0, x2), c),
+                              agc_fx_mul(agc_fx_mul(k->one_ar0, x3), s)),
+                   agc_fx_mul(k->r0, x));
+  *r = agc_fx_add(
+    agc_fx_add(agc_fx_mul(x2, c),
+               agc_fx_mul(agc_fx_mul(k->sigma0, x),
+                          agc_fx_add(AGC_FX_ONE, -agc_fx_mul(z, s)))),
+    agc_fx_mul(k->r0, agc_fx_add(AGC_FX_ONE, -agc_fx_mul(z, c))));
+}
+
+int
+nav_kepler_fx(const nav_fx_state_t* s0, agc_fx_t dt_tu, nav_fx_state_t* out)
+{
+  nav_kepler_t k;
+  agc_fx_t a, period, lo, hi, x, xn, t, r, dx, dx_prev;
+  agc_fx_t x2, x3, z, c, s, f, g, fdot, gdot;
+  nav_fx_state_t result;
+  int iter, converged;
 
-  /* Eccentricity: e^2 = 1 - h^2/(mu*a) */
-  e_den = (long)((agc_int64_t)mu * a_km);
-  if (e_den == 0) {
-    e_den = 1;
+  if (dt_tu == 0) {
+    *out = *s0;
+    return 0;
+  }
+
+  nav_kepler_init(s0, &k);
+
+  iter = 0;
+  if (k.alpha > 0) {
+    /* Whole revolutions change nothing; x stays within one of them */
+    a = agc_fx_div(AGC_FX_ONE, k.alpha);
+    period = agc_fx_mul(NAV_TWO_PI, agc_fx_mul(a, agc_fx_sqrt(a)));
+    if (period > 0 && period < AGC_FX_MAX / 2) {
+      dt_tu -= (dt_tu / period) * period;
+      if (dt_tu > period / 2) {
+        dt_tu -= period;
+      } else if (dt_tu < -period / 2) {
+        dt_tu += period;
+      }
+    }
+    hi = agc_fx_mul(NAV_TWO_PI, agc_fx_sqrt(a));
+    lo = -hi;
+    x = agc_fx_mul(dt_tu, k.alpha);
+  } else {
+    /* Open orbit: grow the bracket outward from x = dt / r0 */
+    x = agc_fx_div(dt_tu, k.r0);
+    if (agc_fx_abs(x) > AGC_FX_ONE) {
+      x = dt_tu > 0 ? AGC_FX_ONE : -AGC_FX_ONE;
+    }
+    lo = dt_tu > 0 ? 0 : x;
+    hi = dt_tu > 0 ? x : 0;
+    while (iter < NAV_KEPLER_MAX_ITER) {
+      nav_kepler_eval(&k, dt_tu > 0 ? hi : lo, &t, &r);
+      iter++;
+      if (dt_tu > 0 ? t >= dt_tu : t <= dt_tu) {
+        break;
+      }
+      if (agc_fx_abs(dt_tu > 0 ? hi : lo) > AGC_FX_MAX / 4) {
+        return -1;
+      }
+      if (dt_tu > 0) {
+        lo = hi;
+        hi *= 2;
+      } else {
+        hi = lo;
+        lo *= 2;
+      }
+    }
+  }
+  if (x <= lo || x >= hi) {
+    x = lo + (hi - lo) / 2;
   }
-  e_num = (long)((agc_int64_t)e_den - h_sq / (mu > 0 ? mu : 1));
 
-  /* Apogee = a*(1+e) - Re, Perigee = a*(1-e) - Re */
-  {
-    long ae_sq, ae;
-    if (e_num < 0) {
-      e_num = 0;
+  converged = 0;
+  dx_prev = hi - lo;
+  while (iter < NAV_KEPLER_MAX_ITER) {
+    iter++;
+    nav_kepler_eval(&k, x, &t, &r);
+    if (t < dt_tu) {
+      lo = x;
+    } else {
+      hi = x;
     }
-    ae_sq = (long)(((agc_int64_t)a_km * a_km / e_den) * e_num);
-    ae = isqrt_long(ae_sq > 0 ? ae_sq : 0);
 
-    apo = a_km + ae - EARTH_RADIUS_KM;
-    peri = a_km - ae - EARTH_RADIUS_KM;
+    dx = r > 0 ? agc_fx_div(dt_tu - t, r) : dx_prev;
+    if (agc_fx_abs(dx) <= NAV_KEPLER_TOLERANCE) {
+      x += dx;
+      converged = 1;
+      break;
+    }
+    xn = x + dx;
+    if (r <= 0 || xn <= lo || xn >= hi || agc_fx_abs(dx) > dx_prev / 2) {
+      xn = lo + (hi - lo) / 2;
+    }
+    dx_prev = agc_fx_abs(xn - x);
+    x = xn;
+    if (hi - lo <= NAV_KEPLER_TOLERANCE) {
+      converged = 1;
+      break;
+    }
+  }
+
+  x2 = agc_fx_mul(x, x);
+  x3 = agc_fx_mul(x2, x);
+  z = agc_fx_mul(k.alpha, x2);
+  nav_stumpff(z, &c, &s);
+
+  f = AGC_FX_ONE - agc_fx_div(agc_fx_mul(x2, c), k.r0);
+  g = dt_tu - agc_fx_mul(x3, s);
+  agc_fx_vec_scale(f, s0->r, result.r);
+  agc_fx_vec_madd(result.r, g, s0->v, result.r);
+
+  r = agc_fx_vec_mag(result.r);
+  fdot = agc_fx_div(agc_fx_mul(x, agc_fx_mul(z, s) - AGC_FX_ONE),
+                    agc_fx_mul(r, k.r0));
+  gdot = AGC_FX_ONE - agc_fx_div(agc_fx_mul(x2, c), r);
+  agc_fx_vec_scale(fdot, s0->r, result.v);
+  agc_fx_vec_madd(result.v, gdot, s0->v, result.v);
+
+  *out = result;
+  return converged ? iter : -1;
+}
+
+/* sigma(x) = r.v = dr/dx = sigma0 (1 - zC) + (1 - alpha r0) x (1 - zS) */
+void
+nav_kepler_x(const nav_fx_state_t* s0,
+             agc_fx_t x,
+             agc_fx_t* t,
+             agc_fx_t* r,
+             agc_fx_t* sigma)
+{
+  nav_kepler_t k;
+  agc_fx_t z, c, s;
+
+  nav_kepler_init(s0, &k);
+  nav_kepler_eval(&k, x, t, r);
+  z = agc_fx_mul(k.alpha, agc_fx_mul(x, x));
+  nav_stumpff(z, &c, &s);
+  *sigma = agc_fx_add(
+    agc_fx_mul(k.sigma0, AGC_FX_ONE - agc_fx_mul(z, c)),
+    agc_fx_mul(agc_fx_mul(k.one_ar0, x), AGC_FX_ONE - agc_fx_mul(z, s)));
+}
+
+int
+nav_kepler(const agc_state_vector_t* sv,
+           agc_dp_t time_cs,
+           agc_state_vector_t* out)
+{
+  nav_fx_state_t s0, s1;
+  agc_fx_t limit;
+  int iter, i;
+
+  nav_state_to_fx(sv, &s0);
+  iter = nav_kepler_fx(&s0, nav_cs_to_tu((long)time_cs - (long)sv->time), &s1);
+  if (iter < 0) {
+    return -1;
   }
 
-  if (apo < 0) {
-    apo = 0;
+  limit = AGC_FX_CONST((double)NAV_MAX_RADIUS_KM / NAV_DU_KM);
+  for (i = 0; i < 3; i++) {
+    if (agc_fx_abs(s1.r[i]) > limit) {
+      return -1;
+    }
   }
-  if (peri < 0) {
-    peri = 0;
+  nav_state_from_fx(&s1, out);
+  out->time = time_cs;
+  return iter;
+}
+
+/* ----------------------------------------------------------------
+ * Conic subroutines: LAMBERT (universal variables)
+ * ----------------------------------------------------------------
+ * With A = +-sqrt(r1 r2 (1 + cos dtheta)), positive the short way,
+ * the transfer time as a function of z = alpha x^2 is
+ *   y(z) = r1 + r2 + A (z S(z) - 1) / sqrt(C(z)),
+ *   t(z) = (y / C)^(3/2) S + A sqrt(y),
+ * increasing from the hyperbolic end to z = (2 pi)^2, where one
+ * revolution takes forever.  Points where y < 0 lie before the
+ * feasible range and read as too early; C <= 0 reads as too late.
+ * The root is found as in KEPLER, by Newton steps on the analytic
+ * dt/dz inside a bracket, bisecting when a step leaves it or does not
+ * halve the last one.  Close to a full revolution y is a small
+ * difference of large terms, so t carries rounding noise: a small
+ * residual that stops improving is accepted, and a long-way transfer
+ * that never gets there is refused rather than solved imprecisely.
+ * The Lagrange coefficients f = 1 - y/r1, g = A sqrt(y) and
+ * gdot = 1 - y/r2 then give both velocities.
+ */
+
+#define NAV_LAMBERT_Z_MIN AGC_FX_INT(-64)
+/* (2 pi)^2, one full revolution */
+#define NAV_LAMBERT_Z_MAX AGC_FX_CONST(39.47841760435743)
+#define NAV_LAMBERT_TOLERANCE 256  /* Q40 units of time */
+#define NAV_LAMBERT_Z_TOLERANCE 64 /* Q40 units of z */
+#define NAV_LAMBERT_Z_SMALL (AGC_FX_ONE >> 20)
+#define NAV_LAMBERT_RESIDUAL (AGC_FX_ONE >> 24)
+/* r1 and r2 within about 0.001 degree of opposite */
+#define NAV_LAMBERT_MIN_A (AGC_FX_ONE >> 16)
+#define NAV_LAMBERT_FINITE (AGC_FX_MAX / 2)
+
+typedef struct
+{
+  agc_fx_t r1;
+  agc_fx_t r2;
+  agc_fx_t a;
+} nav_lambert_geom_t;
+
+static int
+nav_lambert_geometry(const nav_lambert_t* p, nav_lambert_geom_t* g)
+{
+  agc_fx_t a;
+
+  g->r1 = agc_fx_vec_mag(p->r1);
+  g->r2 = agc_fx_vec_mag(p->r2);
+  if (g->r1 <= 0 || g->r2 <= 0) {
+    return -1;
   }
+  a = agc_fx_sqrt(agc_fx_mul(g->r1, g->r2) + agc_fx_vec_dot(p->r1, p->r2));
+  if (a < NAV_LAMBERT_MIN_A) {
+    return -1;
+  }
+  g->a = p->long_way ? -a : a;
+  return 0;
+}
+
+/* t(z), y(z) and dt/dz; returns 0 if t saturated to either end */
+static int
+nav_lambert_eval(const nav_lambert_geom_t* g,
+                 agc_fx_t z,
+                 agc_fx_t* t,
+                 agc_fx_t* y,
+                 agc_fx_t* dtdz)
+{
+  agc_fx_t c, s, x3, sy, d;
 
-  *apogee_km = apo;
-  *perigee_km = peri;
+  *dtdz = 0;
+  nav_stumpff(z, &c, &s);
+  if (c <= 0) {
+    *t = AGC_FX_MAX;
+    return 0;
+  }
+  *y = agc_fx_add(g->r1 + g->r2,
+                  agc_fx_div(agc_fx_mul(g->a, agc_fx_mul(z, s) - AGC_FX_ONE),
+                             agc_fx_sqrt(c)));
+  if (*y <= 0) {
+    *t = -AGC_FX_MAX;
+    return 0;
+  }
+  sy = agc_fx_sqrt(*y);
+  x3 = agc_fx_div(agc_fx_mul(*y, sy), agc_fx_mul(c, agc_fx_sqrt(c)));
+  *t = agc_fx_add(agc_fx_mul(x3, s), agc_fx_mul(g->a, sy));
 
-  /* Period: T ~ 2*pi*sqrt(a^3/mu) */
-  {
-    long a3_over_mu = (long)(((agc_int64_t)a_km * a_km / mu) * a_km);
-    long sqrt_val = isqrt_long(a3_over_mu > 0 ? a3_over_mu : 0);
-    *period_sec = 6 * sqrt_val + sqrt_val / 4; /* ~6.2832 */
+  /* dt/dz, with its limit at z = 0 */
+  if (agc_fx_abs(z) > NAV_LAMBERT_Z_SMALL) {
+    d = agc_fx_add(
+      agc_fx_div(c - agc_fx_div(3 * s, 2 * c), 2 * z),
+      agc_fx_div(3 * agc_fx_mul(s, s), 4 * c));
+    *dtdz = agc_fx_add(
+      agc_fx_mul(x3, d),
+      agc_fx_mul(g->a / 8,
+                 agc_fx_add(agc_fx_div(3 * agc_fx_mul(s, sy), c),
+                            agc_fx_mul(g->a, agc_fx_sqrt(agc_fx_div(c, *y))))));
+  } else {
+    *dtdz = agc_fx_add(
+      agc_fx_mul(AGC_FX_CONST(1.4142135623730951 / 40.0), agc_fx_mul(*y, sy)),
+      agc_fx_mul(g->a / 8,
+                 sy + agc_fx_mul(g->a, agc_fx_sqrt(agc_fx_div(
+                                         AGC_FX_ONE / 2, *y)))));
   }
+  return agc_fx_abs(*t) < NAV_LAMBERT_FINITE;
+}
+
+/* Finds z for dt, starting from z_guess.  When have0 is set, (z0, f0)
+ * is a solved point of the same geometry, with f0 = t(z0) - dt, and
+ * bounds the search.  Returns the iterations, or -1 with no root in
+ * range. */
+static int
+nav_lambert_solve(const nav_lambert_geom_t* g,
+                  agc_fx_t dt,
+                  int have0,
+                  agc_fx_t z0,
+                  agc_fx_t f0,
+                  agc_fx_t z_guess,
+                  agc_fx_t* z_out,
+                  agc_fx_t* y_out)
+{
+  agc_fx_t lo, hi, z, zn, t, y, f, dtdz, dz, dz_prev;
+  int finite, converged, iter;
+
+  if (dt <= 0) {
+    return -1;
+  }
+  lo = NAV_LAMBERT_Z_MIN;
+  hi = NAV_LAMBERT_Z_MAX;
+  if (have0) {
+    if (f0 < 0) {
+      lo = z0;
+    } else {
+      hi = z0;
+    }
+  }
+  z = z_guess;
+  if (z <= lo || z >= hi) {
+    z = lo + (hi - lo) / 2;
+  }
+
+  converged = 0;
+  finite = 0;
+  y = f = 0;
+  dz_prev = hi - lo;
+  iter = 0;
+  while (iter < NAV_LAMBERT_MAX_ITER) {
+    iter++;
+    finite = nav_lambert_eval(g, z, &t, &y, &dtdz);
+    f = agc_fx_add(t, -dt);
+    if (f < 0) {
+      lo = z;
+    } else {
+      hi = z;
+    }
+
+    dz = finite && dtdz > 0 ? agc_fx_div(-f, dtdz) : dz_prev;
+    /* Converged, or down to the rounding noise in t: a step that does
+     * not halve the last one when the residual is already small */
+    if (finite && (agc_fx_abs(f) <= NAV_LAMBERT_TOLERANCE ||
+                   agc_fx_abs(dz) <= NAV_LAMBERT_Z_TOLERANCE ||
+                   (agc_fx_abs(dz) > dz_prev / 2 &&
+                    agc_fx_abs(f) <= NAV_LAMBERT_RESIDUAL))) {
+      converged = 1;
+      break;
+    }
+    zn = z + dz;
+    if (!finite || dtdz <= 0 || zn <= lo || zn >= hi ||
+        agc_fx_abs(dz) > dz_prev / 2) {
+      zn = lo + (hi - lo) / 2;
+    }
+    dz_prev = agc_fx_abs(zn - z);
+    if (hi - lo <= NAV_LAMBERT_Z_TOLERANCE) {
+      converged = finite;
+      break;
+    }
+    z = zn;
+  }
+
+  if (!converged || agc_fx_abs(f) > NAV_LAMBERT_RESIDUAL) {
+    return -1;
+  }
+  *z_out = z;
+  *y_out = y;
+  return iter;
+}
+
+static void
+nav_lambert_velocities(nav_lambert_t* p,
+                       const nav_lambert_geom_t* g,
+                       agc_fx_t y)
+{
+  agc_fx_t f, gg, gdot, d[3];
+  int i;
+
+  f = AGC_FX_ONE - agc_fx_div(y, g->r1);
+  gg = agc_fx_mul(g->a, agc_fx_sqrt(y));
+  gdot = AGC_FX_ONE - agc_fx_div(y, g->r2);
+
+  agc_fx_vec_scale(-f, p->r1, d);
+  agc_fx_vec_add(p->r2, d, d);
+  for (i = 0; i < 3; i++) {
+    p->v1[i] = agc_fx_div(d[i], gg);
+  }
+  agc_fx_vec_scale(gdot, p->r2, d);
+  agc_fx_vec_sub(d, p->r1, d);
+  for (i = 0; i < 3; i++) {
+    p->v2[i] = agc_fx_div(d[i], gg);
+  }
+}
+
+int
+nav_lambert_fx(nav_lambert_t* p)
+{
+  return nav_lambert_batch(p, 1) == 1 ? p->iterations : -1;
+}
+
+int
+nav_lambert_batch(nav_lambert_t* set, int count)
+{
+  nav_lambert_geom_t g;
+  nav_lambert_t* p;
+  agc_fx_t z, y, guess, z_a, dt_a, z_b, dt_b;
+  int i, solved, same, known, geometry_ok;
+
+  solved = 0;
+  known = 0;
+  geometry_ok = 0;
+  z_a = dt_a = z_b = dt_b = 0;
+  for (i = 0; i < count; i++) {
+    p = &set[i];
+    same = i > 0 && p->long_way == set[i - 1].long_way &&
+           memcmp(p->r1, set[i - 1].r1, sizeof(p->r1)) == 0 &&
+           memcmp(p->r2, set[i - 1].r2, sizeof(p->r2)) == 0;
+
+    /* A sweep over dt keeps the geometry and starts from the previous
+     * solutions, extrapolated when there are two */
+    if (!same) {
+      known = 0;
+      geometry_ok = nav_lambert_geometry(p, &g) == 0;
+    }
+    if (!geometry_ok) {
+      p->iterations = -1;
+      continue;
+    }
+    guess = 0;
+    if (known == 2 && dt_b != dt_a) {
+      guess = z_b + agc_fx_mul(z_b - z_a,
+                               agc_fx_div(p->dt_tu - dt_b, dt_b - dt_a));
+    }
+
+    p->iterations = nav_lambert_solve(
+      &g, p->dt_tu, known > 0, z_b, dt_b - p->dt_tu, guess, &z, &y);
+    if (p->iterations < 0) {
+      continue;
+    }
+    nav_lambert_velocities(p, &g, y);
+    solved++;
+
+    z_a = z_b;
+    dt_a = dt_b;
+    z_b = z;
+    dt_b = p->dt_tu;
+    if (known < 2) {
+      known++;
+    }
+  }
+  return solved;
+}
+
+/* Double precision twin of the above, one transfer at a time, for
+ * checking the fixed-point results */
+
+static void
+nav_stumpff_double(double z, double* c, double* s)
+{
+  double q, term_c, term_s;
+  int k;
+
+  if (z > 0.1) {
+    q = sqrt(z);
+    *c = (1.0 - cos(q)) / z;
+    *s = (q - sin(q)) / (z * q);
+  } else if (z < -0.1) {
+    q = sqrt(-z);
+    *c = (cosh(q) - 1.0) / -z;
+    *s = (sinh(q) - q) / (-z * q);
+  } else {
+    term_c = 0.5;
+    term_s = 1.0 / 6.0;
+    *c = 0.0;
+    *s = 0.0;
+    for (k = 0; k < NAV_STUMPFF_TERMS; k++) {
+      *c += term_c;
+      *s += term_s;
+      term_c *= -z / ((2 * k + 3) * (2 * k + 4));
+      term_s *= -z / ((2 * k + 4) * (2 * k + 5));
+    }
+  }
+}
+
+int
+nav_lambert_double(const double r1[3],
+                   const double r2[3],
+                   double dt_tu,
+                   int long_way,
+                   double v1[3],
+                   double v2[3])
+{
+  double m1, m2, a, lo, hi, z, zn, c, s, y, f, x3, dtdz, dz, dz_prev, gg;
+  int iter, i, finite, converged;
+
+  if (dt_tu <= 0.0) {
+    return -1;
+  }
+  m1 = sqrt(r1[0] * r1[0] + r1[1] * r1[1] + r1[2] * r1[2]);
+  m2 = sqrt(r2[0] * r2[0] + r2[1] * r2[1] + r2[2] * r2[2]);
+  a = m1 * m2 + r1[0] * r2[0] + r1[1] * r2[1] + r1[2] * r2[2];
+  if (m1 <= 0.0 || m2 <= 0.0 ||
+      a < agc_fx_to_double(NAV_LAMBERT_MIN_A) *
+            agc_fx_to_double(NAV_LAMBERT_MIN_A)) {
+    return -1;
+  }
+  a = long_way ? -sqrt(a) : sqrt(a);
+
+  lo = agc_fx_to_double(NAV_LAMBERT_Z_MIN);
+  hi = agc_fx_to_double(NAV_LAMBERT_Z_MAX);
+  z = 0.0;
+  y = f = dtdz = 0.0;
+  dz_prev = hi - lo;
+  converged = 0;
+  iter = 0;
+  while (iter < NAV_LAMBERT_MAX_ITER) {
+    iter++;
+    nav_stumpff_double(z, &c, &s);
+    y = c > 0.0 ? m1 + m2 + a * (z * s - 1.0) / sqrt(c) : 0.0;
+    finite = c > 0.0 && y > 0.0;
+    if (!finite) {
+      f = c > 0.0 ? -1.0 : 1.0;
+    } else {
+      x3 = pow(y / c, 1.5);
+      f = x3 * s + a * sqrt(y) - dt_tu;
+      if (fabs(z) > 1e-6) {
+        dtdz = x3 * ((c - 1.5 * s / c) / (2.0 * z) + 0.75 * s * s / c) +
+               a / 8.0 * (3.0 * s * sqrt(y) / c + a * sqrt(c / y));
+      } else {
+        dtdz = sqrt(2.0) / 40.0 * y * sqrt(y) +
+               a / 8.0 * (sqrt(y) + a * sqrt(0.5 / y));
+      }
+    }
+    if (f < 0.0) {
+      lo = z;
+    } else {
+      hi = z;
+    }
+
+    dz = finite && dtdz > 0.0 ? -f / dtdz : dz_prev;
+    if (finite && (fabs(f) <= 1e-14 * dt_tu || fabs(dz) <= 1e-13 ||
+                   (fabs(dz) > dz_prev / 2.0 && fabs(f) <= 1e-12))) {
+      converged = 1;
+      break;
+    }
+    zn = z + dz;
+    if (!finite || dtdz <= 0.0 || zn <= lo || zn >= hi ||
+        fabs(dz) > dz_prev / 2.0) {
+      zn = lo + (hi - lo) / 2.0;
+    }
+    dz_prev = fabs(zn - z);
+    if (hi - lo <= 1e-14) {
+      converged = finite;
+      break;
+    }
+    z = zn;
+  }
+  if (!converged) {
+    return -1;
+  }
+
+  gg = a * sqrt(y);
+  for (i = 0; i < 3; i++) {
+    v1[i] = (r2[i] - (1.0 - y / m1) * r1[i]) / gg;
+    v2[i] = ((1.0 - y / m2) * r2[i] - r1[i]) / gg;
+  }
+  return iter;
+}
+
+/* ----------------------------------------------------------------
+ * Compute orbital parameters from state vector
+ * ----------------------------------------------------------------
+ * In canonical units, with p = |r x v|^2 (the semi-latus rectum) and
+ * alpha = 2/r - v^2 = 1/a:
+ *   e^2 = 1 - alpha p,  rp = p / (1 + e),  ra = 2a - rp,
+ *   T = 2 pi a^3/2.
+ * rp holds for every conic and ra avoids dividing by 1 - e, so
+ * neither loses precision near the parabola.  Orbits with alpha <= 0,
+ * or a beyond NAV_ORBIT_MAX_A (far outside the Earth's sphere of
+ * influence), are escape orbits: no apogee and no period.
+ */
+
+#define NAV_ORBIT_MAX_A AGC_FX_INT(4096)
+#define NAV_NOUN_MAX_KM 185183L /* 99999 NM */
+/* Per DU and per TU, scaled by 2^-16 */
+#define NAV_KM_PER_DU_65536 AGC_FX_CONST(NAV_DU_KM / 65536.0)
+#define NAV_SEC_PER_TU_65536 AGC_FX_CONST(NAV_TU_SEC / 65536.0)
+
+/* round(x * k), for k scaled by 2^-16 */
+static long
+nav_fx_scale_long(agc_fx_t x, agc_fx_t k_65536)
+{
+  agc_fx_t p, half, unit;
+
+  p = agc_fx_mul(x, k_65536);
+  unit = (agc_fx_t)1 << (AGC_FX_FRAC_BITS - 16);
+  half = unit / 2;
+  return (long)(p < 0 ? -((-p + half) / unit) : (p + half) / unit);
+}
+
+int
+nav_compute_orbit(const agc_state_vector_t* sv,
+                  long* apogee_km,
+                  long* perigee_km,
+                  long* period_sec)
+{
+  nav_fx_state_t s;
+  agc_fx_t h[3], r, alpha, p, e2, e, rp, a;
+
+  nav_state_to_fx(sv, &s);
+  r = agc_fx_vec_mag(s.r);
+  if (r == 0) {
+    *apogee_km = 0;
+    *perigee_km = 0;
+    *period_sec = 0;
+    return 0;
+  }
+  alpha = agc_fx_div(AGC_FX_INT(2), r) - agc_fx_vec_dot(s.v, s.v);
+  agc_fx_vec_cross(s.r, s.v, h);
+  p = agc_fx_vec_dot(h, h);
+
+  e2 = AGC_FX_ONE - agc_fx_mul(alpha, p);
+  e = e2 > 0 ? agc_fx_sqrt(e2) : 0;
+  rp = agc_fx_div(p, AGC_FX_ONE + e);
+  *perigee_km = nav_fx_scale_long(rp - AGC_FX_ONE, NAV_KM_PER_DU_65536);
+
+  if (alpha <= 0 || agc_fx_mul(alpha, NAV_ORBIT_MAX_A) < AGC_FX_ONE) {
+    *apogee_km = 0;
+    *period_sec = 0;
+    return 1;
+  }
+  a = agc_fx_div(AGC_FX_ONE, alpha);
+  *apogee_km =
+    nav_fx_scale_long(2 * a - rp - AGC_FX_ONE, NAV_KM_PER_DU_65536);
+  *period_sec = nav_fx_scale_long(
+    agc_fx_mul(NAV_TWO_PI, agc_fx_mul(a, agc_fx_sqrt(a))),
+    NAV_SEC_PER_TU_65536);
+  return 0;
+}
+
+void
+nav_compute_orbits(const agc_state_vector_t* svs, int count, nav_orbit_t* out)
+{
+  int i;
+  for (i = 0; i < count; i++) {
+    out[i].open = nav_compute_orbit(
+      &svs[i], &out[i].apogee_km, &out[i].perigee_km, &out[i].period_sec);
+  }
+}
+
+/* 1 km = 0.53996 NM ~ 54/100, held to the five DSKY digits */
+static int
+nav_km_to_nm(long km)
+{
+  if (km > NAV_NOUN_MAX_KM) {
+    return 99999;
+  }
+  if (km < -NAV_NOUN_MAX_KM) {
+    return -99999;
+  }
+  return (int)((km * 54) / 100);
+}
+
+void
+nav_orbit_to_noun(const nav_orbit_t* orbit, int values[3])
+{
+  values[0] = orbit->open ? 99999 : nav_km_to_nm(orbit->apogee_km);
+  values[1] = nav_km_to_nm(orbit->perigee_km);
+  values[2] = orbit->period_sec / 60 > 99999L
+                ? 99999
+                : (int)(orbit->period_sec / 60);
 }
 
 /* ----------------------------------------------------------------
  * R30 (V82): Orbit parameter display
  * ----------------------------------------------------------------
- * Displays via noun 44: R1=apogee NM, R2=perigee NM, R3=TFF min.
+ * V82 starts a V16 N44 monitor: R1=apogee NM, R2=perigee NM, R3=TFF
+ * (MMBSS).  The solution is kept as mission times of the entry and
+ * perigee passages, so a refresh on which the CSM state vector is
+ * unchanged only subtracts the clock from them.
  */
 
+/* cs per TU, scaled by 2^-16 */
+#define NAV_CS_PER_TU_65536 AGC_FX_CONST(100.0 * NAV_TU_SEC / 65536.0)
+#define NAV_TFF_LIMIT_SEC (59L * 60L + 59L)
+
+int
+nav_r30_update(void)
+{
+  nav_fx_state_t s;
+  tff_t tff;
+  long t0;
+
+  if (nav_r30.status != 0 &&
+      memcmp(&nav_r30.sv, &nav_csm_state, sizeof(nav_csm_state)) == 0) {
+    return nav_r30.status > 0 ? 0 : -1;
+  }
+  nav_r30.sv = nav_csm_state;
+  nav_r30.solves++;
+  nav_r30.orbit.open = nav_compute_orbit(&nav_csm_state,
+                                         &nav_r30.orbit.apogee_km,
+                                         &nav_r30.orbit.perigee_km,
+                                         &nav_r30.orbit.period_sec);
+  nav_state_to_fx(&nav_csm_state, &s);
+  if (tff_solve(&s, &tff) < 0) {
+    nav_r30.status = -1;
+    return -1;
+  }
+  t0 = (long)nav_csm_state.time;
+  nav_r30.reaches = tff.reaches;
+  nav_r30.entry_cs = t0 + nav_fx_scale_long(tff.tff_tu, NAV_CS_PER_TU_65536);
+  nav_r30.perigee_cs =
+    t0 + nav_fx_scale_long(tff.perigee_tu, NAV_CS_PER_TU_65536);
+  nav_r30.period_cs = nav_fx_scale_long(tff.period_tu, NAV_CS_PER_TU_65536);
+  nav_r30.status = 1;
+  return 0;
+}
+
+/* TFF counts up to zero; -59B59 if the conic never reaches the entry
+ * altitude or is more than an hour from it */
+void
+nav_r30_to_noun(long now_cs, int values[3])
+{
+  long secs;
+
+  values[0] =
+    nav_r30.orbit.open ? 99999 : nav_km_to_nm(nav_r30.orbit.apogee_km);
+  values[1] = nav_km_to_nm(nav_r30.orbit.perigee_km);
+  secs = (nav_r30.entry_cs - now_cs + 99) / 100;
+  if (!nav_r30.reaches || secs > NAV_TFF_LIMIT_SEC) {
+    secs = NAV_TFF_LIMIT_SEC;
+  } else if (secs < 0) {
+    secs = 0;
+  }
+  values[2] = -(int)((secs / 60) * 1000 + secs % 60);
+}
+
+/* Negative before perigee; on a closed orbit, within half a period */
+void
+nav_r30_perigee_to_noun(long now_cs, int values[3])
+{
+  long dt;
+
+  dt = now_cs - nav_r30.perigee_cs;
+  if (nav_r30.period_cs > 0) {
+    dt %= nav_r30.period_cs;
+    if (dt > nav_r30.period_cs / 2) {
+      dt -= nav_r30.period_cs;
+    } else if (dt <= -nav_r30.period_cs / 2) {
+      dt += nav_r30.period_cs;
+    }
+  }
+  nav_time_to_noun(dt, values);
+}
+
 void
 program_r30_v82(void)
 {
-  long apogee_km, perigee_km, period_sec;
-  int apo_nm, peri_nm, tff_min;
+  nav_r30_update();
+  pinball_nvsub(16, 44);
+}
+
+/* ----------------------------------------------------------------
+ * V84: Orbit report
+ * ----------------------------------------------------------------
+ * Each V84 recomputes all slots and steps noun 46 to the next one,
+ * so the operator can page through CSM, LEM and the loaded vectors.
+ */
+
+int
+nav_orbit_report_update(void)
+{
+  agc_state_vector_t svs[NAV_ORBIT_SLOTS];
+  int count;
 
-  nav_compute_orbit(&nav_csm_state, &apogee_km, &perigee_km, &period_sec);
+  svs[NAV_SLOT_CSM] = nav_csm_state;
+  svs[NAV_SLOT_LEM] = nav_lem_state;
+  memcpy(&svs[NAV_SLOT_USER],
+         nav_user_states,
+         (size_t)nav_user_state_count * sizeof(nav_user_states[0]));
+  count = NAV_SLOT_USER + nav_user_state_count;
 
-  /* 1 km = 0.53996 NM ~ 54/100 */
-  apo_nm = (int)((apogee_km * 54) / 100);
-  peri_nm = (int)((perigee_km * 54) / 100);
-  tff_min = (int)(period_sec / 60);
+  nav_compute_orbits(svs, count, nav_orbit_report.orbit);
+  nav_orbit_report.count = count;
+  if (nav_orbit_report.cursor >= count) {
+    nav_orbit_report.cursor = -1;
+  }
+  return count;
+}
 
-  agc_write_erasable(5, 0, (agc_word_t)apo_nm);
-  agc_write_erasable(5, 1, (agc_word_t)peri_nm);
-  agc_write_erasable(5, 2, (agc_word_t)tff_min);
+void
+program_orbit_report_v84(void)
+{
+  int count;
 
-  pinball_nvsub(6, 44);
+  count = nav_orbit_report_update();
+  nav_orbit_report.cursor = (nav_orbit_report.cursor + 1) % count;
+  pinball_nvsub(6, 46);
 }
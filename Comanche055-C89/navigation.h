@@ -3,8 +3,12 @@
  *
  * Implements orbit parameter computation from a state vector
  * (position + velocity in Earth-centered inertial coordinates).
- * The R30 routine computes apogee, perigee, and orbital period,
- * storing results in erasable for noun 44 display.
+ * The R30 routine computes apogee, perigee, time of free fall and
+ * time from perigee (tff.h) for nouns 44 and 32.
+ *
+ * The orbit report (V84) runs the same computation over every state
+ * vector at once -- CSM, LEM and up to NAV_USER_STATES loaded by the
+ * operator -- and keeps the results for noun 46 and the web API.
  *
  * Maps to CONIC_SUBROUTINES.agc and R30.agc.
  *
@@ -15,6 +19,7 @@
 #define NAVIGATION_H
 
 #include "agc.h"
+#include "agc_fixed.h"
 
 typedef struct
 {
@@ -26,17 +31,210 @@ typedef struct
 extern agc_state_vector_t nav_csm_state;
 extern agc_state_vector_t nav_lem_state;
 
-#define MU_EARTH_KM3S2 398600L
-#define EARTH_RADIUS_KM 6371L
+/* Canonical units of the 64-bit routines: one Earth radius (DU) and
+ * the time sqrt(DU^3/mu) (TU), so mu = 1 and circular LEO speed is
+ * about 1 DU/TU.  The DU is the equatorial radius, and every altitude
+ * in the series is measured above it. */
+#define NAV_DU_KM 6378.137
+#define NAV_TU_SEC 806.8111238
+#define NAV_J2 1.08262668e-3
+/* ft/s per DU/TU, scaled by 2^-16 */
+#define NAV_FPS_PER_DU_TU                                                      \
+  AGC_FX_CONST(1000.0 * NAV_DU_KM / (NAV_TU_SEC * 0.3048 * 65536.0))
+
+/* Position (DU) and velocity (DU/TU) in agc_fixed.h Q40 */
+typedef struct
+{
+  agc_fx_t r[3];
+  agc_fx_t v[3];
+} nav_fx_state_t;
+
+/* Hard cap on t(x) evaluations per conic solve; typical solves take
+ * under ten */
+#define NAV_KEPLER_MAX_ITER 64
+
+/* Input limits for user state vectors, well inside the range of the
+ * DP state vector words */
+#define NAV_MAX_RADIUS_KM 16383L
+#define NAV_MAX_SPEED_MPS 30000L
+
+#define NAV_USER_STATES 6
+#define NAV_SLOT_CSM 0
+#define NAV_SLOT_LEM 1
+#define NAV_SLOT_USER 2
+#define NAV_ORBIT_SLOTS (NAV_SLOT_USER + NAV_USER_STATES)
+
+typedef struct
+{
+  long apogee_km;
+  long perigee_km;
+  long period_sec;
+  int open; /* Escape orbit: no apogee, period 0 */
+} nav_orbit_t;
+
+/* Results of the last batch, one slot per state vector */
+typedef struct
+{
+  int count;  /* Slots filled: CSM, LEM, then user vectors */
+  int cursor; /* Slot shown by noun 46, -1 before the first V84 */
+  nav_orbit_t orbit[NAV_ORBIT_SLOTS];
+} nav_orbit_report_t;
+
+/* R30 solution for the CSM, reused while its state vector is
+ * unchanged */
+typedef struct
+{
+  int status;            /* 0 unsolved, 1 solved, -1 no solution */
+  agc_state_vector_t sv; /* Vector it was solved from */
+  nav_orbit_t orbit;
+  int reaches;      /* The conic comes down to the entry altitude */
+  long entry_cs;    /* Mission time it does */
+  long perigee_cs;  /* Mission time of a perigee passage */
+  long period_cs;   /* 0 on an open orbit */
+  unsigned long solves;
+} nav_r30_t;
+
+extern agc_state_vector_t nav_user_states[NAV_USER_STATES];
+extern int nav_user_state_count;
+extern nav_orbit_report_t nav_orbit_report;
+extern nav_r30_t nav_r30;
 
 void
 nav_init(void);
 void
+nav_register_state(void);
+/* V82: solve R30 for the CSM and monitor noun 44 */
+void
 program_r30_v82(void);
+
+/* Solves R30 again if the CSM state vector changed; returns 0, or -1
+ * if there is no solution */
+int
+nav_r30_update(void);
+/* Noun 44 (HA, HP in NM, TFF in MMBSS) and noun 32 (time from
+ * perigee, h/m/s) at mission time now_cs */
+void
+nav_r30_to_noun(long now_cs, int values[3]);
 void
+nav_r30_perigee_to_noun(long now_cs, int values[3]);
+/* Apogee and perigee altitudes and period of the conic of sv.
+ * Returns 1 for an escape orbit, whose apogee and period are 0, else
+ * 0.  Perigee is negative on a conic that meets the Earth. */
+int
 nav_compute_orbit(const agc_state_vector_t* sv,
                   long* apogee_km,
                   long* perigee_km,
                   long* period_sec);
 
+/* Conversions between the DP state vector words, centiseconds and
+ * canonical units */
+void
+nav_state_to_fx(const agc_state_vector_t* sv, nav_fx_state_t* out);
+void
+nav_state_from_fx(const nav_fx_state_t* in, agc_state_vector_t* sv);
+agc_fx_t
+nav_cs_to_tu(long cs);
+/* Whether sv has never been loaded (zero position) */
+int
+nav_state_empty(const agc_state_vector_t* sv);
+/* Signed centiseconds as h/m/s display components */
+void
+nav_time_to_noun(long cs, int values[3]);
+
+/* Conic propagation (KEPLER): the state dt_tu after s0, for any dt
+ * and any conic.  Returns the iterations used, never more than
+ * NAV_KEPLER_MAX_ITER, or -1 if the solve did not converge within
+ * them or the result is out of range. */
+int
+nav_kepler_fx(const nav_fx_state_t* s0, agc_fx_t dt_tu, nav_fx_state_t* out);
+
+/* The conic of s0 at universal anomaly x, where x = 0 at s0 and
+ * dt/dx = r: the time from s0 in TU, the radius, and sigma = r.v,
+ * which is dr/dx.  One evaluation; callers searching x for a radius
+ * or for sigma = 0 bound their own loops. */
+void
+nav_kepler_x(const nav_fx_state_t* s0,
+             agc_fx_t x,
+             agc_fx_t* t,
+             agc_fx_t* r,
+             agc_fx_t* sigma);
+
+/* Propagates sv along its conic to time_cs in one call, with the time
+ * tag of out set to time_cs (out may be sv).  Returns as
+ * nav_kepler_fx(), and -1 also if a position component would exceed
+ * NAV_MAX_RADIUS_KM. */
+int
+nav_kepler(const agc_state_vector_t* sv,
+           agc_dp_t time_cs,
+           agc_state_vector_t* out);
+
+/* Conic targeting (LAMBERT): the departure and arrival velocities
+ * that carry r1 to r2 in dt_tu, the short way round (under 180
+ * degrees) unless long_way is set.  Transfers of up to one
+ * revolution are solved; iterations is -1 if there is none, if r1
+ * and r2 are (nearly) opposite, or if dt_tu is not positive. */
+typedef struct
+{
+  agc_fx_t r1[3];
+  agc_fx_t r2[3];
+  agc_fx_t dt_tu;
+  int long_way;
+  agc_fx_t v1[3]; /* Departure velocity (out) */
+  agc_fx_t v2[3]; /* Arrival velocity (out) */
+  int iterations; /* Evaluations used, or -1 (out) */
+} nav_lambert_t;
+
+#define NAV_LAMBERT_MAX_ITER 64
+
+/* Solves one transfer; returns p->iterations */
+int
+nav_lambert_fx(nav_lambert_t* p);
+
+/* Solves count transfers in order and returns how many succeeded.
+ * Consecutive entries with the same r1, r2 and long_way, as in a
+ * sweep over dt, reuse the geometry and start from the previous
+ * solutions.  No state is kept between calls, so separate slices of
+ * one set may be solved independently. */
+int
+nav_lambert_batch(nav_lambert_t* set, int count);
+
+/* The same solve in double precision, for checking; DU and DU/TU */
+int
+nav_lambert_double(const double r1[3],
+                   const double r2[3],
+                   double dt_tu,
+                   int long_way,
+                   double v1[3],
+                   double v2[3]);
+
+/* Computes the orbits of count state vectors into out[0..count-1] */
+void
+nav_compute_orbits(const agc_state_vector_t* svs, int count, nav_orbit_t* out);
+
+/* Converts an orbit to the noun 46 registers: HA and HP in NM,
+ * period in minutes, each held to five digits; an open orbit shows
+ * HA 99999 */
+void
+nav_orbit_to_noun(const nav_orbit_t* orbit, int values[3]);
+
+/* Adds a user state vector from ECI position (km) and velocity (m/s).
+ * Returns its report slot, or -1 if the table is full or a component
+ * is outside the input limits. */
+int
+nav_load_user_state(const long r_km[3], const long v_mps[3]);
+/* Replaces the CSM or LEM state vector (slot NAV_SLOT_CSM or
+ * NAV_SLOT_LEM) the same way; returns 0 or -1 */
+int
+nav_load_vehicle_state(int slot, const long r_km[3], const long v_mps[3]);
+void
+nav_clear_user_states(void);
+
+/* Recomputes every slot of nav_orbit_report; returns the slot count */
+int
+nav_orbit_report_update(void);
+
+/* V84: recompute the report and show the next slot on noun 46 */
+void
+program_orbit_report_v84(void);
+
 #endif /* NAVIGATION_H */
@@ -5,9 +5,11 @@
  */
 
 #include "agc.h"
+#include "agc_context.h"
 #include "agc_cpu.h"
 #include "alarm.h"
 #include "dsky.h"
+#include "monitor.h"
 #include "navigation.h"
 #include "pinball.h"
 #include "programs.h"
@@ -33,6 +35,8 @@ static void
 verb_change_program(void);
 static void
 verb_orbit_display(void);
+static void
+verb_orbit_report(void);
 
 /* ----------------------------------------------------------------
  * State
@@ -50,6 +54,7 @@ int pinball_monitor_noun = 0;
 int pinball_endidle = 0;
 
 static int proceed_flag = 0;
+static int monitor_slot = -1; /* DSKY monitor in monitor_table */
 
 /* ----------------------------------------------------------------
  * Init
@@ -64,11 +69,29 @@ pinball_init(void)
   pinball_mode = PINBALL_MODE_IDLE;
   pinball_data_reg = 0;
   pinball_monitor_active = 0;
+  monitor_slot = -1;
   pinball_endidle = 0;
   proceed_flag = 0;
   memset(pinball_inbuf, 0, sizeof(pinball_inbuf));
 }
 
+void
+pinball_register_state(void)
+{
+  agc_context_register(&pinball_verb, sizeof(pinball_verb));
+  agc_context_register(&pinball_noun, sizeof(pinball_noun));
+  agc_context_register(pinball_inbuf, sizeof(pinball_inbuf));
+  agc_context_register(&pinball_incount, sizeof(pinball_incount));
+  agc_context_register(&pinball_mode, sizeof(pinball_mode));
+  agc_context_register(&pinball_data_reg, sizeof(pinball_data_reg));
+  agc_context_register(&pinball_monitor_active, sizeof(pinball_monitor_active));
+  agc_context_register(&pinball_monitor_verb, sizeof(pinball_monitor_verb));
+  agc_context_register(&pinball_monitor_noun, sizeof(pinball_monitor_noun));
+  agc_context_register(&pinball_endidle, sizeof(pinball_endidle));
+  agc_context_register(&proceed_flag, sizeof(proceed_flag));
+  agc_context_register(&monitor_slot, sizeof(monitor_slot));
+}
+
 /* ----------------------------------------------------------------
  * Display helpers
  * ---------------------------------------------------------------- */
@@ -212,62 +235,14 @@ inbuf_to_int(void)
 }
 
 /* ----------------------------------------------------------------
- * Noun data access
+ * Operator error
  * ---------------------------------------------------------------- */
 
-static int
-noun_get_value(int noun, int component)
+static void
+operator_error(void)
 {
-  switch (noun) {
-    case 36: /* Mission elapsed time */
-    {
-      long total_cs = (long)agc_time2 * 16384L + (long)agc_time1;
-      long total_secs = total_cs / 100;
-      switch (component) {
-        case 1:
-          return (int)(total_secs / 3600);
-        case 2:
-          return (int)((total_secs % 3600) / 60);
-        case 3:
-          return (int)(total_secs % 60);
-      }
-    } break;
-
-    case 1: /* Specified address value */
-      return 0;
-
-    case 9: /* Alarm codes */
-      if (component == 1) {
-        return agc_alarm_code;
-      }
-      return 0;
-
-    case 43: /* Latitude, longitude, altitude (stub) */
-      switch (component) {
-        case 1:
-          return 28553; /* ~28.553 N (KSC) */
-        case 2:
-          return -80649; /* ~-80.649 W (KSC) */
-        case 3:
-          return 0;
-      }
-      break;
-
-    case 44: /* Apogee, perigee, TFF (filled by R30) */
-      switch (component) {
-        case 1:
-          return agc_read_erasable(5, 0);
-        case 2:
-          return agc_read_erasable(5, 1);
-        case 3:
-          return agc_read_erasable(5, 2);
-      }
-      break;
-
-    default:
-      break;
-  }
-  return 0;
+  agc_channels[CHAN_DSALMOUT] |= BIT12;
+  dsky_display.light_opr_err = 1;
 }
 
 /* ----------------------------------------------------------------
@@ -308,9 +283,11 @@ dispatch_verb(void)
     case 82:
       verb_orbit_display();
       break;
+    case 84:
+      verb_orbit_report();
+      break;
     default:
-      agc_channels[CHAN_DSALMOUT] |= BIT12;
-      dsky_display.light_opr_err = 1;
+      operator_error();
       break;
   }
 }
@@ -322,52 +299,77 @@ dispatch_verb(void)
 static void
 verb_display_octal(void)
 {
-  int n = pinball_noun;
+  int v[NOUN_MAX_COMPONENTS];
+  if (noun_fetch(pinball_noun, v) == NULL) {
+    operator_error();
+    return;
+  }
   if (pinball_verb >= 1) {
-    pinball_display_octal(1, noun_get_value(n, 1));
+    pinball_display_octal(1, v[0]);
   }
   if (pinball_verb >= 4) {
-    pinball_display_octal(2, noun_get_value(n, 2));
+    pinball_display_octal(2, v[1]);
   }
 }
 
-static void
-verb_display_decimal(void)
+/* Shows the first `count` components; -1 for an undefined noun */
+static int
+display_noun_decimal(int noun, int count)
 {
-  int n = pinball_noun;
-  if (pinball_verb == 5 || pinball_verb == 6) {
-    pinball_display_val(1, noun_get_value(n, 1), 1);
-    pinball_display_val(2, noun_get_value(n, 2), 1);
+  const noun_table_entry_t* entry;
+  int v[NOUN_MAX_COMPONENTS];
+  int i;
+
+  entry = noun_fetch(noun, v);
+  if (entry == NULL) {
+    operator_error();
+    return -1;
   }
-  if (pinball_verb == 6) {
-    pinball_display_val(3, noun_get_value(n, 3), 1);
+  for (i = 0; i < count; i++) {
+    pinball_display_val(i + 1, v[i], entry->is_signed);
   }
+  return 0;
 }
 
 static void
-monitor_task(void)
+verb_display_decimal(void)
 {
-  if (pinball_monitor_active) {
-    int n = pinball_monitor_noun;
-    pinball_display_val(1, noun_get_value(n, 1), 1);
-    pinball_display_val(2, noun_get_value(n, 2), 1);
-    pinball_display_val(3, noun_get_value(n, 3), 1);
-    waitlist_add(ONE_SEC, monitor_task);
+  display_noun_decimal(pinball_noun, pinball_verb == 6 ? 3 : 2);
+}
+
+/* DSKY consumer of the V16 monitor; RSET or V37 end it */
+static void
+monitor_to_dsky(int slot,
+                const noun_table_entry_t* entry,
+                const int values[NOUN_MAX_COMPONENTS])
+{
+  if (!pinball_monitor_active) {
+    monitor_stop(slot);
+    return;
   }
+  pinball_display_val(1, values[0], entry->is_signed);
+  pinball_display_val(2, values[1], entry->is_signed);
+  pinball_display_val(3, values[2], entry->is_signed);
 }
 
 static void
 verb_monitor_decimal(void)
 {
+  monitor_stop(monitor_slot);
+  monitor_slot = -1;
   pinball_monitor_active = 1;
   pinball_monitor_verb = pinball_verb;
   pinball_monitor_noun = pinball_noun;
 
-  pinball_display_val(1, noun_get_value(pinball_noun, 1), 1);
-  pinball_display_val(2, noun_get_value(pinball_noun, 2), 1);
-  pinball_display_val(3, noun_get_value(pinball_noun, 3), 1);
-
-  waitlist_add(ONE_SEC, monitor_task);
+  monitor_slot = monitor_start(pinball_noun, ONE_SEC, monitor_to_dsky);
+  if (monitor_slot < 0) {
+    pinball_monitor_active = 0;
+    operator_error();
+    return;
+  }
+  monitor_to_dsky(monitor_slot,
+                  noun_lookup(pinball_noun),
+                  monitor_table[monitor_slot].values);
 }
 
 static void
@@ -447,6 +449,12 @@ verb_orbit_display(void)
   program_r30_v82();
 }
 
+static void
+verb_orbit_report(void)
+{
+  program_orbit_report_v84();
+}
+
 /* ----------------------------------------------------------------
  * NVSUB: internal verb-noun call
  * ---------------------------------------------------------------- */
@@ -487,6 +495,8 @@ pinball_keypress(int keycode)
   if (keycode == DSKY_KEY_RSET) {
     alarm_reset();
     pinball_monitor_active = 0;
+    monitor_stop(monitor_slot);
+    monitor_slot = -1;
     dsky_display.light_opr_err = 0;
     dsky_display.light_restart = 0;
     return;
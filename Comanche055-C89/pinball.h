@@ -45,6 +45,8 @@ extern int pinball_endidle;
 void
 pinball_init(void);
 void
+pinball_register_state(void);
+void
 pinball_keypress(int keycode);
 int
 pinball_nvsub(int verb, int noun);
@@ -9,6 +9,8 @@
 #include "executive.h"
 #include "pinball.h"
 #include "programs.h"
+#include "rte_search.h"
+#include "tpi_search.h"
 
 /* ----------------------------------------------------------------
  * P00: CMC Idling
@@ -48,6 +50,14 @@ program_change(int prognum)
       agc_current_program = 0;
       break;
 
+    case 17: /* P17  -- TPI search */
+      program_p17();
+      break;
+
+    case 37: /* P37  -- Return to Earth */
+      program_p37();
+      break;
+
     case 6:  /* P06  -- Power down */
     case 11: /* P11  -- Earth orbit insertion monitor */
     case 20: /* P20  -- Rendezvous navigation */
@@ -62,7 +72,6 @@ program_change(int prognum)
     case 33: /* P33  -- CDH */
     case 34: /* P34  -- Transfer phase initiation */
     case 35: /* P35  -- Transfer phase midcourse */
-    case 37: /* P37  -- Return to Earth */
     case 38: /* P38  -- Stable orbit rendezvous */
     case 39: /* P39  -- Stable orbit rendezvous */
     case 40: /* P40  -- SPS thrusting */
@@ -0,0 +1,400 @@
+/*
+ * rte_search.c -- P37 return to Earth: minimum delta-V abort search.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#include "agc.h"
+#include "agc_context.h"
+#include "agc_cpu.h"
+#include "agc_fixed.h"
+#include "alarm.h"
+#include "executive.h"
+#include "navigation.h"
+#include "pinball.h"
+#include "rte_search.h"
+#include "waitlist.h"
+
+#include <math.h>
+#include <string.h>
+
+#define RTE_PRIORITY PRIO3
+
+#define RTE_RAD_PER_DEG (3.14159265358979323846 / 180.0)
+#define RTE_EI_RADIUS AGC_FX_CONST((NAV_DU_KM + RTE_EI_ALT_KM) / NAV_DU_KM)
+
+/* How far the state vector may stray from the conic the rows were
+ * solved on before they are thrown away: two steps of the velocity
+ * words (3.9 m/s each), and about what that grows to over the lead */
+#define RTE_SOURCE_TOL_R AGC_FX_CONST(1.0 / 1024.0)
+#define RTE_SOURCE_TOL_V AGC_FX_CONST(1.0 / 1024.0)
+
+rte_search_t rte_search;
+rte_row_t rte_rows[RTE_MAX_ABORTS];
+
+/* Lambert problems of the abort time in hand; filled and used within
+ * one dispatch */
+static nav_lambert_t rte_transfers[RTE_MAX_TARGETS];
+
+static void
+rte_job(void);
+static void
+rte_task(void);
+
+void
+rte_init(void)
+{
+  memset(&rte_search, 0, sizeof(rte_search));
+  memset(rte_rows, 0, sizeof(rte_rows));
+  rte_search.status = RTE_IDLE;
+  waitlist_cancel(rte_task);
+}
+
+void
+rte_register_state(void)
+{
+  agc_context_register(&rte_search, sizeof(rte_search));
+  agc_context_register(rte_rows, sizeof(rte_rows));
+}
+
+/* ----------------------------------------------------------------
+ * Source state
+ * ---------------------------------------------------------------- */
+
+/* Whether the CSM state vector still lies on the source conic */
+static int
+rte_source_agrees(const rte_search_t* s)
+{
+  nav_fx_state_t now, predicted;
+  int i;
+
+  if (!s->source_valid) {
+    return 0;
+  }
+  nav_state_to_fx(&nav_csm_state, &now);
+  if (nav_kepler_fx(&s->source,
+                    nav_cs_to_tu((long)nav_csm_state.time - s->source_cs),
+                    &predicted) < 0) {
+    return 0;
+  }
+  for (i = 0; i < 3; i++) {
+    if (agc_fx_abs(predicted.r[i] - now.r[i]) > RTE_SOURCE_TOL_R ||
+        agc_fx_abs(predicted.v[i] - now.v[i]) > RTE_SOURCE_TOL_V) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Whether rows solved under a keep their meaning under b: everything
+ * but the start of the window matches */
+static int
+rte_same_grid(const rte_params_t* a, const rte_params_t* b)
+{
+  return a->step_cs == b->step_cs &&
+         a->range_first_deg == b->range_first_deg &&
+         a->range_step_deg == b->range_step_deg && a->ranges == b->ranges &&
+         a->flight_first_cs == b->flight_first_cs &&
+         a->flight_step_cs == b->flight_step_cs && a->flights == b->flights;
+}
+
+static int
+rte_setup(rte_search_t* s, const rte_params_t* p)
+{
+  double angle;
+  int i;
+
+  if (p->aborts < 1 || p->aborts > RTE_MAX_ABORTS || p->step_cs <= 0 ||
+      p->first_cs < 0 || p->first_cs % p->step_cs != 0 || p->ranges < 1 ||
+      p->ranges > RTE_MAX_RANGES || p->range_first_deg <= 0 ||
+      p->range_step_deg < 0 ||
+      p->range_first_deg + (p->ranges - 1) * p->range_step_deg >= 180 ||
+      p->flights < 1 || p->ranges * p->flights > RTE_MAX_TARGETS ||
+      p->flight_first_cs <= 0 || p->flight_step_cs < 0 ||
+      nav_state_empty(&nav_csm_state)) {
+    return -1;
+  }
+
+  if (!rte_same_grid(&s->params, p) || !rte_source_agrees(s)) {
+    nav_state_to_fx(&nav_csm_state, &s->source);
+    s->source_cs = (long)nav_csm_state.time;
+    s->source_valid = 1;
+    memset(rte_rows, 0, sizeof(rte_rows));
+  }
+
+  s->params = *p;
+  for (i = 0; i < p->ranges; i++) {
+    angle = (p->range_first_deg + i * p->range_step_deg) * RTE_RAD_PER_DEG;
+    s->cos_range[i] = agc_fx_from_double(cos(angle));
+    s->sin_range[i] = agc_fx_from_double(sin(angle));
+  }
+  s->next_row = 0;
+  s->announce = 0;
+  s->found = 0;
+  s->solved = 0;
+  s->reused = 0;
+  s->rejected = 0;
+  s->status = RTE_RUNNING;
+  return 0;
+}
+
+/* ----------------------------------------------------------------
+ * Abort times
+ * ---------------------------------------------------------------- */
+
+/* Solves every target from the abort at row->option.tig_cs */
+static void
+rte_solve_row(rte_search_t* s, rte_row_t* row)
+{
+  const rte_params_t* p;
+  nav_fx_state_t abort;
+  agc_fx_t u[3], h[3], w[3], d[3], target[3];
+  agc_fx_t lo, hi, sin_gamma, dv;
+  nav_lambert_t* t;
+  int n, i, j, k;
+
+  p = &s->params;
+  if (nav_kepler_fx(&s->source,
+                    nav_cs_to_tu(row->option.tig_cs - s->source_cs),
+                    &abort) < 0) {
+    s->rejected += p->ranges * p->flights;
+    return;
+  }
+
+  /* In-plane frame at the abort point: radial u, downrange w */
+  agc_fx_vec_scale(agc_fx_div(AGC_FX_ONE, agc_fx_vec_mag(abort.r)), abort.r, u);
+  agc_fx_vec_cross(abort.r, abort.v, h);
+  agc_fx_vec_cross(h, u, w);
+  agc_fx_vec_scale(agc_fx_div(AGC_FX_ONE, agc_fx_vec_mag(h)), w, w);
+
+  /* Flight times vary fastest, so the batch sees runs of one r2 */
+  n = 0;
+  for (i = 0; i < p->ranges; i++) {
+    for (k = 0; k < 3; k++) {
+      target[k] = agc_fx_mul(RTE_EI_RADIUS,
+                             agc_fx_mul(s->cos_range[i], u[k]) +
+                               agc_fx_mul(s->sin_range[i], w[k]));
+    }
+    for (j = 0; j < p->flights; j++) {
+      t = &rte_transfers[n++];
+      memcpy(t->r1, abort.r, sizeof(t->r1));
+      memcpy(t->r2, target, sizeof(t->r2));
+      t->dt_tu = nav_cs_to_tu(p->flight_first_cs + (long)j * p->flight_step_cs);
+      t->long_way = 0;
+    }
+  }
+
+  nav_lambert_batch(rte_transfers, n);
+
+  lo = agc_fx_from_double(sin(RTE_GAMMA_MIN_DEG * RTE_RAD_PER_DEG));
+  hi = agc_fx_from_double(sin(RTE_GAMMA_MAX_DEG * RTE_RAD_PER_DEG));
+  for (k = 0; k < n; k++) {
+    t = &rte_transfers[k];
+    if (t->iterations < 0) {
+      s->rejected++;
+      continue;
+    }
+    sin_gamma =
+      agc_fx_div(agc_fx_vec_dot(t->r2, t->v2),
+                 agc_fx_mul(agc_fx_vec_mag(t->r2), agc_fx_vec_mag(t->v2)));
+    if (sin_gamma < lo || sin_gamma > hi) {
+      s->rejected++;
+      continue;
+    }
+
+    agc_fx_vec_sub(t->v1, abort.v, d);
+    dv = agc_fx_vec_mag(d);
+    if (row->found && dv >= row->option.dv) {
+      continue;
+    }
+    i = k / p->flights;
+    j = k % p->flights;
+    row->found = 1;
+    row->option.range_deg = p->range_first_deg + i * p->range_step_deg;
+    row->option.flight_cs = p->flight_first_cs + (long)j * p->flight_step_cs;
+    row->option.dv = dv;
+    row->option.v_ei = agc_fx_vec_mag(t->v2);
+    row->option.sin_gamma = sin_gamma;
+  }
+}
+
+/* Takes abort time index from the kept rows, or solves it */
+static void
+rte_row(rte_search_t* s, int index)
+{
+  rte_row_t* row;
+  long tig;
+
+  tig = s->params.first_cs + (long)index * s->params.step_cs;
+  row = &rte_rows[(tig / s->params.step_cs) % RTE_MAX_ABORTS];
+  if (row->valid && row->option.tig_cs == tig) {
+    s->reused++;
+  } else {
+    memset(row, 0, sizeof(*row));
+    row->valid = 1;
+    row->option.tig_cs = tig;
+    rte_solve_row(s, row);
+    s->solved++;
+  }
+
+  if (row->found && (!s->found || row->option.dv < s->best.dv)) {
+    s->found = 1;
+    s->best = row->option;
+  }
+}
+
+/* ----------------------------------------------------------------
+ * Search
+ * ---------------------------------------------------------------- */
+
+static void
+rte_finish(rte_search_t* s)
+{
+  s->status = s->found ? RTE_DONE : RTE_FAILED;
+}
+
+int
+rte_search_run(const rte_params_t* params)
+{
+  if (rte_search.status == RTE_RUNNING) {
+    return -1;
+  }
+  if (rte_setup(&rte_search, params) < 0) {
+    return -1;
+  }
+  for (; rte_search.next_row < params->aborts; rte_search.next_row++) {
+    rte_row(&rte_search, rte_search.next_row);
+  }
+  rte_finish(&rte_search);
+  return 0;
+}
+
+int
+rte_search_start(const rte_params_t* params)
+{
+  if (rte_search.status == RTE_RUNNING) {
+    return -1;
+  }
+  if (rte_setup(&rte_search, params) < 0) {
+    return -1;
+  }
+  if (exec_novac(RTE_PRIORITY, rte_job) < 0) {
+    rte_search.status = RTE_IDLE;
+    return -1;
+  }
+  return 0;
+}
+
+static void
+rte_job(void)
+{
+  rte_row(&rte_search, rte_search.next_row);
+  rte_search.next_row++;
+  if (rte_search.next_row < rte_search.params.aborts) {
+    exec_changejob();
+    return;
+  }
+
+  rte_finish(&rte_search);
+  if (rte_search.announce && agc_current_program == 37) {
+    if (rte_search.status == RTE_DONE) {
+      pinball_nvsub(6, 33);
+    } else {
+      alarm_set(01703);
+    }
+  }
+  rte_search.announce = 0;
+  exec_endofjob();
+}
+
+/* ----------------------------------------------------------------
+ * Display
+ * ---------------------------------------------------------------- */
+
+void
+rte_time_to_noun(const rte_search_t* s, int values[3])
+{
+  if (s->found) {
+    nav_time_to_noun(s->best.tig_cs, values);
+  }
+}
+
+void
+rte_entry_to_noun(const rte_search_t* s, int values[3])
+{
+  double gamma;
+
+  if (!s->found) {
+    return;
+  }
+  values[0] =
+    (int)(agc_fx_mul(s->best.dv, NAV_FPS_PER_DU_TU) >> (AGC_FX_FRAC_BITS - 16));
+  values[1] = (int)(agc_fx_mul(s->best.v_ei, NAV_FPS_PER_DU_TU) >>
+                    (AGC_FX_FRAC_BITS - 16));
+  gamma = asin(agc_fx_to_double(s->best.sin_gamma)) / RTE_RAD_PER_DEG * 100.0;
+  values[2] = (int)(gamma < 0 ? gamma - 0.5 : gamma + 0.5);
+}
+
+/* ----------------------------------------------------------------
+ * P37
+ * ---------------------------------------------------------------- */
+
+/* The default grid, from the first abort time a lead ahead of now */
+static void
+rte_default_params(rte_params_t* params)
+{
+  long now;
+
+  now = (long)agc_time2 * 16384L + (long)agc_time1;
+  params->step_cs = RTE_STEP_CS;
+  params->first_cs =
+    (now + RTE_LEAD_CS + RTE_STEP_CS - 1) / RTE_STEP_CS * RTE_STEP_CS;
+  params->aborts = RTE_ABORTS;
+  params->range_first_deg = RTE_RANGE_FIRST_DEG;
+  params->range_step_deg = RTE_RANGE_STEP_DEG;
+  params->ranges = RTE_RANGES;
+  params->flight_first_cs = RTE_FLIGHT_FIRST_CS;
+  params->flight_step_cs = RTE_FLIGHT_STEP_CS;
+  params->flights = RTE_FLIGHTS;
+}
+
+/* Reruns the search while P37 is selected, once the window has moved
+ * on or the state vector left the source conic */
+static void
+rte_task(void)
+{
+  rte_params_t params;
+
+  if (agc_current_program != 37) {
+    return;
+  }
+  waitlist_add(RTE_RECHECK_CS, rte_task);
+  if (rte_search.status == RTE_RUNNING) {
+    return;
+  }
+  rte_default_params(&params);
+  if (params.first_cs != rte_search.params.first_cs ||
+      !rte_source_agrees(&rte_search)) {
+    rte_search_start(&params);
+  }
+}
+
+void
+program_p37(void)
+{
+  rte_params_t params;
+
+  pinball_show_prog(37);
+  agc_current_program = 37;
+
+  if (rte_search.status != RTE_RUNNING) {
+    rte_default_params(&params);
+    if (rte_search_start(&params) < 0) {
+      alarm_set(01703);
+      return;
+    }
+  }
+  rte_search.announce = 1;
+  waitlist_cancel(rte_task);
+  waitlist_add(RTE_RECHECK_CS, rte_task);
+}
@@ -0,0 +1,144 @@
+/*
+ * rte_search.h -- P37 return to Earth: minimum delta-V abort search.
+ *
+ * The search covers a grid of abort times and entry interface (EI)
+ * targets.  A target is a point on the EI sphere, in the CSM orbit
+ * plane, a given range angle beyond the abort point, reached after a
+ * given flight time.  For each abort time the CSM is taken along its
+ * conic to the abort point, and one Lambert batch solves every target
+ * from there.  The cheapest abort whose flight path angle at EI falls
+ * inside the entry corridor wins; ties go to the earlier abort, then
+ * the earlier target.
+ *
+ * The search job solves one abort time per dispatch and keeps each
+ * row's best target, by abort time, for the next search.  A later
+ * search reuses those rows as long as the CSM state vector still
+ * agrees with the conic the rows were solved on, so a rerun only
+ * solves the abort times that slid into the window.  While P37 is
+ * selected, a waitlist task reruns the search when the window moves
+ * on or the state vector is updated.
+ *
+ * Maps to P37,P70.agc.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifndef RTE_SEARCH_H
+#define RTE_SEARCH_H
+
+#include "agc_fixed.h"
+#include "navigation.h"
+
+#define RTE_MAX_ABORTS 16
+#define RTE_MAX_RANGES 16
+#define RTE_MAX_TARGETS 64 /* Ranges times flight times */
+
+/* P37 defaults: an abort every 5 minutes for an hour, on multiples of
+ * 5 minutes at least ten minutes ahead; EI 60 to 165 degrees on, 15
+ * to 50 minutes later */
+#define RTE_LEAD_CS 60000L
+#define RTE_STEP_CS 30000L
+#define RTE_ABORTS 12
+#define RTE_RANGE_FIRST_DEG 60
+#define RTE_RANGE_STEP_DEG 15
+#define RTE_RANGES 8
+#define RTE_FLIGHT_FIRST_CS 90000L
+#define RTE_FLIGHT_STEP_CS 30000L
+#define RTE_FLIGHTS 8
+
+/* Entry interface (400,000 ft) and the flight path angle corridor
+ * there: steeper undershoots, shallower overshoots */
+#define RTE_EI_ALT_KM 121.92
+#define RTE_GAMMA_MIN_DEG -7.2
+#define RTE_GAMMA_MAX_DEG -1.5
+
+/* Waitlist period of the rerun check while P37 is selected */
+#define RTE_RECHECK_CS 200
+
+#define RTE_IDLE 0
+#define RTE_RUNNING 1
+#define RTE_DONE 2
+#define RTE_FAILED 3 /* No abort inside the corridor */
+
+typedef struct
+{
+  long first_cs; /* Abort time of row 0, a multiple of step_cs */
+  long step_cs;  /* Between abort times */
+  int aborts;    /* 1..RTE_MAX_ABORTS */
+  int range_first_deg;
+  int range_step_deg;
+  int ranges; /* 1..RTE_MAX_RANGES, all under 180 degrees */
+  long flight_first_cs;
+  long flight_step_cs;
+  int flights; /* ranges * flights <= RTE_MAX_TARGETS */
+} rte_params_t;
+
+typedef struct
+{
+  long tig_cs;
+  int range_deg;
+  long flight_cs;
+  agc_fx_t dv;        /* Abort delta-V, DU/TU */
+  agc_fx_t v_ei;      /* Speed at EI */
+  agc_fx_t sin_gamma; /* Sine of the flight path angle at EI */
+} rte_option_t;
+
+/* Best target of one abort time, as kept between searches */
+typedef struct
+{
+  int valid;
+  int found; /* 0: no target of this abort is inside the corridor */
+  rte_option_t option;
+} rte_row_t;
+
+typedef struct
+{
+  int status;
+  rte_params_t params;
+  nav_fx_state_t source; /* CSM state the rows are solved from */
+  long source_cs;
+  int source_valid;
+  agc_fx_t cos_range[RTE_MAX_RANGES];
+  agc_fx_t sin_range[RTE_MAX_RANGES];
+  int next_row;
+  int announce; /* Show noun 33 when done (started by P37) */
+
+  int found;
+  rte_option_t best;
+
+  int solved;   /* Abort times solved by this search */
+  int reused;   /* Taken from an earlier search */
+  int rejected; /* Targets with no transfer or outside the corridor */
+} rte_search_t;
+
+extern rte_search_t rte_search;
+extern rte_row_t rte_rows[RTE_MAX_ABORTS];
+
+void
+rte_init(void);
+void
+rte_register_state(void);
+
+/* Starts a background search from the CSM state vector.  Returns -1
+ * if one is running, the parameters are out of range, or the state
+ * vector is empty. */
+int
+rte_search_start(const rte_params_t* params);
+
+/* Runs a whole search at once, as the job would */
+int
+rte_search_run(const rte_params_t* params);
+
+/* Noun 33 (TIG of the abort, h/m/s) and noun 60 (delta-V and speed at
+ * EI in ft/s, flight path angle at EI in 0.01 degree) */
+void
+rte_time_to_noun(const rte_search_t* s, int values[3]);
+void
+rte_entry_to_noun(const rte_search_t* s, int values[3]);
+
+/* P37: search the default grid from the current time, then show noun
+ * 33, or alarm 01703 if no abort is inside the corridor */
+void
+program_p37(void);
+
+#endif /* RTE_SEARCH_H */
@@ -9,25 +9,197 @@
 #include "alarm.h"
 #include "dsky.h"
 #include "executive.h"
+#include "integration.h"
+#include "latlong.h"
+#include "monitor.h"
+#include "navigation.h"
 #include "pinball.h"
+#include "rte_search.h"
 #include "service.h"
 #include "timer.h"
+#include "tpi_search.h"
 #include "waitlist.h"
 
+#include <stddef.h>
 #include <string.h>
 
 /* ----------------------------------------------------------------
  * Noun table
  * ---------------------------------------------------------------- */
 
+static void
+noun_fetch_met(int values[NOUN_MAX_COMPONENTS]);
+static void
+noun_fetch_position(int values[NOUN_MAX_COMPONENTS]);
+static void
+noun_fetch_orbits(int values[NOUN_MAX_COMPONENTS]);
+static void
+noun_fetch_tpi_time(int values[NOUN_MAX_COMPONENTS]);
+static void
+noun_fetch_tpi_dv(int values[NOUN_MAX_COMPONENTS]);
+static void
+noun_fetch_rte_time(int values[NOUN_MAX_COMPONENTS]);
+static void
+noun_fetch_rte_ei(int values[NOUN_MAX_COMPONENTS]);
+static void
+noun_fetch_r30(int values[NOUN_MAX_COMPONENTS]);
+static void
+noun_fetch_perigee(int values[NOUN_MAX_COMPONENTS]);
+
 const noun_table_entry_t noun_table[] = {
-  /* noun, components, signed, scale_factor */
-  { 1, 3, 0, 0 },  { 9, 3, 0, 0 },  { 36, 3, 1, 0 },
-  { 43, 3, 1, 0 }, { 44, 3, 1, 0 }, { 65, 3, 1, 0 }
+  /* noun, components, signed, scale, ebank, address, fetch */
+  { 1, 3, 0, 0, 0, NOUN_NO_ADDRESS, NULL }, /* Address */
+  { 9, 3, 0, NOUN_SCALE_WHOLE, EBANK_UNSWITCHED, FAILREG, NULL }, /* Alarms */
+  { 20, 3, 0, NOUN_SCALE_CDU_DEG, EBANK_UNSWITCHED, CDUX, NULL }, /* ICDU */
+  { 32, 3, 1, 0, 0, NOUN_NO_ADDRESS, noun_fetch_perigee },  /* From perigee */
+  { 33, 3, 1, 0, 0, NOUN_NO_ADDRESS, noun_fetch_rte_time }, /* TIG of abort */
+  { 36, 3, 1, 0, 0, NOUN_NO_ADDRESS, noun_fetch_met },      /* GET h/m/s */
+  { 37, 3, 1, 0, 0, NOUN_NO_ADDRESS, noun_fetch_tpi_time }, /* TIG of TPI */
+  { 43, 3, 1, 0, 0, NOUN_NO_ADDRESS, noun_fetch_position }, /* Lat/lng/alt */
+  { 44, 3, 1, 0, 0, NOUN_NO_ADDRESS, noun_fetch_r30 },      /* R30 HA/HP/TFF */
+  { 46, 3, 1, 0, 0, NOUN_NO_ADDRESS, noun_fetch_orbits },   /* Orbit report */
+  { 58, 3, 1, 0, 0, NOUN_NO_ADDRESS, noun_fetch_tpi_dv },   /* HP/DV TPI/TPF */
+  { 60, 3, 1, 0, 0, NOUN_NO_ADDRESS, noun_fetch_rte_ei },   /* DV/VPRED/GAMMA */
+  { 65, 3, 1, 0, 0, NOUN_NO_ADDRESS, noun_fetch_met }       /* Sampled time */
 };
 
 const int noun_table_size = sizeof(noun_table) / sizeof(noun_table[0]);
 
+/* Noun number to table row, filled on first use */
+static const noun_table_entry_t* noun_index[NOUN_MAX];
+static int noun_index_ready = 0;
+
+static void
+noun_fetch_met(int values[NOUN_MAX_COMPONENTS])
+{
+  long total_secs = ((long)agc_time2 * 16384L + (long)agc_time1) / 100;
+  values[0] = (int)(total_secs / 3600);
+  values[1] = (int)((total_secs % 3600) / 60);
+  values[2] = (int)(total_secs % 60);
+}
+
+/* CSM position over the Earth, zero without a state vector */
+static void
+noun_fetch_position(int values[NOUN_MAX_COMPONENTS])
+{
+  latlong_t fix;
+
+  if (latlong_csm(&fix) < 0) {
+    values[0] = 0;
+    values[1] = 0;
+    values[2] = 0;
+    return;
+  }
+  latlong_to_noun(&fix, values);
+}
+
+/* R30 for the CSM, solved again only when its state vector changes */
+static void
+noun_fetch_r30(int values[NOUN_MAX_COMPONENTS])
+{
+  if (nav_r30_update() == 0) {
+    nav_r30_to_noun((long)agc_time2 * 16384L + (long)agc_time1, values);
+  }
+}
+
+static void
+noun_fetch_perigee(int values[NOUN_MAX_COMPONENTS])
+{
+  if (nav_r30_update() == 0) {
+    nav_r30_perigee_to_noun((long)agc_time2 * 16384L + (long)agc_time1,
+                            values);
+  }
+}
+
+/* HA/HP/period of the orbit report slot last selected by V84 */
+static void
+noun_fetch_orbits(int values[NOUN_MAX_COMPONENTS])
+{
+  if (nav_orbit_report.cursor >= 0) {
+    nav_orbit_to_noun(&nav_orbit_report.orbit[nav_orbit_report.cursor],
+                      values);
+  }
+}
+
+/* Result of the last P17 search */
+static void
+noun_fetch_tpi_time(int values[NOUN_MAX_COMPONENTS])
+{
+  tpi_time_to_noun(&tpi_search, values);
+}
+
+static void
+noun_fetch_tpi_dv(int values[NOUN_MAX_COMPONENTS])
+{
+  tpi_delta_v_to_noun(&tpi_search, values);
+}
+
+/* Result of the last P37 search */
+static void
+noun_fetch_rte_time(int values[NOUN_MAX_COMPONENTS])
+{
+  rte_time_to_noun(&rte_search, values);
+}
+
+static void
+noun_fetch_rte_ei(int values[NOUN_MAX_COMPONENTS])
+{
+  rte_entry_to_noun(&rte_search, values);
+}
+
+/* One erasable word in display units */
+static int
+noun_scale(int scale_factor, agc_word_t word)
+{
+  switch (scale_factor) {
+    case NOUN_SCALE_CDU_DEG:
+      return (int)(((long)word & 077777L) * 36000L / 32768L);
+    default:
+      return (int)word;
+  }
+}
+
+const noun_table_entry_t*
+noun_lookup(int noun)
+{
+  int i;
+  if (!noun_index_ready) {
+    for (i = 0; i < noun_table_size; i++) {
+      noun_index[noun_table[i].noun_num] = &noun_table[i];
+    }
+    noun_index_ready = 1;
+  }
+  if (noun < 0 || noun >= NOUN_MAX) {
+    return NULL;
+  }
+  return noun_index[noun];
+}
+
+const noun_table_entry_t*
+noun_fetch(int noun, int values[NOUN_MAX_COMPONENTS])
+{
+  const noun_table_entry_t* entry;
+  int i;
+
+  for (i = 0; i < NOUN_MAX_COMPONENTS; i++) {
+    values[i] = 0;
+  }
+  entry = noun_lookup(noun);
+  if (entry == NULL) {
+    return NULL;
+  }
+  if (entry->fetch != NULL) {
+    entry->fetch(values);
+  } else if (entry->address != NOUN_NO_ADDRESS) {
+    for (i = 0; i < entry->num_components; i++) {
+      values[i] = noun_scale(
+        entry->scale_factor,
+        agc_read_erasable(entry->ebank, entry->address + i));
+    }
+  }
+  return entry;
+}
+
 /* ----------------------------------------------------------------
  * Fresh start (DOFSTART equivalent)
  * ---------------------------------------------------------------- */
@@ -50,6 +222,11 @@ fresh_start(void)
 
   exec_init();
   waitlist_init();
+  monitor_init();
+  integ_init();
+  tpi_init();
+  rte_init();
+  latlong_init();
   dsky_init();
   pinball_init();
   alarm_reset();
@@ -2,8 +2,11 @@
  * service.h -- Noun tables and fresh start (SERVICE_ROUTINES.agc,
  *              FRESH_START_AND_RESTART.agc).
  *
- * The noun table maps noun numbers to display characteristics
- * (component count, signedness, scale factor) for Pinball.
+ * The noun table (PINBALL_NOUN_TABLES.agc) maps noun numbers to
+ * display characteristics (component count, signedness, scale
+ * factor) and to where the data lives: consecutive erasable words,
+ * scaled to display units by noun_fetch, or a fetch routine for
+ * derived quantities.  Adding an erasable noun means adding a row.
  * fresh_start() reinitializes all subsystems (V36 or power-on).
  *
  * Comanche055 (Apollo 11 CM) ANSI C89 port.
@@ -12,17 +15,37 @@
 #ifndef SERVICE_H
 #define SERVICE_H
 
+#define NOUN_MAX 100
+#define NOUN_MAX_COMPONENTS 3
+#define NOUN_NO_ADDRESS -1
+
+/* Scale factors (SF routines) from erasable word to display value */
+#define NOUN_SCALE_WHOLE 0   /* Word as is */
+#define NOUN_SCALE_CDU_DEG 1 /* CDU angle to 0.01 degrees, 0-35999 */
+
 typedef struct
 {
   int noun_num;
   int num_components;
   int is_signed;
   int scale_factor;
+  int ebank;   /* Erasable bank and address of component 1, */
+  int address; /* or NOUN_NO_ADDRESS */
+  void (*fetch)(int values[NOUN_MAX_COMPONENTS]); /* Overrides address */
 } noun_table_entry_t;
 
 extern const noun_table_entry_t noun_table[];
 extern const int noun_table_size;
 
+/* Table row for a noun, or NULL if the noun is not defined */
+const noun_table_entry_t*
+noun_lookup(int noun);
+
+/* Fetches every component of a noun in one pass (unused ones are 0).
+ * Returns its table row, or NULL if the noun is not defined. */
+const noun_table_entry_t*
+noun_fetch(int noun, int values[NOUN_MAX_COMPONENTS]);
+
 void
 fresh_start(void);
 
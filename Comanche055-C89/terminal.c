@@ -5,8 +5,22 @@
  */
 
 #include "terminal.h"
+#include "hal.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TERM_VS_MERGE_GAP 6 /* Resending a short gap beats a cursor move */
+#define TERM_VS_MOVE_MAX 16 /* ANSI_CURSOR_POS for any grid position */
+
+/* Runs on a row start at least TERM_VS_MERGE_GAP + 1 cells apart, so
+ * a full repaint is bounded by every cell plus a move per run. */
+#define TERM_VS_RUNS_PER_ROW                                                   \
+  ((TERM_VS_COLS + TERM_VS_MERGE_GAP) / (TERM_VS_MERGE_GAP + 1))
+#define TERM_VS_OUT_BUF                                                        \
+  ((int)sizeof(ANSI_CLEAR_SCREEN) + TERM_VS_MOVE_MAX +                         \
+   TERM_VS_ROWS * (TERM_VS_COLS + TERM_VS_RUNS_PER_ROW * TERM_VS_MOVE_MAX))
 
 void
 term_init(void)
@@ -35,3 +49,120 @@ term_clear_screen(void)
 {
   printf(ANSI_CLEAR_SCREEN);
 }
+
+/* ----------------------------------------------------------------
+ * Virtual screen
+ * ---------------------------------------------------------------- */
+
+static char term_vs_back[TERM_VS_ROWS][TERM_VS_COLS];  /* Next frame */
+static char term_vs_front[TERM_VS_ROWS][TERM_VS_COLS]; /* On screen */
+static int term_vs_ready = 0;
+static int term_vs_clear_pending = 1;
+static char term_vs_out[TERM_VS_OUT_BUF];
+static int term_vs_out_len = 0;
+
+static void
+term_vs_setup(void)
+{
+  memset(term_vs_back, ' ', sizeof(term_vs_back));
+  memset(term_vs_front, ' ', sizeof(term_vs_front));
+  term_vs_ready = 1;
+}
+
+/* A frame always fits (see TERM_VS_OUT_BUF); splitting one would
+ * tear it on screen, so an overflow is a bug and stops the program */
+static void
+term_vs_emit(const char* data, int len)
+{
+  if (term_vs_out_len + len > TERM_VS_OUT_BUF) {
+    fprintf(stderr,
+            "term_vs_flush: frame exceeds %d bytes\n",
+            TERM_VS_OUT_BUF);
+    abort();
+  }
+  memcpy(term_vs_out + term_vs_out_len, data, (size_t)len);
+  term_vs_out_len += len;
+}
+
+/* Writes text at 1-based line/column, clipped to the grid */
+void
+term_vs_put(int line, int column, const char* text)
+{
+  int row, col;
+
+  if (!term_vs_ready) {
+    term_vs_setup();
+  }
+  row = line - 1;
+  col = column < 1 ? 0 : column - 1;
+  if (row < 0 || row >= TERM_VS_ROWS) {
+    return;
+  }
+  while (*text != '\0' && col < TERM_VS_COLS) {
+    term_vs_back[row][col++] = *text++;
+  }
+}
+
+/* Clears the terminal on the next flush and repaints every cell */
+void
+term_vs_invalidate(void)
+{
+  term_vs_clear_pending = 1;
+}
+
+/* Returns the number of cells repainted, 0 if the frame is unchanged */
+int
+term_vs_flush(int park_line, int park_column)
+{
+  char move[32]; /* ANSI_CURSOR_POS for any int pair */
+  int row, col, start, end, scan, sent;
+
+  if (!term_vs_ready) {
+    term_vs_setup();
+  }
+  term_vs_out_len = 0;
+  sent = 0;
+
+  if (term_vs_clear_pending) {
+    term_vs_emit(ANSI_CLEAR_SCREEN, (int)strlen(ANSI_CLEAR_SCREEN));
+    memset(term_vs_front, ' ', sizeof(term_vs_front));
+    term_vs_clear_pending = 0;
+  }
+
+  for (row = 0; row < TERM_VS_ROWS; row++) {
+    col = 0;
+    while (col < TERM_VS_COLS) {
+      if (term_vs_back[row][col] == term_vs_front[row][col]) {
+        col++;
+        continue;
+      }
+
+      /* Extend the run across changed cells and short unchanged gaps */
+      start = col;
+      end = col + 1;
+      for (scan = end; scan < TERM_VS_COLS && scan - end < TERM_VS_MERGE_GAP;
+           scan++) {
+        if (term_vs_back[row][scan] != term_vs_front[row][scan]) {
+          end = scan + 1;
+        }
+      }
+
+      term_vs_emit(move, sprintf(move, ANSI_CURSOR_POS, row + 1, start + 1));
+      term_vs_emit(&term_vs_back[row][start], end - start);
+      memcpy(&term_vs_front[row][start],
+             &term_vs_back[row][start],
+             (size_t)(end - start));
+      sent += end - start;
+      col = end;
+    }
+  }
+
+  if (sent > 0 && park_line > 0 && park_line <= TERM_VS_ROWS &&
+      park_column >= 0 && park_column <= TERM_VS_COLS) {
+    term_vs_emit(move, sprintf(move, ANSI_CURSOR_POS, park_line, park_column));
+  }
+  if (term_vs_out_len > 0) {
+    hal_write_stdout(term_vs_out, term_vs_out_len);
+  }
+  return sent;
+}
@@ -5,6 +5,11 @@
  * flicker-free terminal rendering (alternate screen buffer,
  * cursor positioning) across Windows, Linux, and macOS.
  *
+ * The virtual screen is a character grid the renderer draws into with
+ * term_vs_put().  term_vs_flush() compares it with what the terminal
+ * already shows, emits cursor moves and text for the changed cells
+ * only, parks the cursor, and sends the whole frame in one write.
+ *
  * Comanche055 (Apollo 11 CM) ANSI C89 port.
  */
 
@@ -28,4 +33,17 @@ term_set_cursor(int line, int column);
 void
 term_clear_screen(void);
 
+#define TERM_VS_ROWS 50
+#define TERM_VS_COLS 160
+
+void
+term_vs_put(int line, int column, const char* text);
+void
+term_vs_invalidate(void);
+/* Parks the cursor at park_line/park_column (inside the grid) after
+ * a changed frame, or leaves it after the last cell when park_line
+ * is 0 */
+int
+term_vs_flush(int park_line, int park_column);
+
 #endif /* TERMINAL_H */
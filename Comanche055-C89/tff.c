@@ -0,0 +1,164 @@
+/*
+ * tff.c -- Time of free fall and time from perigee.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#include "agc_fixed.h"
+#include "navigation.h"
+#include "tff.h"
+
+#define TFF_TWO_PI AGC_FX_CONST(6.283185307179586)
+#define TFF_ENTRY_RADIUS AGC_FX_CONST((NAV_DU_KM + TFF_ALT_KM) / NAV_DU_KM)
+#define TFF_TOLERANCE 64 /* Q40 units of x */
+
+/* Radius (want_sigma 0) or sigma at x, and its slope dr/dx = sigma or
+ * dsigma/dx = 1 - alpha r */
+static agc_fx_t
+tff_eval(const nav_fx_state_t* s,
+         agc_fx_t alpha,
+         int want_sigma,
+         agc_fx_t x,
+         agc_fx_t* slope)
+{
+  agc_fx_t t, r, sigma;
+
+  nav_kepler_x(s, x, &t, &r, &sigma);
+  if (want_sigma) {
+    *slope = AGC_FX_ONE - agc_fx_mul(alpha, r);
+    return sigma;
+  }
+  *slope = sigma;
+  return r;
+}
+
+/* Root of f(x) = target in [lo, hi], where f(lo) and f(hi) lie on
+ * either side of it; returns the evaluations used, or -1 */
+static int
+tff_root(const nav_fx_state_t* s,
+         agc_fx_t alpha,
+         int want_sigma,
+         agc_fx_t target,
+         agc_fx_t lo,
+         agc_fx_t hi,
+         agc_fx_t* x_out)
+{
+  agc_fx_t f, slope, x, xn, dx, dx_prev;
+  int rising, iter;
+
+  f = tff_eval(s, alpha, want_sigma, lo, &slope);
+  if (f == target) {
+    *x_out = lo;
+    return 1;
+  }
+  rising = f < target;
+  x = lo + (hi - lo) / 2;
+  dx_prev = hi - lo;
+  for (iter = 2; iter <= TFF_MAX_ITER; iter++) {
+    f = tff_eval(s, alpha, want_sigma, x, &slope);
+    if ((f < target) == rising) {
+      lo = x;
+    } else {
+      hi = x;
+    }
+    dx = slope != 0 ? agc_fx_div(target - f, slope) : dx_prev;
+    if (agc_fx_abs(dx) <= TFF_TOLERANCE) {
+      *x_out = x + dx;
+      return iter;
+    }
+    xn = x + dx;
+    if (slope == 0 || xn <= lo || xn >= hi ||
+        agc_fx_abs(dx) > dx_prev / 2) {
+      xn = lo + (hi - lo) / 2;
+    }
+    dx_prev = agc_fx_abs(xn - x);
+    x = xn;
+    if (hi - lo <= TFF_TOLERANCE) {
+      *x_out = x;
+      return iter;
+    }
+  }
+  return -1;
+}
+
+/* Grows [lo, hi] from x = 0 in direction dir until sigma changes sign */
+static int
+tff_open_bracket(const nav_fx_state_t* s,
+                 agc_fx_t alpha,
+                 int dir,
+                 agc_fx_t* lo,
+                 agc_fx_t* hi)
+{
+  agc_fx_t edge, sigma, slope;
+  int iter;
+
+  edge = dir > 0 ? AGC_FX_ONE : -AGC_FX_ONE;
+  for (iter = 0; iter < TFF_MAX_ITER; iter++) {
+    sigma = tff_eval(s, alpha, 1, edge, &slope);
+    if (dir > 0 ? sigma >= 0 : sigma <= 0) {
+      *lo = dir > 0 ? 0 : edge;
+      *hi = dir > 0 ? edge : 0;
+      return 0;
+    }
+    if (agc_fx_abs(edge) > AGC_FX_MAX / 4) {
+      break;
+    }
+    edge *= 2;
+  }
+  return -1;
+}
+
+int
+tff_solve(const nav_fx_state_t* s, tff_t* out)
+{
+  agc_fx_t r0, sigma0, alpha, a, x_rev, lo, hi, x_p, x_e, t, r, sigma;
+
+  r0 = agc_fx_vec_mag(s->r);
+  if (r0 == 0) {
+    return -1;
+  }
+  sigma0 = agc_fx_vec_dot(s->r, s->v);
+  alpha = agc_fx_div(AGC_FX_INT(2), r0) - agc_fx_vec_dot(s->v, s->v);
+
+  /* Perigee: sigma goes from negative to positive */
+  x_rev = 0;
+  out->period_tu = 0;
+  if (alpha > 0) {
+    a = agc_fx_div(AGC_FX_ONE, alpha);
+    x_rev = agc_fx_mul(TFF_TWO_PI, agc_fx_sqrt(a));
+    out->period_tu = agc_fx_mul(x_rev, a);
+    lo = sigma0 < 0 ? 0 : -x_rev / 2;
+    hi = sigma0 < 0 ? x_rev / 2 : 0;
+  } else if (tff_open_bracket(s, alpha, sigma0 < 0 ? 1 : -1, &lo, &hi) < 0) {
+    return -1;
+  }
+  if (tff_root(s, alpha, 1, 0, lo, hi, &x_p) < 0) {
+    return -1;
+  }
+  nav_kepler_x(s, x_p, &t, &r, &sigma);
+  out->perigee_tu = t;
+  out->r_perigee = r;
+
+  /* Entry altitude on the way down: between here and the perigee
+   * ahead, or between the next apogee and the perigee after it */
+  out->reaches = out->r_perigee < TFF_ENTRY_RADIUS;
+  out->tff_tu = 0;
+  if (!out->reaches || r0 <= TFF_ENTRY_RADIUS) {
+    return 0;
+  }
+  if (sigma0 < 0) {
+    lo = 0;
+    hi = x_p;
+  } else if (alpha > 0) {
+    lo = x_p + x_rev / 2;
+    hi = x_p + x_rev;
+  } else {
+    out->reaches = 0; /* Climbing away on an open orbit */
+    return 0;
+  }
+  if (tff_root(s, alpha, 0, TFF_ENTRY_RADIUS, lo, hi, &x_e) < 0) {
+    return -1;
+  }
+  nav_kepler_x(s, x_e, &out->tff_tu, &r, &sigma);
+  return 0;
+}
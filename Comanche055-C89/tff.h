@@ -0,0 +1,42 @@
+/*
+ * tff.h -- Time of free fall and time from perigee.
+ *
+ * Both come from the conic of a state vector, searched in the
+ * universal anomaly x with nav_kepler_x().  Perigee is the root of
+ * sigma = r.v with sigma rising.  On a closed orbit it lies within
+ * half a revolution of x = 0, ahead if sigma is negative and behind
+ * otherwise.  On an open orbit the bracket grows outward until sigma
+ * changes sign.  The time of free fall is the time to come down to
+ * TFF_ALT_KM on the descending branch, before the next perigee.  Each
+ * root is a Newton iteration on a sign-checked bracket, falling back
+ * to bisection, and takes at most TFF_MAX_ITER evaluations.
+ *
+ * Maps to TIME_OF_FREE_FALL.agc.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifndef TFF_H
+#define TFF_H
+
+#include "agc_fixed.h"
+#include "navigation.h"
+
+#define TFF_ALT_KM 91.44 /* 300,000 ft */
+#define TFF_MAX_ITER 48
+
+typedef struct
+{
+  agc_fx_t period_tu;  /* 0 on an open orbit */
+  agc_fx_t perigee_tu; /* Time of the perigee from the state: ahead
+                          (positive) while descending, else behind */
+  agc_fx_t r_perigee;
+  int reaches;     /* The conic comes down to TFF_ALT_KM */
+  agc_fx_t tff_tu; /* Time until it does, 0 if already below */
+} tff_t;
+
+/* Returns -1 if s is not a usable conic or a root was not found */
+int
+tff_solve(const nav_fx_state_t* s, tff_t* out);
+
+#endif /* TFF_H */
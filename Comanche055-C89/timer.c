@@ -4,6 +4,7 @@
  * Comanche055 (Apollo 11 CM) ANSI C89 port.
  */
 
+#include "agc_context.h"
 #include "agc_cpu.h"
 #include "dsky.h"
 #include "timer.h"
@@ -19,6 +20,15 @@ static int cs_accumulator = 0;
 static int t3_counter = 1;
 static int t4_counter = 2; /* ~50 Hz display scan */
 
+const int timer_lateness_bounds[TIMER_LATENESS_BUCKETS] = {
+  0, 1, 2, 5, 10, 20, 50, 100, 250
+};
+unsigned long timer_lateness_hist[TIMER_LATENESS_BUCKETS + 1];
+unsigned long timer_lateness_sum_ms = 0;
+
+unsigned long timer_tick_count = 0;
+unsigned long timer_ticks_skipped = 0;
+
 /* ----------------------------------------------------------------
  * Init
  * ---------------------------------------------------------------- */
@@ -38,6 +48,15 @@ timer_init(void)
   t4_counter = 2;
 }
 
+void
+timer_register_state(void)
+{
+  agc_context_register(&t4rupt_phase, sizeof(t4rupt_phase));
+  agc_context_register(&cs_accumulator, sizeof(cs_accumulator));
+  agc_context_register(&t3_counter, sizeof(t3_counter));
+  agc_context_register(&t4_counter, sizeof(t4_counter));
+}
+
 /* ----------------------------------------------------------------
  * Timer tick (called every 10ms from main loop)
  * ---------------------------------------------------------------- */
@@ -73,3 +92,23 @@ timer_tick(void)
     }
   }
 }
+
+/* ----------------------------------------------------------------
+ * Tick lateness (ms a tick ran behind its 10ms slot)
+ * ---------------------------------------------------------------- */
+
+void
+timer_note_lateness(int ms)
+{
+  int i;
+  if (ms < 0) {
+    ms = 0;
+  }
+  for (i = 0; i < TIMER_LATENESS_BUCKETS; i++) {
+    if (ms <= timer_lateness_bounds[i]) {
+      break;
+    }
+  }
+  timer_lateness_hist[i]++;
+  timer_lateness_sum_ms += (unsigned long)ms;
+}
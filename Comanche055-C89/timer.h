@@ -5,15 +5,33 @@
  * TIME1 and manages T3RUPT (waitlist) and T4RUPT (DSKY display scan).
  * TIME1+TIME2 form the mission elapsed time clock.
  *
+ * Tick counters and the lateness histogram are process lifetime
+ * statistics for monitoring; fresh start does not clear them.  They
+ * count host ticks, which the main loop tallies once however many AGC
+ * contexts each tick advances.
+ *
  * Comanche055 (Apollo 11 CM) ANSI C89 port.
  */
 
 #ifndef TIMER_H
 #define TIMER_H
 
+/* Upper bounds (ms) of the tick lateness histogram; last bucket is +Inf */
+#define TIMER_LATENESS_BUCKETS 9
+extern const int timer_lateness_bounds[TIMER_LATENESS_BUCKETS];
+extern unsigned long timer_lateness_hist[TIMER_LATENESS_BUCKETS + 1];
+extern unsigned long timer_lateness_sum_ms;
+
+extern unsigned long timer_tick_count;
+extern unsigned long timer_ticks_skipped;
+
 void
 timer_init(void);
 void
+timer_register_state(void);
+void
 timer_tick(void);
+void
+timer_note_lateness(int ms);
 
 #endif /* TIMER_H */
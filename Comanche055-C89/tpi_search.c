@@ -0,0 +1,279 @@
+/*
+ * tpi_search.c -- P17 TPI search: minimum delta-V ignition time.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#include "agc.h"
+#include "agc_context.h"
+#include "agc_cpu.h"
+#include "agc_fixed.h"
+#include "alarm.h"
+#include "executive.h"
+#include "navigation.h"
+#include "pinball.h"
+#include "tpi_search.h"
+
+#include <string.h>
+
+#define TPI_PRIORITY PRIO3
+
+#define TPI_MIN_PERICENTER                                                     \
+  AGC_FX_CONST((NAV_DU_KM + TPI_MIN_PERICENTER_KM) / NAV_DU_KM)
+
+tpi_search_t tpi_search;
+
+/* Lambert problems of the shard in hand; filled and used within one
+ * dispatch */
+static nav_lambert_t tpi_transfers[TPI_MAX_CANDIDATES];
+
+static void
+tpi_job(void);
+
+void
+tpi_init(void)
+{
+  memset(&tpi_search, 0, sizeof(tpi_search));
+  tpi_search.status = TPI_IDLE;
+  tpi_search.best = -1;
+}
+
+void
+tpi_register_state(void)
+{
+  agc_context_register(&tpi_search, sizeof(tpi_search));
+}
+
+/* ----------------------------------------------------------------
+ * Candidates
+ * ---------------------------------------------------------------- */
+
+static int
+tpi_setup(tpi_search_t* s, const tpi_params_t* params)
+{
+  if (params->count < 1 || params->count > TPI_MAX_CANDIDATES ||
+      params->shards < 1 || params->shards > params->count ||
+      params->step_cs < 0 || params->transfer_cs <= 0 ||
+      nav_state_empty(&nav_csm_state) || nav_state_empty(&nav_lem_state)) {
+    return -1;
+  }
+
+  memset(s, 0, sizeof(*s));
+  s->params = *params;
+  nav_state_to_fx(&nav_csm_state, &s->csm);
+  nav_state_to_fx(&nav_lem_state, &s->lem);
+  s->csm_cs = (long)nav_csm_state.time;
+  s->lem_cs = (long)nav_lem_state.time;
+  s->best = -1;
+  s->status = TPI_RUNNING;
+  return 0;
+}
+
+/* Radius of pericenter of the conic through (r, v) */
+static agc_fx_t
+tpi_pericenter(const agc_fx_t* r, const agc_fx_t* v)
+{
+  agc_fx_t h[3], e[3], unit[3];
+
+  agc_fx_vec_cross(r, v, h);
+  agc_fx_vec_cross(v, h, e);
+  agc_fx_vec_scale(agc_fx_div(AGC_FX_ONE, agc_fx_vec_mag(r)), r, unit);
+  agc_fx_vec_sub(e, unit, e);
+  return agc_fx_div(agc_fx_vec_dot(h, h), AGC_FX_ONE + agc_fx_vec_mag(e));
+}
+
+/* Evaluates every candidate of one shard against s->best_dv */
+static void
+tpi_shard(tpi_search_t* s, int shard)
+{
+  const tpi_params_t* p;
+  nav_fx_state_t csm[TPI_MAX_CANDIDATES], lem;
+  agc_fx_t lem_v[TPI_MAX_CANDIDATES][3];
+  int index[TPI_MAX_CANDIDATES];
+  agc_fx_t h[3], across[3], d[3], dv_tpi, dv_tpf, dv, perigee;
+  nav_lambert_t* t;
+  long tig;
+  int n, k, i, up_tpi, up_tpf;
+
+  p = &s->params;
+
+  /* Both vehicles to their ends of each transfer */
+  n = 0;
+  for (k = shard; k < p->count; k += p->shards) {
+    tig = p->first_cs + (long)k * p->step_cs;
+    t = &tpi_transfers[n];
+    if (nav_kepler_fx(&s->csm, nav_cs_to_tu(tig - s->csm_cs), &csm[n]) < 0 ||
+        nav_kepler_fx(
+          &s->lem, nav_cs_to_tu(tig + p->transfer_cs - s->lem_cs), &lem) < 0) {
+      s->rejected++;
+      continue;
+    }
+    memcpy(t->r1, csm[n].r, sizeof(t->r1));
+    memcpy(t->r2, lem.r, sizeof(t->r2));
+    memcpy(lem_v[n], lem.v, sizeof(lem_v[n]));
+    t->dt_tu = nav_cs_to_tu(p->transfer_cs);
+
+    /* Past 180 degrees of CSM motion the transfer goes the long way */
+    agc_fx_vec_cross(csm[n].r, csm[n].v, h);
+    agc_fx_vec_cross(csm[n].r, lem.r, across);
+    t->long_way = agc_fx_vec_dot(h, across) < 0;
+    index[n] = k;
+    n++;
+  }
+
+  nav_lambert_batch(tpi_transfers, n);
+
+  for (i = 0; i < n; i++) {
+    t = &tpi_transfers[i];
+    if (t->iterations < 0) {
+      s->rejected++;
+      continue;
+    }
+
+    agc_fx_vec_sub(t->v1, csm[i].v, d);
+    dv_tpi = agc_fx_vec_mag(d);
+    if (s->best >= 0 && dv_tpi > s->best_dv) {
+      s->pruned++;
+      continue;
+    }
+    agc_fx_vec_sub(lem_v[i], t->v2, d);
+    dv_tpf = agc_fx_vec_mag(d);
+    dv = agc_fx_add(dv_tpi, dv_tpf);
+    if (s->best >= 0 && dv > s->best_dv) {
+      s->pruned++;
+      continue;
+    }
+
+    /* Only a pericenter passed between TPI and TPF counts: descending
+     * at TPI and climbing at TPF, or either way round the long way */
+    perigee = tpi_pericenter(t->r1, t->v1);
+    up_tpi = agc_fx_vec_dot(t->r1, t->v1) >= 0;
+    up_tpf = agc_fx_vec_dot(t->r2, t->v2) >= 0;
+    if (perigee < TPI_MIN_PERICENTER &&
+        ((!up_tpi && up_tpf) || (up_tpi == up_tpf && t->long_way))) {
+      s->rejected++;
+      continue;
+    }
+    s->solved++;
+
+    k = index[i];
+    if (s->best < 0 || dv < s->best_dv || (dv == s->best_dv && k < s->best)) {
+      s->best = k;
+      s->best_dv = dv;
+      s->tig_cs = p->first_cs + (long)k * p->step_cs;
+      s->dv_tpi = dv_tpi;
+      s->dv_tpf = dv_tpf;
+      s->perigee = perigee;
+    }
+  }
+}
+
+/* ----------------------------------------------------------------
+ * Search
+ * ---------------------------------------------------------------- */
+
+static void
+tpi_finish(tpi_search_t* s)
+{
+  s->status = s->best >= 0 ? TPI_DONE : TPI_FAILED;
+}
+
+int
+tpi_search_run(const tpi_params_t* params, tpi_search_t* out)
+{
+  if (tpi_setup(out, params) < 0) {
+    return -1;
+  }
+  for (out->next_shard = 0; out->next_shard < params->shards;
+       out->next_shard++) {
+    tpi_shard(out, out->next_shard);
+  }
+  tpi_finish(out);
+  return 0;
+}
+
+int
+tpi_search_start(const tpi_params_t* params)
+{
+  if (tpi_search.status == TPI_RUNNING) {
+    return -1;
+  }
+  if (tpi_setup(&tpi_search, params) < 0) {
+    return -1;
+  }
+  if (exec_novac(TPI_PRIORITY, tpi_job) < 0) {
+    tpi_search.status = TPI_IDLE;
+    return -1;
+  }
+  return 0;
+}
+
+static void
+tpi_job(void)
+{
+  tpi_shard(&tpi_search, tpi_search.next_shard);
+  tpi_search.next_shard++;
+  if (tpi_search.next_shard < tpi_search.params.shards) {
+    exec_changejob();
+    return;
+  }
+
+  tpi_finish(&tpi_search);
+  if (agc_current_program == 17) {
+    if (tpi_search.status == TPI_DONE) {
+      pinball_nvsub(6, 37);
+    } else {
+      alarm_set(00124);
+    }
+  }
+  exec_endofjob();
+}
+
+/* ----------------------------------------------------------------
+ * Display
+ * ---------------------------------------------------------------- */
+
+void
+tpi_time_to_noun(const tpi_search_t* s, int values[3])
+{
+  if (s->best >= 0) {
+    nav_time_to_noun(s->tig_cs, values);
+  }
+}
+
+void
+tpi_delta_v_to_noun(const tpi_search_t* s, int values[3])
+{
+  if (s->best < 0) {
+    return;
+  }
+  values[0] = (int)(agc_fx_mul(s->perigee - AGC_FX_ONE,
+                               AGC_FX_CONST(NAV_DU_KM * 54.0 / 100.0)) /
+                    AGC_FX_ONE);
+  values[1] =
+    (int)(agc_fx_mul(s->dv_tpi, NAV_FPS_PER_DU_TU) >> (AGC_FX_FRAC_BITS - 16));
+  values[2] =
+    (int)(agc_fx_mul(s->dv_tpf, NAV_FPS_PER_DU_TU) >> (AGC_FX_FRAC_BITS - 16));
+}
+
+/* ----------------------------------------------------------------
+ * P17
+ * ---------------------------------------------------------------- */
+
+void
+program_p17(void)
+{
+  tpi_params_t params;
+
+  pinball_show_prog(17);
+  agc_current_program = 17;
+
+  params.first_cs = (long)agc_time2 * 16384L + (long)agc_time1 + TPI_LEAD_CS;
+  params.step_cs = TPI_STEP_CS;
+  params.count = TPI_CANDIDATES;
+  params.transfer_cs = TPI_TRANSFER_CS;
+  params.shards = TPI_SHARDS;
+  if (tpi_search_start(&params) < 0) {
+    alarm_set(00124);
+  }
+}
@@ -0,0 +1,106 @@
+/*
+ * tpi_search.h -- P17 TPI search: minimum delta-V ignition time.
+ *
+ * Candidate TPI times are spaced over a window.  For each, the CSM is
+ * taken along its conic to TPI and the LEM to TPF, a fixed transfer
+ * time later, and the Lambert solution between the two gives the TPI
+ * and TPF impulses.  The candidate with the smallest total whose
+ * transfer keeps a safe pericenter wins; ties go to the earlier time.
+ *
+ * The candidates are dealt into shards (every n-th candidate, so each
+ * shard spans the whole window) and the search job solves one shard
+ * per dispatch.  The best total so far prunes later candidates: once
+ * the TPI impulse alone exceeds it, the rest of the evaluation is
+ * skipped.  Pruning is strict and the reduction orders by total, then
+ * candidate, so the result does not depend on the shard count.
+ *
+ * Maps to TPI_SEARCH.agc.
+ *
+ * Comanche055 (Apollo 11 CM) ANSI C89 port.
+ */
+
+#ifndef TPI_SEARCH_H
+#define TPI_SEARCH_H
+
+#include "agc_fixed.h"
+#include "navigation.h"
+
+#define TPI_MAX_CANDIDATES 64
+
+/* P17 defaults: a candidate every minute for an hour, starting ten
+ * minutes ahead, with a 30 minute transfer */
+#define TPI_LEAD_CS 60000L
+#define TPI_STEP_CS 6000L
+#define TPI_CANDIDATES 60
+#define TPI_TRANSFER_CS 180000L
+#define TPI_SHARDS 8
+
+/* Minimum pericenter altitude of the transfer (HPE, 85 NM) */
+#define TPI_MIN_PERICENTER_KM 157.42
+
+#define TPI_IDLE 0
+#define TPI_RUNNING 1
+#define TPI_DONE 2
+#define TPI_FAILED 3 /* No candidate with a safe pericenter */
+
+typedef struct
+{
+  long first_cs;    /* TPI time of candidate 0 */
+  long step_cs;     /* Between candidates */
+  int count;        /* 1..TPI_MAX_CANDIDATES */
+  long transfer_cs; /* TPI to TPF */
+  int shards;       /* 1..count */
+} tpi_params_t;
+
+typedef struct
+{
+  int status;
+  tpi_params_t params;
+  nav_fx_state_t csm; /* Inputs, taken when the search starts */
+  nav_fx_state_t lem;
+  long csm_cs;
+  long lem_cs;
+  int next_shard;
+
+  int best; /* Candidate index, or -1 */
+  agc_fx_t best_dv;
+  long tig_cs;
+  agc_fx_t dv_tpi; /* DU/TU */
+  agc_fx_t dv_tpf;
+  agc_fx_t perigee; /* Transfer pericenter radius, DU */
+
+  int solved;   /* Candidates fully evaluated */
+  int pruned;   /* Dropped once past the best total */
+  int rejected; /* No transfer, or an unsafe pericenter */
+} tpi_search_t;
+
+extern tpi_search_t tpi_search;
+
+void
+tpi_init(void);
+void
+tpi_register_state(void);
+
+/* Starts a background search of the CSM and LEM state vectors.
+ * Returns -1 if one is running, the parameters are out of range, or
+ * either state vector is empty. */
+int
+tpi_search_start(const tpi_params_t* params);
+
+/* Runs a whole search at once, as the job would, into *out */
+int
+tpi_search_run(const tpi_params_t* params, tpi_search_t* out);
+
+/* Noun 37 (TIG of TPI, h/m/s) and noun 58 (HP in NM, delta-V TPI and
+ * TPF in ft/s) */
+void
+tpi_time_to_noun(const tpi_search_t* s, int values[3]);
+void
+tpi_delta_v_to_noun(const tpi_search_t* s, int values[3]);
+
+/* P17: search from the current time with the defaults above, then
+ * show noun 37, or alarm 00124 if no candidate is safe */
+void
+program_p17(void);
+
+#endif /* TPI_SEARCH_H */
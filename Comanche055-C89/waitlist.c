@@ -5,6 +5,7 @@
  */
 
 #include "agc.h"
+#include "agc_context.h"
 #include "waitlist.h"
 
 #include <stdlib.h>
@@ -36,6 +37,15 @@ waitlist_init(void)
   longcall_active = 0;
 }
 
+void
+waitlist_register_state(void)
+{
+  agc_context_register(agc_waitlist, sizeof(agc_waitlist));
+  agc_context_register(&longcall_target, sizeof(longcall_target));
+  agc_context_register(&longcall_remaining, sizeof(longcall_remaining));
+  agc_context_register(&longcall_active, sizeof(longcall_active));
+}
+
 /* ----------------------------------------------------------------
  * Add / reschedule
  * ---------------------------------------------------------------- */
@@ -67,6 +77,35 @@ waitlist_fixdelay(int dt_centisecs, agc_taskfunc_t task)
   return waitlist_add(dt_centisecs, task);
 }
 
+/* Drops pending runs of task; returns how many were dropped */
+int
+waitlist_cancel(agc_taskfunc_t task)
+{
+  int i, dropped;
+  dropped = 0;
+  for (i = 0; i < NUM_WAITLIST_TASKS; i++) {
+    if (agc_waitlist[i].task == task) {
+      agc_waitlist[i].task = NULL;
+      agc_waitlist[i].delta_t = 0;
+      dropped++;
+    }
+  }
+  return dropped;
+}
+
+int
+waitlist_occupancy(void)
+{
+  int i, used;
+  used = 0;
+  for (i = 0; i < NUM_WAITLIST_TASKS; i++) {
+    if (agc_waitlist[i].task != NULL) {
+      used++;
+    }
+  }
+  return used;
+}
+
 /* ----------------------------------------------------------------
  * LONGCALL: for delays > 16383 centiseconds
  * ---------------------------------------------------------------- */
@@ -25,12 +25,18 @@ extern agc_waitlist_slot_t agc_waitlist[NUM_WAITLIST_TASKS];
 
 void
 waitlist_init(void);
+void
+waitlist_register_state(void);
 int
 waitlist_add(int dt_centisecs, agc_taskfunc_t task);
 int
 waitlist_fixdelay(int dt_centisecs, agc_taskfunc_t task);
 int
 waitlist_longcall(int dt_centisecs, agc_taskfunc_t task);
+int
+waitlist_cancel(agc_taskfunc_t task);
+int
+waitlist_occupancy(void);
 void
 waitlist_t3rupt(void);
 